@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MipChain.h"
+
+// block compressed textures with their whole mip chain, encoded on the cpu
+//
+// images are encoded once (first run, or after the source changed) and cached next to the source as
+// "<image>.bctex", later runs map that file and upload its levels as they are. opaque images become
+// BC1 (8 bytes per 4x4 block), images with alpha BC3 (16 bytes), against 4 bytes per texel for the
+// uncompressed textures.
+//
+// cache layout (native endianness, level data 16 byte aligned):
+//	CompressedTextureHeader
+//	CompressedTextureLevel[levelCount]
+//	level data, finest first, blocks row by row
+
+static const unsigned int COMPRESSED_TEXTURE_VERSION = 2;
+
+enum class BlockFormat : uint32_t
+{
+	BC1 = 1,	// rgb, 1 bit alpha unused
+	BC3 = 3,	// rgb + interpolated alpha
+};
+
+struct CompressedLevel
+{
+	int width = 0, height = 0;
+	size_t offset = 0;		// from data()
+	size_t size = 0;
+};
+
+struct CompressedTexture
+{
+	BlockFormat format = BlockFormat::BC1;
+	int width = 0, height = 0;
+	std::vector<CompressedLevel> levels;
+	uint32_t mipOptions = 0;			// MipOptions::key of the levels below the base
+
+	std::vector<unsigned char> blocks;	// freshly encoded levels
+	MappedFile file;					// or the mapped cache file they are read from
+	size_t fileOffset = 0;				// of the first level in file
+
+	const unsigned char* data() const;	// levels, back to back
+	size_t byteSize() const;			// all levels
+};
+
+// encodes pixels (1 to 4 components, gray expands to rgb) and every mip level down to 1x1 (see
+// MipChain.h), mips and blocks are spread over threads (0 uses all hardware threads)
+CompressedTexture compressTexture(const unsigned char* pixels, int width, int height, int nrComponents, unsigned int threads = 0, const MipOptions& mips = MipOptions());
+
+// encodes rgba8 texels into blocks row by row (partial blocks at the edges repeat the last row and
+// column), out holds compressedLevelSize bytes. block rows are spread over threads
+void encodeBlocks(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out, unsigned int threads = 1);
+
+// bytes of the blocks of a width x height level
+size_t compressedLevelSize(BlockFormat format, int width, int height);
+
+std::string compressedTexturePath(const char* imageFilename);
+
+// maps a valid cache of imageFilename, false if it's missing, stale, of another version or its levels
+// were built with other mip options
+bool loadCompressedTexture(const char* imageFilename, CompressedTexture& outTexture, const MipOptions& mips = MipOptions());
+
+// throws if the cache can't be written
+void writeCompressedTexture(const char* imageFilename, const CompressedTexture& texture);
+
+// cached texture, or the image decoded (flipped for gl), encoded and cached. a cache that can't be
+// written only costs the encode on the next run. false if the image can't be decoded
+bool acquireCompressedTexture(const char* imageFilename, CompressedTexture& outTexture, const MipOptions& mips = MipOptions());
+
+// gl side, render thread
+
+// GL_COMPRESSED_RGB_S3TC_DXT1_EXT or GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+GLenum compressedInternalFormat(BlockFormat format);
+
+// the driver lists the format among GL_COMPRESSED_TEXTURE_FORMATS (S3TC)
+bool compressedFormatSupported(BlockFormat format);
+
+// specifies every level of the bound GL_TEXTURE_2D, levelData is texture.data() or the offset of a
+// copy of it in the bound GL_PIXEL_UNPACK_BUFFER (nullptr)
+void uploadCompressedLevels(const CompressedTexture& texture, const unsigned char* levelData);
+
+// bytes the same image takes as an uncompressed rgba8 texture with mipmaps
+size_t uncompressedTextureBytes(int width, int height);
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "MipChain.h"
+
+// decoded images with their mip chain, kept on disk so later runs skip the jpg/png decode
+//
+// every source image gets one entry "<directory>/<hash of its path>.texcache" holding the texels as
+// R8 (gray images) or RGBA8 (everything else) and their mip chain (see MipChain.h) in the layout
+// glTexImage2D takes, so they are uploaded straight from the mapped file. an entry is tied to its
+// source by path, size + mtime, and by content hash when only the mtime moved, and to the mip
+// options its levels were built with. the directory is kept under a size cap by dropping the least
+// recently used entries, an entry's mtime is its last use.
+//
+// entry layout (native endianness, level data 16 byte aligned):
+//	DecodedTextureHeader
+//	source path
+//	DecodedTextureLevel[levelCount]
+//	level data, finest first, rows bottom up (flipped for gl)
+
+static const unsigned int DECODED_TEXTURE_VERSION = 2;
+static const uint64_t DECODED_TEXTURE_CACHE_CAPACITY = 4ull * 1024 * 1024 * 1024;	// the skyboxes alone take 2.3 GB
+
+struct DecodedLevel
+{
+	int width = 0, height = 0;
+	size_t offset = 0;		// from data()
+	size_t size = 0;
+};
+
+struct DecodedTexture
+{
+	int width = 0, height = 0;
+	int nrComponents = 0;				// 1 (R8) or 4 (RGBA8)
+	std::vector<DecodedLevel> levels;	// down to 1x1, or only the base level
+	uint32_t mipOptions = 0;			// MipOptions::key of the levels below the base
+
+	std::vector<unsigned char> pixels;	// freshly decoded levels
+	MappedFile file;					// or the mapped cache entry they are read from
+	size_t fileOffset = 0;				// of the first level in file
+
+	const unsigned char* data() const;	// levels, back to back
+	size_t byteSize() const;			// all levels
+};
+
+// pixels with 1 to 4 components as R8/RGBA8, with every mip level down to 1x1 if mipmaps is set.
+// the levels are spread over threads (0 uses all hardware threads)
+DecodedTexture buildDecodedTexture(const unsigned char* pixels, int width, int height, int nrComponents, bool mipmaps,
+	const MipOptions& mips = MipOptions(), unsigned int threads = 0);
+
+// decodes (flipped for gl) without any cache, false if the image can't be decoded
+bool decodeTexture(const char* imageFilename, bool mipmaps, DecodedTexture& outTexture, const MipOptions& mips = MipOptions());
+
+// every member is safe to call from any thread
+class DecodedTextureCache
+{
+public:
+
+	explicit DecodedTextureCache(const std::string& directory = "texture_cache", uint64_t capacityBytes = DECODED_TEXTURE_CACHE_CAPACITY);
+
+	// maps a valid entry of imageFilename and marks it as used, false if it's missing, stale, of
+	// another version or lacks the mip levels (or has levels of other mip options). an entry with mip
+	// levels also serves a base level only load
+	bool load(const char* imageFilename, bool mipmaps, DecodedTexture& outTexture, const MipOptions& mips = MipOptions());
+
+	// replaces the entry of imageFilename then evicts, throws if it can't be written
+	void write(const char* imageFilename, const DecodedTexture& texture);
+
+	// cached texels, or the image decoded and cached. an entry that can't be written only costs the
+	// decode on the next run. false if the image can't be decoded
+	bool acquire(const char* imageFilename, bool mipmaps, DecodedTexture& outTexture, const MipOptions& mips = MipOptions());
+
+	// removes least recently used entries until the cache fits its capacity, returns the bytes removed
+	uint64_t evict();
+
+	// removes every entry
+	void clear();
+
+	uint64_t size() const;	// bytes of all entries
+	uint64_t getCapacity() const;
+	const std::string& getDirectory() const;
+	std::string entryPath(const char* imageFilename) const;
+
+private:
+
+	std::string directory;
+	uint64_t capacity;
+	std::mutex evictMutex;					// one eviction scan at a time
+	std::atomic<unsigned int> writeCount{ 0 };	// unique temporary names for concurrent writes
+};
+
+// gl side, render thread
+
+// specifies the levels of target (GL_TEXTURE_2D or a cube map face) of the bound texture, levelData
+// is texture.data() or the offset of a copy of it in the bound GL_PIXEL_UNPACK_BUFFER (nullptr)
+void uploadDecodedLevels(GLenum target, const DecodedTexture& texture, const unsigned char* levelData);
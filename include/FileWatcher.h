@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// reports modifications of watched files
+// (inotify on the files' directories on linux, so editors that save through a rename are seen too,
+// modification time and size polling everywhere else)
+//
+// a file is reported once it has been quiet for a short time, an editor writing it in several
+// steps gives one change instead of a half written file
+
+class FileWatcher
+{
+public:
+
+	FileWatcher();
+	~FileWatcher();
+
+	FileWatcher(const FileWatcher&) = delete;
+	FileWatcher& operator=(const FileWatcher&) = delete;
+
+	// thread safe, the path doesn't have to exist yet
+	void watch(const std::string& path);
+
+	// waits at most timeoutMs for changes, returns the modified paths as passed to watch
+	// (a file watched under several spellings is reported under each)
+	std::vector<std::string> waitForChanges(int timeoutMs);
+
+private:
+
+	using Clock = std::chrono::steady_clock;
+
+	struct WatchedFile
+	{
+		std::vector<std::string> paths;	// every spelling passed to watch
+		std::filesystem::file_time_type mtime;
+		uintmax_t size = 0;
+	};
+
+	std::mutex filesMutex;
+	std::map<std::string, WatchedFile> files;		// normalized path -> file
+	std::map<std::string, Clock::time_point> changed;	// normalized path -> last event, not reported yet
+
+#ifdef __linux__
+	int inotifyFd = -1;
+	std::map<int, std::string> directories;		// watch descriptor -> normalized directory
+#endif
+
+	// blocks up to waitMs and records changes
+	void waitForEvents(int waitMs);
+};
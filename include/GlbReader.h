@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+#include "ModelReader.h"
+#include "VertexFormat.h"
+
+// binary gltf 2.0 (.glb) reader
+//
+// the file stays mapped and nothing is converted: attributes and indices are described as byte ranges
+// of the binary chunk, which is uploaded to the gpu as is (one buffer for vertices and indices).
+// only the json chunk is parsed, every accessor is checked against its buffer view so the gpu never
+// reads out of range. materials map onto the same SubMtl/MaterialFileData as mtl files
+
+// one vertex attribute of a primitive, interleaved or not
+struct GlbAttribute
+{
+	VertexAttrib format{ 0, GL_FLOAT, false };	// count 0 when the primitive doesn't have it
+	size_t byteOffset = 0;	// of the first element, from the start of the binary chunk
+	int byteStride = 0;		// 0 when tightly packed
+	size_t count = 0;
+};
+
+struct GlbPrimitive
+{
+	GlbAttribute position;	// float vec3
+	GlbAttribute texCoord;	// TEXCOORD_0, float or normalized unsigned byte/short vec2
+	GlbAttribute normal;	// float vec3
+
+	GLenum indexType = 0;	// GL_UNSIGNED_BYTE/SHORT/INT, 0 when the primitive isn't indexed
+	size_t indexOffset = 0;	// bytes from the start of the binary chunk
+	size_t indexCount = 0;
+
+	int material = -1;		// index into GlbFileData::materials.materials
+
+	glm::vec3 minPosition{ 0.f };	// bounds of the vertices, scanned like the indices
+	glm::vec3 maxPosition{ 0.f };
+};
+
+struct GlbMesh
+{
+	std::string name;
+	std::vector<GlbPrimitive> primitives;	// triangles only, other modes are skipped
+};
+
+// mesh placed by a node of the default scene
+struct GlbInstance
+{
+	int mesh;
+	glm::mat4 transform;	// node to model space, parents applied
+};
+
+struct GlbFileData
+{
+	std::string filename;
+	MappedFile file;
+
+	const unsigned char* binary = nullptr;	// BIN chunk, inside file
+	size_t binarySize = 0;
+
+	std::vector<GlbMesh> meshes;
+	std::vector<GlbInstance> instances;
+
+	// material names are the gltf names (or "material<index>"), pbr base color/roughness/metallic are
+	// approximated with the phong terms, images in the binary chunk are listed in embeddedTextures
+	MaterialFileData materials;
+};
+
+class GlbFileReader
+{
+public:
+	// throws invalid_argument on malformed or unsupported files
+	GlbFileData read(const char* filename);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "FileWatcher.h"
+
+// reloads assets whose files changed while the program runs
+//
+// only the assets of modified files are reloaded: their load step (file reading, decoding, parsing)
+// runs on a background thread and returns the gl side of the swap, which the render thread runs
+// between two frames in applyPending. an asset whose load step fails (or returns no swap) keeps
+// what it had, a half written file is never uploaded
+
+class HotReloader
+{
+public:
+	// runs on the background thread, returns the swap for the render thread (empty to keep the asset)
+	using Load = std::function<std::function<void()>()>;
+
+	HotReloader();
+	~HotReloader();
+
+	HotReloader(const HotReloader&) = delete;
+	HotReloader& operator=(const HotReloader&) = delete;
+
+	// load runs once per change of any of paths (e.g. both stages of a shader)
+	void watch(const std::vector<std::string>& paths, Load load);
+
+	// render thread, at a frame boundary. returns the number of swapped assets
+	int applyPending();
+
+private:
+	struct Asset
+	{
+		std::vector<std::string> paths;
+		Load load;
+	};
+
+	FileWatcher watcher;
+	std::mutex mutex;
+	std::vector<Asset> assets;
+	std::vector<std::function<void()>> pending;	// swaps waiting for the render thread
+
+	std::atomic<bool> running{ true };
+	std::thread thread;
+
+	void run();
+};
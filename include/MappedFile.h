@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+
+// read only view of a whole file mapped into memory
+// (Win32 file mapping on windows, mmap everywhere else)
+
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+	MappedFile(const char* filename);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool open(const char* filename);	// returns false if the file can't be opened or mapped
+	void close();
+
+	bool isOpen() const;
+	size_t size() const;
+	const char* begin() const;
+	const char* end() const;
+
+	// drop already consumed pages of [begin, end) from the resident set, they are paged back in if read again
+	void release(const char* rangeBegin, const char* rangeEnd) const;
+
+private:
+
+	const char* bytes = nullptr;
+	size_t length = 0;
+	bool opened = false;
+
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+
+	void moveFrom(MappedFile& other);
+};
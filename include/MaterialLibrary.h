@@ -0,0 +1,64 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ModelReader.h"
+
+// gpu side of one mtl material, the defaults leave a textured mesh lit exactly like the planets
+struct Material
+{
+	glm::vec3 ambientColor{ 1.f };	// Ka
+	glm::vec3 diffuseColor{ 1.f };	// Kd
+	glm::vec3 specularColor{ 1.f };	// Ks
+	float shininess = 0.f;			// Ns, 0 keeps the light's shininess
+	float opacity = 1.f;			// d
+	GLuint diffuseTexture = 0;		// map_Kd, 0 draws the colors only
+};
+
+// process wide registry of materials and the textures they reference
+//
+// textures are keyed by their normalized path, so an image shared by several models or mtl files is
+// decoded and uploaded once. materials are keyed by mtl file and name and get dense ids in
+// registration order for sorting draws, id 0 is the default material of faces without a known one
+
+class MaterialLibrary
+{
+public:
+	// load decodes and uploads one texture, called once per distinct path
+	// loadFromMemory does the same for images embedded in a model file (glb)
+	explicit MaterialLibrary(std::function<GLuint(const char*)> load,
+		std::function<GLuint(const unsigned char*, size_t)> loadFromMemory = nullptr);
+
+	GLuint acquireTexture(const std::string& path);
+	// path is only the registry key, the image is decoded from bytes
+	GLuint acquireTexture(const std::string& path, const EmbeddedTexture& embedded);
+
+	// library ids of materialNames (e.g. ModelBuffer::materialNames) looked up in data's mtl file,
+	// registering the materials and their textures on first use
+	std::vector<int> addMaterials(const ObjectFileData& data, const std::vector<std::string>& materialNames);
+	// same for materials of any other source, sourceFilename keys them (mtl or glb file)
+	std::vector<int> addMaterials(const MaterialFileData& mtl, const std::string& sourceFilename, const std::vector<std::string>& materialNames);
+
+	const Material& getMaterial(int materialId) const;
+	size_t getMaterialCount() const;
+	size_t getTextureCount() const;
+
+	// material uniforms of illuminated.frag, the diffuse texture goes to texture unit 0
+	void bind(int materialId, unsigned int shaderProgram) const;
+	// back to the neutral values the planets are drawn with
+	void bindNeutral(unsigned int shaderProgram) const;
+
+private:
+	std::function<GLuint(const char*)> load;
+	std::function<GLuint(const unsigned char*, size_t)> loadFromMemory;
+	std::unordered_map<std::string, GLuint> textures;	// normalized path -> texture
+	std::map<std::string, int> materialIds;			// normalized source path + '\n' + material name -> id
+	std::vector<Material> materials;
+
+	void setUniforms(const Material& material, bool textured, unsigned int shaderProgram) const;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include "ModelReader.h"
+
+// binary mesh cache, written next to the source obj as "<obj>.meshcache"
+//
+// layout (native endianness, blobs 16 byte aligned):
+//	MeshCacheHeader
+//	MeshCacheSubObj[subObjectCount]
+//	MeshCacheLod[lodCount]
+//	string blob		(mtl filename, object and group names, materials, smooth groups)
+//	vertex blob		(float, attribLayout interleaved)
+//	index blob		(uint32, relative to the sub object's first vertex, full resolution indices then lod indices)
+//
+// the cache is tied to the source by size + mtime, and by content hash when only the mtime moved,
+// and to the optimization passes that produced it (a cache written with other passes is stale)
+
+static const unsigned int MESH_CACHE_VERSION = 4;
+
+// optimization passes applied to the cached buffers
+static const unsigned int MESH_CACHE_VERTEX_CACHE_OPTIMIZED = 1;
+static const unsigned int MESH_CACHE_OVERDRAW_OPTIMIZED = 2;
+static const unsigned int MESH_CACHE_LODS_GENERATED = 4;
+static const unsigned int MESH_CACHE_SPHERICAL_UVS = 8;
+
+std::string meshCachePath(const char* objFilename);
+
+// fills indexed vertices/indices, lods, vertex cache stats, object/group names and materials of every sub object from a valid cache
+// (raw vertices, per face indices and expanded vertices are only produced by parsing the obj)
+// returns false if the cache is missing, stale or written with another version/layout/optimization flags
+bool loadMeshCache(const char* objFilename, ObjectFileData& outData, unsigned int optimizeFlags);
+
+// throws if the cache can't be written
+void writeMeshCache(const char* objFilename, const ObjectFileData& data, unsigned int optimizeFlags);
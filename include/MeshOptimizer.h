@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+#include "ModelReader.h"
+
+// index/vertex buffer reordering for indexed triangle meshes
+// (vertices are interleaved floats, stride in floats, position in the first 3)
+
+static const unsigned int VERTEX_CACHE_SIZE = 16;	// fifo size used to measure ACMR/ATVR
+
+// simulate a fifo post-transform cache over a triangle list
+VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = VERTEX_CACHE_SIZE);
+
+// reorder triangles for post-transform cache reuse (Forsyth's linear-speed lru scoring)
+void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+
+// split a cache optimized triangle list into clusters at cache flushes and sort them so outward
+// facing clusters are drawn first, threshold is the ACMR increase allowed to get more clusters
+void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<float>& vertices, int stride, float threshold = 1.05f);
+
+// renumber vertices in order of first use so vertex fetch walks memory linearly, unused vertices are dropped
+void optimizeVertexFetch(std::vector<float>& vertices, std::vector<unsigned int>& indices, int stride);
+
+// cache -> (overdraw) -> fetch on the indexed vertices of a sub object, fills its cache stats
+void optimizeSubObj(SubObj& subObj, int stride, bool overdraw);
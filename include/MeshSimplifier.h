@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vector>
+#include "ModelReader.h"
+
+// quadric error edge collapse simplification of indexed triangle meshes
+// (vertices are interleaved floats, stride in floats, position in the first 3)
+//
+// collapses move a vertex onto one of its neighbours, so uvs and normals are never interpolated.
+// vertices on open borders only slide along the border, vertices on uv/normal seams (one position,
+// two attribute sets) only slide along the seam together with their twin, corners and seam
+// junctions never move
+
+static const unsigned int MESH_LOD_COUNT = 6;		// levels including the full resolution one
+static const float MESH_LOD_REDUCTION = 0.5f;		// triangle ratio between consecutive levels
+
+// radius of the bounding sphere around the center of the bounding box
+float meshRadius(const std::vector<float>& vertices, int stride);
+
+// simplify towards targetIndexCount, the result indexes the same vertices
+// outError is the largest collapse error, relative to meshRadius
+std::vector<unsigned int> simplifyMesh(const std::vector<float>& vertices, const std::vector<unsigned int>& indices, int stride,
+	size_t targetIndexCount, float* outError = nullptr);
+
+// fill subObj.lods with up to MESH_LOD_COUNT - 1 levels simplified from the previous one,
+// stops early once a level can't be reduced any further
+void buildLodChain(SubObj& subObj, int stride);
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// mip levels of 8 bit images built on the cpu (texture caches, texture streamer)
+//
+// levels halve down to 1x1 like gl's (odd sizes round down), each computed from the level above
+// with a separable filter. the filter loops are SSE2 (AVX where the build enables it), rows of a
+// level are split between threads
+
+enum class MipFilter : uint32_t
+{
+	Box = 0,		// 2x2 average, fastest and blurriest
+	Kaiser = 1,		// kaiser windowed sinc, 3 texels wide, sharp with little ringing
+	Lanczos = 2,	// lanczos 3, sharpest, rings the most around hard edges
+};
+
+struct MipOptions
+{
+	MipFilter filter = MipFilter::Kaiser;
+
+	// rgb of rgba images is averaged in linear light (the texels are sRGB encoded), gray and alpha as stored
+	bool srgb = true;
+
+	// alpha reference (0..1) the levels keep the base level's coverage of: alpha is scaled so as many
+	// texels pass it as in the base level, cutouts (the ring gaps) don't fade or thicken with distance.
+	// 0 leaves alpha as filtered
+	float alphaCoverage = 0.f;
+
+	// identifies the options in cache files
+	uint32_t key() const;
+};
+
+// pixels with 1 to 4 components as rgba8, gray is spread to rgb and missing alpha is opaque.
+// returns true if any alpha isn't 255
+bool expandToRgba(const unsigned char* pixels, int width, int height, int nrComponents, std::vector<unsigned char>& outRgba);
+
+// calls onLevel(level, texels, width, height) for every level below the base (level 0), finest first.
+// channels is 1 or 4. threads 0 uses all hardware threads
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, const MipOptions& options, unsigned int threads,
+	const std::function<void(int level, const unsigned char* texels, int width, int height)>& onLevel);
+
+// width x height and every level below it
+int mipLevelCount(int width, int height);
+
+// sRGB texel to linear light scaled to 0..255 and back (rounded, clamped), the tables the filters use
+float srgbToLinear(unsigned char value);
+unsigned char linearToSrgb(float value);
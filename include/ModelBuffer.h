@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ModelReader.h"
+
+// every sub object of an obj file packed into one vertex/index buffer
+//
+// sub objects (o/g/usemtl sections) become index ranges over the shared buffers. they are sorted by
+// material, so all ranges of one material are contiguous and the whole model draws with one call
+// per material and a single buffer bind
+
+struct DrawRange
+{
+	size_t firstIndex;
+	size_t indexCount;
+	int materialId;		// index into ModelBuffer::materialNames
+};
+
+struct ModelBuffer
+{
+	std::vector<float> vertices;			// indexed vertices of all sub objects, same layout as SubObj::indexedVertices
+	std::vector<unsigned int> indices;		// full resolution indices, rebased onto vertices
+
+	std::vector<std::string> materialNames;	// in order of first use, "" for faces before any usemtl
+	std::vector<DrawRange> subObjectRanges;	// parallel to ObjectFileData::subObjects
+	std::vector<DrawRange> materialRanges;	// one per used material, sorted by materialId
+};
+
+// pack the indexed vertices/indices of every sub object (stride in floats)
+ModelBuffer packModel(const ObjectFileData& data, int stride);
@@ -4,8 +4,10 @@
 #include <string.h>
 #include <fstream>
 #include <sstream>
+#include <string_view>
 #include <vector>
 #include <map>
+#include <memory_resource>
 #include <stdexcept>
 
 // deprecated loader for manual vertices in csv
@@ -26,7 +28,35 @@ struct Vector2 {
 	float y;
 };
 
-enum class FaceType;
+enum class FaceType
+{
+	NO_TYPE,
+	V,
+	V_VT_VN,
+	V_VN,
+	V_VT
+};
+
+struct ObjChunk;
+struct ObjStreamState;
+
+// where the parser currently is, only turned into an error message when a check fails
+
+struct ParseContext
+{
+	const char* filename;
+	const char* fileBegin;
+	const char* fileEnd;
+	const char* lineStart;
+};
+
+// cursor over a byte range of a memory mapped file, consumed by the zero-copy parser
+
+struct TextCursor
+{
+	const char* cur;
+	const char* end;
+};
 
 struct SubMtl
 {
@@ -38,23 +68,49 @@ struct SubMtl
 
 	float shininess = 64.f;
 	float opacity = 1.f;
-	float opticalDensity;
+	float opticalDensity = 1.f;
 
-	int diffuseColorTextureIdx;
+	int diffuseColorTextureIdx = -1;	// into MaterialFileData::textureFilenames, -1 without map_Kd
+};
+
+// encoded image stored inside a model file (glb), valid while the model file is loaded
+struct EmbeddedTexture
+{
+	const unsigned char* bytes = nullptr;
+	size_t size = 0;
 };
 
 struct MaterialFileData
 {
-	std::map<std::string, int> textureFilenames;
-	std::map<std::string, int> materialNames;
+	std::vector<std::string> textureFilenames;	// resolved relative to the mtl file, each path once
+	std::vector<EmbeddedTexture> embeddedTextures;	// parallel to textureFilenames when the images are embedded
+	std::map<std::string, int> materialNames;	// index into materials
 	std::vector<SubMtl> materials;
 };
 
+// post-transform vertex cache efficiency of an index buffer (see MeshOptimizer.h)
+struct VertexCacheStats
+{
+	float acmr = 0.f;	// transformed vertices per triangle (0.5 is the best case, 3 the worst)
+	float atvr = 0.f;	// transformed vertices per unique vertex (1 is the best case)
+};
+
+// simplified level of a sub object (see MeshSimplifier.h)
+struct MeshLod
+{
+	std::vector<unsigned int> indices;	// over the same indexedVertices as the full resolution indices
+	float error = 0.f;					// geometric error relative to the mesh radius
+};
+
+// one o/g/usemtl section of an obj file, a material change inside a group starts a new one
+// (names, material and smoothing carry over from the previous section like obj state does)
 struct SubObj
 {
 	std::string modelObjectName;
+	std::string groupName;
 	std::string useMaterial;
 	std::string smoothShadding;
+	FaceType faceType = FaceType::NO_TYPE;
 
 	std::vector<unsigned int> verticesIdx;
 	std::vector<unsigned int> textureMapIdx;
@@ -62,6 +118,17 @@ struct SubObj
 
 	std::vector<float> expandedVertices;
 	int expandedVertexLength;
+
+	// unique (v, vt, vn) vertices in the same layout as expandedVertices, drawn through indices
+	std::vector<float> indexedVertices;
+	std::vector<unsigned int> indices;
+
+	// vertex cache efficiency of indices before/after the optimization pass
+	VertexCacheStats cacheStatsBefore;
+	VertexCacheStats cacheStatsAfter;
+
+	// progressively coarser versions of indices, each about half the triangles of the previous one
+	std::vector<MeshLod> lods;
 };
 
 struct ObjectFileData
@@ -78,45 +145,162 @@ struct ObjectFileData
 };
 
 
+// wall time of each ObjFileReader::read stage in seconds, 0 for stages that didn't run
+struct ObjReadTimings
+{
+	bool fromCache = false;		// the obj stages were replaced by loading the mesh cache
+	double cache = 0.0;			// cache load, or write after parsing
+	double readObj = 0.0;
+	double completeAttributes = 0.0;
+	double expandVertices = 0.0;
+	double indexVertices = 0.0;
+	double optimize = 0.0;
+	double lods = 0.0;
+	double readMtl = 0.0;
+	double total = 0.0;
+};
+
+
+// streaming obj reader interface
+
+// one corner of a streamed face, indices are 1 based and 0 when the face type doesn't have them
+struct ObjFaceCorner
+{
+	unsigned int v;
+	unsigned int vt;
+	unsigned int vn;
+};
+
+// receiver of ObjFileReader::stream, batches are only valid during the call
+// vertex data always arrives before the faces that reference it
+class ObjStreamSink
+{
+public:
+	virtual ~ObjStreamSink() = default;
+
+	virtual void onMaterialFile(const std::string& /*mtlFilename*/) {}
+	virtual void onObject(std::string_view /*name*/) {}
+	virtual void onGroup(std::string_view /*name*/) {}
+	virtual void onMaterial(std::string_view /*name*/) {}
+	virtual void onSmoothShading(std::string_view /*value*/) {}
+
+	virtual void onVertices(const Vector3* /*vertices*/, size_t /*count*/) {}
+	virtual void onTexCoords(const Vector2* /*texCoords*/, size_t /*count*/) {}
+	virtual void onNormals(const Vector3* /*normals*/, size_t /*count*/) {}
+	virtual void onFaces(const ObjFaceCorner* /*corners*/, size_t /*faceCount*/, FaceType /*type*/) {}	// 3 corners per face
+};
+
+
+// parse failure of an obj/mtl file, built only once a check fails
+// (line is 0 based, byte offset is from the start of the file)
+
+class ObjParseError : public std::invalid_argument
+{
+public:
+	ObjParseError(const std::string& msg, const std::string& filename, const std::string& lineText, size_t line, size_t byteOffset);
+
+	const std::string& getFilename() const;
+	const std::string& getLineText() const;
+	size_t getLine() const;
+	size_t getByteOffset() const;
+
+private:
+	std::string filename;
+	std::string lineText;
+	size_t line;
+	size_t byteOffset;
+};
+
+
 // blender object file reader
 
 class ObjFileReader
 {
+	friend class ObjParseError;
+
 public:
-	ObjectFileData read(const char* filename, bool parseMtl = false);
+	ObjectFileData read(const char* filename, bool parseMtl = true);
+
+	// parse without building ObjectFileData, records are handed to the sink in batches of at most
+	// batchSize so memory stays bounded regardless of the file size
+	void stream(const char* filename, ObjStreamSink& sink, size_t batchSize = 65536);
+
+	// number of threads used to parse large obj files and generate missing attributes (0: hardware concurrency)
+	void setParseThreads(unsigned int threads);
+
+	// project missing texture coordinates (faces without vt) onto a sphere around the sub object's center,
+	// off by default (they are 0 then), missing normals are always generated
+	void setGenerateSphericalUVs(bool value);
+
+	// read/write "<obj>.meshcache" binary meshes (see MeshCache.h), on by default
+	void setUseMeshCache(bool value);
+
+	// reorder triangles/vertices of indexed meshes for the vertex cache (see MeshOptimizer.h), on by default
+	void setOptimizeMeshes(bool value);
+	// additionally sort triangle clusters front to back to reduce overdraw, off by default
+	void setOptimizeOverdraw(bool value);
+
+	// build simplified levels of every sub object (see MeshSimplifier.h), on by default
+	void setGenerateLods(bool value);
+
+	// print a report of every read (load time, vertex cache, lods, material) and the warnings of ignored
+	// lines, on by default. failures are always printed
+	void setLogging(bool value);
+
+	// stage timings of the last read
+	const ObjReadTimings& getLastTimings() const;
+
 private:
 
+	unsigned int parseThreads = 0;
+	bool useMeshCache = true;
+	bool optimizeMeshes = true;
+	bool optimizeOverdraw = false;
+	bool generateLods = true;
+	bool generateSphericalUVs = false;
+	bool logging = true;
+	ObjReadTimings lastTimings;
+
 	// main method
 
 	ObjectFileData readObj(const char* filename);
+	void streamObjRange(const char* filename, const char* fileBegin, const char* fileEnd, TextCursor range,
+		ObjStreamSink& sink, size_t batchSize, ObjStreamState& state);
+	// scratch: per read arena for temporaries, released in one go (see read)
+	void completeAttributes(ObjectFileData& data, std::pmr::memory_resource* scratch);
 	void expandVertices(ObjectFileData& data);
-	void readMtl(ObjectFileData& data);
+	void indexVertices(ObjectFileData& data, std::pmr::memory_resource* scratch);
+	void readMtl(ObjectFileData& data, std::pmr::memory_resource* scratch);
+
+	// line splitting
+
+	bool nextLine(TextCursor& file, TextCursor& outLine);
+	std::vector<TextCursor> splitLines(const char* begin, const char* end, size_t chunkCount);
 
 	// string parser
 
-	bool parse1s(std::stringstream& ss, char delim, std::string& outStr);
-	//bool parseIfMatch(std::stringstream& ss, char delim, string compared);
-	bool checkEOL(std::stringstream& ss, char delim);
-	void parseEOL(std::stringstream& ss, char delim, std::string errStr);
+	bool parse1s(TextCursor& tc, std::string_view& outStr);
 
 	// float parser
 
-	float parse1f(std::stringstream& ss, char delim, std::string errStr);
-	Vector2 parse2f(std::stringstream& ss, char delim, std::string errStr);
-	Vector3 parse3f(std::stringstream& ss, char delim, std::string errStr);
-	//std::vector<float> parseVecf(std::stringstream& ss, unsigned int n, char delim, std::string errStr);
+	float parse1f(TextCursor& tc, const ParseContext& ctx, const char* errMsg);
+	Vector2 parse2f(TextCursor& tc, const ParseContext& ctx, const char* errMsg);
+	Vector3 parse3f(TextCursor& tc, const ParseContext& ctx, const char* errMsg);
 
 	// int parser
 
-	bool parse1ui(std::stringstream& ss, char delim, unsigned int& outInt, std::string errStr);
+	bool parse1ui(TextCursor& tc, unsigned int& outInt);
 
 	// special parser
 
-	FaceType parseSubFace(std::stringstream& ss, char delim, std::vector<unsigned int>& outVec, std::string errStr);
+	bool checkEOL(TextCursor& tc);
+	void parseEOL(TextCursor& tc, const ParseContext& ctx, const char* errMsg);
+	FaceType parseSubFace(TextCursor& tc, const ParseContext& ctx, unsigned int outIdx[3], const char* errMsg);
 
 	// parser method
 
-	std::string errString(std::string msg, const char* filename, std::string line, int lineCount);
+	ObjParseError parseError(const ParseContext& ctx, const char* msg, const char* position = nullptr);
+	static std::string errString(std::string msg, const char* filename, std::string line, size_t lineCount, size_t byteOffset);
 	std::string replaceBasename(std::string filename, std::string basename);
 
 };
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// number scanning shared by the obj and csv loaders
+//
+// digit runs are found 16 bytes at a time (SSE2, scalar fallback elsewhere) and converted 8 digits
+// at a time (SWAR). fixed format decimals with up to 15 significant digits are exact as digits / 10^n
+// in double, and rounding that quotient to float matches strtof bit for bit unless it sits exactly on
+// a float midpoint. those, exponents, longer mantissas and inf/nan go through std::from_chars
+
+// leading ascii digits of [cur, end)
+size_t countDigits(const char* cur, const char* end);
+
+// parse a float/unsigned starting at cur (optional sign for floats, no leading blanks)
+// returns the end of the number, nullptr if there's none or it overflows
+const char* parseFloat(const char* cur, const char* end, float& out);
+const char* parseUInt(const char* cur, const char* end, unsigned int& out);
+
+// parse throughput over generated obj style coordinates, the fast path against std::from_chars
+// (mismatches counts values that differ from strtof bit for bit, anything but 0 is a bug)
+struct NumberParserBenchmark
+{
+	size_t values = 0;
+	double fastMBps = 0.0;
+	double fromCharsMBps = 0.0;
+	size_t mismatches = 0;
+};
+
+NumberParserBenchmark benchmarkNumberParser(size_t valueCount);
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "ModelReader.h"
+
+// synthetic obj/mtl assets and ObjFileReader throughput
+//
+// the generated obj is a displaced grid split into objects that cycle through the mtl's materials,
+// coordinates are written with 6 decimals like common exporters. the reader runs without mesh cache,
+// optimization and lods so only the parsing stages are timed, the fastest of the runs is kept
+
+struct ObjBenchmarkConfig
+{
+	double megaBytes = 64.0;				// approximate obj size
+	FaceType faceType = FaceType::V_VT_VN;
+	int objectCount = 16;
+	int materialCount = 64;
+	int runs = 3;
+	unsigned int threads = 0;				// ObjFileReader::setParseThreads
+	std::string directory = ".";			// where the assets are written
+	bool keepAssets = false;				// remove them after the runs
+};
+
+// counts of one generated obj/mtl pair
+struct SyntheticObjAsset
+{
+	std::string objFilename;
+	std::string mtlFilename;
+	size_t objBytes = 0;
+	size_t objLines = 0;
+	size_t mtlBytes = 0;
+	size_t mtlLines = 0;
+	size_t vertices = 0;
+	size_t faces = 0;
+};
+
+// throughput of one reader stage, relative to the file it reads (the obj for expandVertices)
+struct ObjStageThroughput
+{
+	double seconds = 0.0;
+	double megaBytesPerSecond = 0.0;
+	double linesPerSecond = 0.0;
+};
+
+struct ObjBenchmarkResult
+{
+	ObjBenchmarkConfig config;
+	SyntheticObjAsset asset;
+	double generateSeconds = 0.0;
+
+	ObjReadTimings best;	// per stage minimum over the runs
+	ObjStageThroughput readObj;
+	ObjStageThroughput expandVertices;
+	ObjStageThroughput readMtl;
+	ObjStageThroughput total;
+
+	size_t allocations = 0;	// heap allocations of one read
+	size_t peakResidentBytes = 0;
+};
+
+// heap allocations of parsing a well formed obj, measured on a generated asset and one 4 times its size.
+// per line allocations grow with the added lines, the output vectors only grow logarithmically
+struct ObjAllocationCheck
+{
+	size_t smallLines = 0;
+	size_t largeLines = 0;
+	size_t streamSmall = 0;		// ObjFileReader::stream into a sink that ignores the records
+	size_t streamLarge = 0;
+	size_t readSmall = 0;		// ObjFileReader::read, one parse thread
+	size_t readLarge = 0;
+	bool passed = false;		// less than one added allocation per thousand added lines, streamed and read
+};
+
+// the readObj stage against the getline/stringstream/stof parser ObjFileReader had before the memory
+// mapped one, on any obj that parser supports (no groups). small files are parsed repeatedly per run
+struct ObjParserComparison
+{
+	std::string filename;
+	size_t bytes = 0;
+	double legacySeconds = 0.0;		// one parse, fastest run
+	double legacyMBps = 0.0;
+	double currentSeconds = 0.0;
+	double currentMBps = 0.0;
+	bool sameData = false;			// same positions, texture coordinates and position indices
+};
+
+// ObjFileReader::read with one parse thread against several (one chunk per thread) on the same file
+struct ObjThreadCheck
+{
+	std::string filename;
+	unsigned int threads = 0;
+	size_t serialSubObjects = 0;
+	size_t parallelSubObjects = 0;
+	bool same = false;		// same attributes and sub objects (names, material, smoothing, face indices)
+};
+
+// obj keyword classification throughput over generated line keywords, the reader's switch against the
+// std::map<string, keyword> operator[] lookup it replaced (mismatches counts tokens they classify
+// differently, anything but 0 is a bug)
+struct KeywordBenchmark
+{
+	size_t tokens = 0;
+	double mapMtokps = 0.0;		// million tokens per second
+	double switchMtokps = 0.0;
+	size_t mismatches = 0;
+};
+
+// writes "<directory>/synthetic_<face type>_<megabytes>mb.obj" and its mtl
+// throws invalid_argument if the files can't be written
+SyntheticObjAsset generateSyntheticObj(const ObjBenchmarkConfig& config);
+
+ObjBenchmarkResult benchmarkObjReader(const ObjBenchmarkConfig& config);
+
+// config.megaBytes is the small asset
+ObjAllocationCheck checkParseAllocations(const ObjBenchmarkConfig& config);
+
+// parses the generated asset of config and a file of repeated "usemtl A" / one face sections, padded so
+// the chunk boundary falls right before a usemtl, with 1 and config.threads (0: 2) parse threads
+std::vector<ObjThreadCheck> checkParseThreads(const ObjBenchmarkConfig& config);
+
+// throws invalid_argument if the file can't be parsed
+ObjParserComparison compareObjParsers(const std::string& objFilename, int runs = 3);
+
+KeywordBenchmark benchmarkKeywordClassifier(size_t tokenCount);
+
+// one json object, keys are stable so results can be compared across versions
+std::string objBenchmarkJson(const ObjBenchmarkResult& result);
+
+// high water mark of the process' resident memory, 0 if unknown
+size_t peakResidentBytes();
+
+// operator new calls made by the process so far
+size_t heapAllocationCount();
+
+// "v", "vt", "vn", "vtvn" to a face type and back, NO_TYPE for anything else
+FaceType faceTypeFromName(const std::string& name);
+const char* faceTypeName(FaceType faceType);
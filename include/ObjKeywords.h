@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// obj/mtl line keywords, shared by ObjFileReader and the parser benchmarks
+
+enum ObjKeywords
+{
+	NULL_KEYWORD,
+	COMMENT,
+	MATERIAL_FILE,
+	OBJECT,
+	GROUP,
+	VERTEX,
+	TEXTURE_MAP,
+	NORMAL,
+	USE_MATERIAL,
+	SMOOTH_SHADDING,
+	FACE_INDEX,
+	LINE_INDEX,
+};
+
+enum class MtlKeywords
+{
+	// MAIN KEYWORDS
+	NULL_KEYWORD,
+	COMMENT,
+	MATERIAL,
+	K_AMBIENT,
+	K_DIFFUSE,
+	K_SPECULAR,
+	N_SHININESS,
+	OPACITY,
+	TRANSPARENCY,
+	TRANSMISSION_FILTER_COLOR,
+	N_OPTICAL_DENSITY,
+	ILLUMINATION_MODEL,
+	MAP_AMBIENT,
+	MAP_DIFFUSE,
+	MAP_SPECULAR,
+	MAP_ALPHA,
+	MAP_BUMP_1,
+	MAP_BUMP_2,
+	MAP_DISPLACEMENT,
+	MAP_STENCIL_DECAL,
+	// TEXTURE KEYWORDS
+	TEXTURE_OPTION
+};
+
+// every keyword fits in 8 bytes, so packing its bytes into one integer is a perfect hash:
+// classifying a token is a single switch, allocates nothing and never touches shared state
+
+constexpr uint64_t packKeyword(std::string_view key)
+{
+	if (key.size() == 0 || key.size() > 8) return 0;
+	uint64_t packed = 0;
+	for (size_t i = 0; i < key.size(); i++) packed |= (uint64_t)(unsigned char)key[i] << (8 * i);
+	return packed;
+}
+
+constexpr ObjKeywords classifyObjKeyword(std::string_view key)
+{
+	if (!key.empty() && key[0] == '#') return COMMENT;
+
+	switch (packKeyword(key))
+	{
+	case packKeyword("mtllib"):	return MATERIAL_FILE;
+	case packKeyword("o"):		return OBJECT;
+	case packKeyword("g"):		return GROUP;
+	case packKeyword("v"):		return VERTEX;
+	case packKeyword("vt"):		return TEXTURE_MAP;
+	case packKeyword("vn"):		return NORMAL;
+	case packKeyword("usemtl"):	return USE_MATERIAL;
+	case packKeyword("s"):		return SMOOTH_SHADDING;
+	case packKeyword("f"):		return FACE_INDEX;
+	case packKeyword("l"):		return LINE_INDEX;
+	default:					return NULL_KEYWORD;
+	}
+}
+
+constexpr MtlKeywords classifyMtlKeyword(std::string_view key)
+{
+	if (!key.empty() && key[0] == '#') return MtlKeywords::COMMENT;
+
+	switch (packKeyword(key))
+	{
+	case packKeyword("newmtl"):		return MtlKeywords::MATERIAL;
+	case packKeyword("Ka"):			return MtlKeywords::K_AMBIENT;
+	case packKeyword("Kd"):			return MtlKeywords::K_DIFFUSE;
+	case packKeyword("Ks"):			return MtlKeywords::K_SPECULAR;
+	case packKeyword("Ns"):			return MtlKeywords::N_SHININESS;
+	case packKeyword("Ni"):			return MtlKeywords::N_OPTICAL_DENSITY;
+	case packKeyword("d"):			return MtlKeywords::OPACITY;
+	case packKeyword("Tr"):			return MtlKeywords::TRANSPARENCY;
+	case packKeyword("Tf"):			return MtlKeywords::TRANSMISSION_FILTER_COLOR;
+	case packKeyword("illum"):		return MtlKeywords::ILLUMINATION_MODEL;
+	case packKeyword("map_Ka"):		return MtlKeywords::MAP_AMBIENT;
+	case packKeyword("map_Kd"):		return MtlKeywords::MAP_DIFFUSE;
+	case packKeyword("map_Ks"):		return MtlKeywords::MAP_SPECULAR;
+	case packKeyword("map_d"):		return MtlKeywords::MAP_ALPHA;
+	case packKeyword("map_bump"):	return MtlKeywords::MAP_BUMP_1;
+	case packKeyword("bump"):		return MtlKeywords::MAP_BUMP_2;
+	case packKeyword("disp"):		return MtlKeywords::MAP_DISPLACEMENT;
+	case packKeyword("decal"):		return MtlKeywords::MAP_STENCIL_DECAL;
+	default:						return MtlKeywords::NULL_KEYWORD;
+	}
+}
+
+static_assert(classifyObjKeyword("vt") == TEXTURE_MAP && classifyObjKeyword("vtx") == NULL_KEYWORD, "obj keyword hash");
+static_assert(classifyMtlKeyword("map_Kd") == MtlKeywords::MAP_DIFFUSE && classifyMtlKeyword("map_Kd_") == MtlKeywords::NULL_KEYWORD, "mtl keyword hash");
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ties a cache file to the source it was built from (mesh cache, texture caches)
+//
+// a source is unchanged while its size and mtime match, when only the mtime moved (copied,
+// checked out again) the content hash decides
+
+uint64_t hashBytes(const char* bytes, size_t size);
+
+// false if the file doesn't exist
+bool sourceIdentity(const char* filename, uint64_t& outSize, int64_t& outMtime);
+
+// true if filename still has the recorded size and content
+bool sourceUnchanged(const char* filename, uint64_t size, int64_t mtime, uint64_t hash);
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "MipChain.h"
+
+// texture loading benchmarks
+//
+// startup cost of the scene's images with and without the decoded texture cache:
+// every jpg/png of the texture directory is loaded with its mip chain and every one of the cubemap
+// directory (skybox faces) without, as the scene does. decode is what startup paid before the cache
+// (stb only, mipmaps were left to the driver), cold fills an empty cache (decode, mip chain, entry
+// written) and warm maps the entries and reads them through once like an upload would. no window,
+// so nothing reaches the gpu. the fastest of the warm runs is kept
+
+struct TextureBenchmarkConfig
+{
+	std::string textureDirectory = "assets/textures";
+	std::string cubemapDirectory = "assets/skybox";	// searched recursively
+	std::string cacheDirectory = "texture_cache_bench";	// emptied before and removed after the runs
+	int warmRuns = 3;
+};
+
+struct TextureBenchmarkResult
+{
+	TextureBenchmarkConfig config;
+	size_t images = 0;
+	size_t failed = 0;					// images that didn't decode
+	unsigned long long sourceBytes = 0;	// jpg/png files
+	unsigned long long cacheBytes = 0;	// cache entries
+
+	double decodeSeconds = 0.0;
+	double coldSeconds = 0.0;
+	double warmSeconds = 0.0;
+};
+
+// throws invalid_argument if the cache directory can't be written
+TextureBenchmarkResult benchmarkTextureCache(const TextureBenchmarkConfig& config);
+
+// one json object, keys are stable so results can be compared across versions
+std::string textureBenchmarkJson(const TextureBenchmarkResult& result);
+
+// mip chains of one image built on the cpu with every filter against glGenerateMipmap
+//
+// the image is expanded to rgba8 like the caches do. every filter runs with and without sRGB
+// averaging on one and on all hardware threads, the fastest of the runs is kept. with a gl context
+// the driver's glGenerateMipmap (after a finished base level upload) is timed against uploading the
+// cpu built levels below the base, both up to glFinish
+
+struct MipBenchmarkConfig
+{
+	std::string image = "assets/textures/8k_earth_nightmap.jpg";
+	int runs = 3;
+};
+
+struct MipFilterTiming
+{
+	MipFilter filter = MipFilter::Box;
+	bool srgb = false;
+	unsigned int threads = 1;
+	double seconds = 0.0;
+};
+
+struct MipBenchmarkResult
+{
+	MipBenchmarkConfig config;
+	int width = 0, height = 0;				// 0 if the image didn't decode
+	std::vector<MipFilterTiming> cpu;
+	bool gl = false;
+	double generateMipmapSeconds = 0.0;		// glGenerateMipmap on the render thread
+	double uploadLevelsSeconds = 0.0;		// glTexImage2D of the cpu built levels
+};
+
+// the gl timings need a current context with loaded functions, withGl false skips them
+MipBenchmarkResult benchmarkMipChain(const MipBenchmarkConfig& config, bool withGl);
+
+std::string mipBenchmarkJson(const MipBenchmarkResult& result);
+
+const char* mipFilterName(MipFilter filter);
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include "CompressedTexture.h"
+#include "DecodedTextureCache.h"
+
+// textures that become resident while the scene already runs
+//
+// request hands out a texture right away, holding a 1x1 placeholder. worker threads decode the
+// images and pass them through a bounded queue (so only a few decoded images wait at a time) to the
+// render thread, which uploads them in update through a ring of pixel unpack buffers: the copy into
+// a buffer doesn't wait for the transfer of the previous image, and glTexImage2D reads from the
+// buffer instead of blocking on client memory. an image that fails to decode keeps its placeholder.
+//
+// when the driver takes S3TC the workers fetch block compressed mip chains (see CompressedTexture.h),
+// otherwise decoded texels with their mip chain (see DecodedTextureCache.h). both are mapped from
+// their cache or built and cached on first use
+
+class TextureStreamer
+{
+public:
+	// workerCount 0 uses the hardware threads minus the render thread, without a cache images that
+	// aren't block compressed are decoded on every request
+	explicit TextureStreamer(DecodedTextureCache* cache = nullptr, unsigned int workerCount = 0, size_t queueCapacity = 4);
+	// stops the workers, gl objects are left to the context
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	// render thread, returns the texture the image will be uploaded into. its mip levels are built
+	// on the workers with mips
+	GLuint request(const std::string& path, const unsigned char placeholder[4] = nullptr, const MipOptions& mips = MipOptions());
+
+	// render thread, once per frame. uploads finished images until byteBudget is spent (at least one),
+	// returns the number of textures that became resident
+	int update(size_t byteBudget = 32 * 1024 * 1024);
+
+	// every requested texture is resident (or failed)
+	bool idle() const;
+	// any thread, texture's image was uploaded (or failed), later uploads won't overwrite it
+	bool resident(GLuint texture) const;
+
+private:
+	struct Request
+	{
+		std::string path;
+		GLuint texture;
+		MipOptions mips;
+	};
+
+	// a compressed or an uncompressed mip chain, released after the upload
+	struct Image
+	{
+		std::string path;
+		GLuint texture = 0;
+		CompressedTexture compressed;
+		DecodedTexture uncompressed;
+		bool isCompressed = false;
+		bool loaded = false;		// false if the image couldn't be decoded
+		double loadSeconds = 0.0;	// decode or cache fetch on the worker
+	};
+
+	mutable std::mutex mutex;
+	std::condition_variable requestReady;	// workers wait for requests
+	std::condition_variable queueSpace;		// workers wait for room in decoded
+	std::deque<Request> requests;
+	std::deque<Image> decoded;				// at most queueCapacity images
+	size_t queueCapacity;
+	std::unordered_set<GLuint> outstanding;	// textures requested and not yet uploaded
+	bool running = true;
+	bool compressBlocks = false;			// BC1 and BC3 are supported, set before the workers start
+	DecodedTextureCache* cache;
+
+	std::vector<GLuint> unpackBuffers;		// ring of GL_PIXEL_UNPACK_BUFFERs
+	size_t nextUnpackBuffer = 0;
+
+	std::vector<std::thread> workers;
+
+	void work();
+	void upload(Image& image);
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+// tiled mip pyramids of images too large for one texture (virtual textures, see VirtualTexture.h)
+//
+// every level of the image is cut into tiles of TILE_SIZE x TILE_SIZE texels. a tile is stored with a
+// border of TILE_BORDER texels copied from its neighbours (wrapping around horizontally like the
+// longitudes of a planet map, clamped at the poles), so bilinear filtering inside its atlas slot
+// never reads the tile next to it. tiles are BC1 blocks, planet surfaces are opaque. levels halve
+// like gl's and stop at the first one that fits a single tile.
+//
+// a pyramid is built once from its source image (first run, or after the source changed) and cached
+// next to it as "<image>.tiles". building never expands the full size image to rgba: level 0 tiles are
+// cut from the decoded source and level 1 is a 2x2 box of it, the levels below use the mip filter
+// (see MipChain.h). a 32k x 16k jpg still needs its 1.6 GB decoded while the pyramid is built.
+//
+// file layout (native endianness, tiles 16 byte aligned):
+//	TilePyramidHeader
+//	TilePyramidLevel[levelCount]
+//	tiles, finest level first, each level row by row (rows bottom up, flipped for gl)
+
+static const unsigned int TILE_PYRAMID_VERSION = 2;
+static const int TILE_SIZE = 128;
+static const int TILE_BORDER = 4;
+static const int TILE_SLOT_SIZE = TILE_SIZE + 2 * TILE_BORDER;	// a tile with its border, whole 4x4 blocks
+static const int MAX_TILE_LEVELS = 16;
+static const int MAX_LEVEL_TILES = 256;	// per row and column of a level, 32768 texels
+
+struct TileLevel
+{
+	int width = 0, height = 0;		// texels
+	int tilesX = 0, tilesY = 0;
+	size_t firstTile = 0;			// index of the level's first tile
+};
+
+struct TilePyramid
+{
+	int width = 0, height = 0;		// of the source image
+	std::vector<TileLevel> levels;	// the last one is a single tile
+	size_t tileBytes = 0;			// BC1 blocks of one TILE_SLOT_SIZE tile
+
+	MappedFile file;
+	size_t dataOffset = 0;			// of the first tile in file
+
+	size_t tileCount() const;
+	const unsigned char* tile(int level, int x, int y) const;
+};
+
+std::string tilePyramidPath(const char* imageFilename);
+
+// maps a valid pyramid of imageFilename, false if it's missing, stale or of another version
+bool loadTilePyramid(const char* imageFilename, TilePyramid& outPyramid);
+
+// decodes imageFilename and writes its pyramid, tiles are encoded on threads (0 uses all hardware
+// threads). throws if the image can't be decoded, is larger than MAX_LEVEL_TILES tiles or the
+// pyramid can't be written
+void buildTilePyramid(const char* imageFilename, unsigned int threads = 0);
+
+// cached pyramid, or the pyramid built and cached first. false if the image can't be decoded or
+// the pyramid can't be written
+bool acquireTilePyramid(const char* imageFilename, TilePyramid& outPyramid);
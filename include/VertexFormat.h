@@ -0,0 +1,38 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// vertex attribute as passed to glVertexAttribPointer
+struct VertexAttrib
+{
+	int count;			// components
+	GLenum type;		// GL_FLOAT, GL_HALF_FLOAT, GL_UNSIGNED_SHORT, GL_SHORT, ...
+	bool normalized;	// integer types read as [0, 1] (unsigned) or [-1, 1] (signed) floats
+};
+
+int vertexAttribSize(const VertexAttrib& attrib);	// bytes
+int vertexStride(const std::vector<VertexAttrib>& layout);
+
+// interleaved vertex buffer described by layout
+struct PackedVertices
+{
+	std::vector<VertexAttrib> layout;
+	std::vector<uint8_t> data;
+	size_t vertexCount = 0;
+};
+
+// pack position(3)/uv(2)/normal(3) float vertices into 16-20 bytes:
+//	position	4 half floats (w = 1), or 3 floats with floatPositions
+//	uv			2 unorm16, or 2 floats when a uv is clearly outside [0, 1] (wrapping seams must stay exact)
+//	normal		octahedral, 2 snorm16 (decoded in the vertex shader, see octDecode)
+// half positions only suit meshes of a few units like the unit spheres and rings, arbitrary models
+// (scene scale, beyond 65504) keep float positions
+PackedVertices packVertices(const std::vector<float>& vertices, bool floatPositions = false);
+
+// conversion helper
+
+uint16_t floatToHalf(float value);		// round to nearest even, overflow to infinity
+void octEncode(float x, float y, float z, int16_t out[2]);
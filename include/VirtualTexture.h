@@ -0,0 +1,148 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TilePyramid.h"
+
+// surface maps larger than one texture, streamed tile by tile (virtual texturing)
+//
+// a virtual texture is the tile pyramid of its image (see TilePyramid.h). the tiles the camera needs
+// live in one physical atlas texture of BC1 slots sized by the vram budget, a page table texture per
+// virtual texture maps each tile of each level to the slot of the nearest resident tile at or above
+// it, so a missing tile samples its coarser ancestor until it streams in. the shaders (earth.frag,
+// illuminated.frag) pick the level from the texel footprint and look up the page table to find the
+// slot, two levels are blended like trilinear filtering.
+//
+// which tiles are needed is measured, not guessed: the virtual textured surfaces are drawn again into
+// a small feedback framebuffer (feedback.frag) that writes the texture, level and tile each pixel
+// would sample. it is read back through pixel pack buffers and parsed a frame or two later, without
+// waiting on the gpu. needed tiles and their ancestors are touched, missing ones are read from the
+// pyramid on a worker thread (coarsest first) and uploaded into free slots, or into the least
+// recently used slot whose tile the last feedback didn't ask for. the single tile of the coarsest
+// level stays pinned so every texel always has a fallback.
+//
+// render thread only, except for the pyramids being built or mapped and the tiles being read on
+// worker threads
+
+static const size_t VIRTUAL_TEXTURE_BUDGET = 32 * 1024 * 1024;	// atlas bytes, 3600 tiles
+static const int MAX_VIRTUAL_TEXTURES = 16;						// 4 bits in the feedback
+
+class VirtualTextureSystem
+{
+public:
+	// the atlas holds as many tiles as budgetBytes allows (fitting GL_MAX_TEXTURE_SIZE), feedback is
+	// rendered at 1 / feedbackDivisor of the viewport
+	VirtualTextureSystem(int viewportWidth, int viewportHeight, size_t budgetBytes = VIRTUAL_TEXTURE_BUDGET, int feedbackDivisor = 8);
+	// stops the worker and waits for pyramids still building, gl objects are left to the context
+	~VirtualTextureSystem();
+
+	VirtualTextureSystem(const VirtualTextureSystem&) = delete;
+	VirtualTextureSystem& operator=(const VirtualTextureSystem&) = delete;
+
+	// virtual texture of imageFilename, its pyramid is mapped or built in the background. -1 if the
+	// image doesn't exist, the driver lacks BC1 or there are MAX_VIRTUAL_TEXTURES already
+	int add(const std::string& imageFilename);
+
+	// the pyramid is mapped and its coarsest tile resident, the texture can be sampled
+	bool ready(int id) const;
+
+	// binds the atlas and page table of id to the texture units and sets the virtual texture uniforms
+	// of the program in use (virtualTextured, virtualAtlas, virtualPageTable, virtualLevels, ...)
+	void bind(GLuint program, int id, int atlasUnit, int pageTableUnit) const;
+
+	// feedback pass: begin binds the feedback framebuffer, the caller draws every virtual textured
+	// surface with the feedback program after setFeedbackUniforms. end queues the read back and
+	// restores the default framebuffer and the viewport
+	void beginFeedback();
+	void setFeedbackUniforms(GLuint program, int id) const;
+	void endFeedback();
+
+	// once per frame: parses feedback that arrived, queues the missing tiles, uploads at most
+	// uploadBudget tiles that were read and updates the changed page tables. returns the uploads
+	int update(int uploadBudget = 32);
+
+	size_t residentTiles() const;
+	size_t slotCount() const;
+
+private:
+	struct VirtualTexture
+	{
+		std::string path;
+		TilePyramid pyramid;
+		std::future<bool> opening;			// pyramid mapped or built on a worker
+		bool opened = false;
+		bool ready = false;
+
+		GLuint pageTable = 0;				// RGBA16UI: slot, level, tile x, tile y of every tile, levels stacked
+		std::vector<int> pageRows;			// first page table row of each level
+		std::vector<std::vector<int>> slots;	// per level and tile, -1 if not resident
+		std::vector<std::vector<unsigned char>> pending;	// per level and tile, queued on the worker
+		bool dirty = false;					// residency changed since the page table upload
+	};
+
+	struct Slot
+	{
+		int texture = -1;	// -1 if free
+		int level = 0, x = 0, y = 0;
+		uint64_t lastUsed = 0;	// feedback frame
+		bool pinned = false;
+	};
+
+	struct TileRequest
+	{
+		int texture;
+		int level, x, y;
+		const TilePyramid* pyramid;
+	};
+
+	struct LoadedTile
+	{
+		int texture;
+		int level, x, y;
+		std::vector<unsigned char> blocks;
+	};
+
+	bool supported = false;
+	int feedbackDivisor;
+	int feedbackWidth, feedbackHeight;
+
+	GLuint atlas = 0;
+	int slotsPerRow = 0;
+	std::vector<Slot> slots;
+	std::vector<int> freeSlots;
+	size_t resident = 0;
+	uint64_t feedbackFrame = 1;			// feedbacks parsed so far
+
+	GLuint feedbackFramebuffer = 0, feedbackColor = 0, feedbackDepth = 0;
+	GLuint packBuffers[2] = { 0, 0 };	// read backs in flight
+	GLsync packFences[2] = { nullptr, nullptr };
+	int nextPackBuffer = 0;
+	GLint previousViewport[4] = { 0, 0, 0, 0 };
+
+	std::vector<std::unique_ptr<VirtualTexture>> textures;
+
+	// worker reading tiles out of the mapped pyramids
+	std::mutex mutex;
+	std::condition_variable requestReady;
+	std::deque<TileRequest> requests;
+	std::deque<LoadedTile> loaded;
+	size_t outstanding = 0;				// queued or read, not yet uploaded
+	bool running = true;
+	std::thread worker;
+
+	void work();
+	void open(int id);
+	void readFeedback();
+	void request(int id, int level, int x, int y);
+	bool upload(LoadedTile& tile);
+	int allocateSlot();
+	void updatePageTable(VirtualTexture& texture);
+};
@@ -1,17 +1,22 @@
 #pragma once
 #include <glad/glad.h>
+#include <string>
 #include "util.h"
 
-unsigned int LoadShader(const char* vertexShaderFile, const char* fragmentShaderFile)
+// compiles and links both stages, compiled is false if a stage is missing, doesn't compile or doesn't link
+// fragmentLibraryFile: optional shared source (no #version) inserted after the #version line of the fragment stage
+unsigned int CompileShaderProgram(const char* vertexShaderFile, const char* fragmentShaderFile, bool& compiled, const char* fragmentLibraryFile = NULL)
 {
 	int success;
 	char infoLog[512];
+	compiled = true;
 
 	// create the shader
 	unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
 
 	// load shader code as raw string
 	char* vertexShaderSource = read_file(vertexShaderFile);
+	if (vertexShaderSource == NULL) vertexShaderSource = _strdup("");
 
 	// load shader source code into OpenGL
 	glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
@@ -25,18 +30,51 @@ unsigned int LoadShader(const char* vertexShaderFile, const char* fragmentShader
 	{
 		glGetShaderInfoLog(vertexShader, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::VERTEX::COMPILATION_FAILED\n" << infoLog << std::endl;
+		compiled = false;
 	}
 
 	// same things as vertex shader just that this is fragment shader
 	unsigned int fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
 	char* fragmentShaderSource = read_file(fragmentShaderFile);
-	glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+	if (fragmentShaderSource == NULL) fragmentShaderSource = _strdup("");
+	char* fragmentLibrarySource = NULL;
+	if (fragmentLibraryFile != NULL)
+	{
+		fragmentLibrarySource = read_file(fragmentLibraryFile);
+		if (fragmentLibrarySource == NULL)
+		{
+			std::cout << "ERROR::SHADER::FRAGMENT::LIBRARY_NOT_FOUND\n" << fragmentLibraryFile << std::endl;
+			fragmentLibrarySource = _strdup("");
+			compiled = false;
+		}
+	}
+	if (fragmentLibrarySource == NULL)
+	{
+		glShaderSource(fragmentShader, 1, &fragmentShaderSource, NULL);
+	}
+	else
+	{
+		// #version has to stay first, the library goes right after it and #line keeps the
+		// error lines of the shader itself right
+		std::string source = fragmentShaderSource;
+		size_t split = 0;
+		if (source.compare(0, 8, "#version") == 0)
+		{
+			split = source.find('\n');
+			split = split == std::string::npos ? source.size() : split + 1;
+		}
+		std::string head = source.substr(0, split);
+		std::string rest = "\n#line " + std::to_string(split == 0 ? 1 : 2) + "\n" + source.substr(split);
+		const char* sources[3] = { head.c_str(), fragmentLibrarySource, rest.c_str() };
+		glShaderSource(fragmentShader, 3, sources, NULL);
+	}
 	glCompileShader(fragmentShader);
 	glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
 	if (!success)
 	{
 		glGetShaderInfoLog(fragmentShader, 512, NULL, infoLog);
 		std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+		compiled = false;
 	}
 
 
@@ -49,15 +87,47 @@ unsigned int LoadShader(const char* vertexShaderFile, const char* fragmentShader
 
 	// link shader program
 	glLinkProgram(shaderProgram);
+	glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+	if (!success)
+	{
+		glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+		std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+		compiled = false;
+	}
 
 
 	// free memory from read_file
 	free(vertexShaderSource);
 	free(fragmentShaderSource);
+	free(fragmentLibrarySource);
 
 	// remove shader after they are no longer needed
 	glDeleteShader(vertexShader);
 	glDeleteShader(fragmentShader);
 
 	return shaderProgram;
-}
\ No newline at end of file
+}
+
+unsigned int LoadShader(const char* vertexShaderFile, const char* fragmentShaderFile, const char* fragmentLibraryFile = NULL)
+{
+	bool compiled;
+	return CompileShaderProgram(vertexShaderFile, fragmentShaderFile, compiled, fragmentLibraryFile);
+}
+
+// replaces shaderProgram with a freshly compiled one, a program that fails to compile or link is
+// dropped and the previous one kept. returns whether shaderProgram changed
+bool ReloadShader(const char* vertexShaderFile, const char* fragmentShaderFile, unsigned int& shaderProgram, const char* fragmentLibraryFile = NULL)
+{
+	bool compiled;
+	unsigned int reloaded = CompileShaderProgram(vertexShaderFile, fragmentShaderFile, compiled, fragmentLibraryFile);
+	if (!compiled)
+	{
+		glDeleteProgram(reloaded);
+		std::cout << "Shader reload failed, previous program kept: " << vertexShaderFile << ", " << fragmentShaderFile << std::endl;
+		return false;
+	}
+
+	glDeleteProgram(shaderProgram);
+	shaderProgram = reloaded;
+	return true;
+}
@@ -10,3 +10,38 @@
 std::vector<float> getSkyboxCube();
 std::vector<float> getRectangle();
 std::vector<float> getCircle(int num_segments, float radius);
+
+// indexed mesh, vertices are position(3)/uv(2)/normal(3) like ObjFileReader's indexedVertices
+struct ShapeMesh
+{
+	std::vector<float> vertices;
+	std::vector<unsigned int> indices;
+	float error = 0.f;	// largest distance from the ideal surface, relative to the radius
+};
+
+enum class SphereType
+{
+	UV,		// latitude/longitude grid, texels map exactly onto equirectangular textures
+	ICO		// subdivided icosahedron, evenly sized triangles
+};
+
+static const int SPHERE_LEVEL_COUNT = 6;	// tessellation levels of getSphereLevel
+
+// uvs match the blender sphere (u = 0 towards -z, growing towards -x, v = 0 at the south pole),
+// seam vertices are split so u runs up to 1, normals are analytic
+ShapeMesh getUVSphere(int segments, int rings, float radius);
+ShapeMesh getIcosphere(int subdivisions, float radius);
+
+// level 0 is the coarsest (uv: 4 segments, ico: no subdivision), each level doubles the tessellation.
+// built and cache optimized on first use, then kept (not thread safe)
+const ShapeMesh& getSphereLevel(SphereType type, int level, float radius);
+
+static const int RING_LEVEL_COUNT = 6;		// tessellation levels of getRingLevel
+
+// flat ring around the y axis, a face on each side of the xz plane thickness apart.
+// v is radial and matches the tube of the blender torus rings: 0 -> 0.5 from the inner to the outer
+// edge underneath, then back to 1 on top, u goes around (u = 0.5 - atan2(z, x) / 2pi)
+ShapeMesh getRing(int segments, float innerRadius, float outerRadius, float thickness);
+
+// level 0 has 8 segments, each level doubles them, cached like getSphereLevel
+const ShapeMesh& getRingLevel(int level, float innerRadius, float outerRadius, float thickness);
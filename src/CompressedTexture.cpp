@@ -0,0 +1,527 @@
+#include "CompressedTexture.h"
+#include "MipChain.h"
+#include "SourceIdentity.h"
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <thread>
+
+using namespace std;
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+static const char COMPRESSED_TEXTURE_MAGIC[8] = { 'S', 'S', 'B', 'C', 'T', 'E', 'X', 0 };
+
+// block rows per thread below which encoding a level stays on one thread
+static const int MIN_BLOCK_ROWS = 16;
+
+struct CompressedTextureHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t format;
+
+	// source identity
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t mipOptions;	// MipOptions::key
+};
+
+struct CompressedTextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;	// from the start of the file
+	uint64_t size;
+};
+
+
+// ================= helpers ====================
+
+static size_t blockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t compressedLevelSize(BlockFormat format, int width, int height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes(format);
+}
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+
+// ================= block encoders ====================
+
+static uint16_t packColor565(const float color[3])
+{
+	int r = (int)(max(0.f, min(255.f, color[0])) * 31.f / 255.f + 0.5f);
+	int g = (int)(max(0.f, min(255.f, color[1])) * 63.f / 255.f + 0.5f);
+	int b = (int)(max(0.f, min(255.f, color[2])) * 31.f / 255.f + 0.5f);
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void unpackColor565(uint16_t packed, float color[3])
+{
+	int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+	color[0] = (float)((r << 3) | (r >> 2));
+	color[1] = (float)((g << 2) | (g >> 4));
+	color[2] = (float)((b << 3) | (b >> 2));
+}
+
+// palette of two quantized endpoints (four color mode), indices of the nearest entries and the squared error
+static float fitIndices(const float texels[16][3], uint16_t c0, uint16_t c1, uint32_t& outIndices)
+{
+	float palette[4][3];
+	unpackColor565(c0, palette[0]);
+	unpackColor565(c1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+		palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+	}
+
+	float error = 0.f;
+	outIndices = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		int best = 0;
+		float bestDistance = INFINITY;
+		for (int p = 0; p < 4; p++)
+		{
+			float dr = texels[i][0] - palette[p][0], dg = texels[i][1] - palette[p][1], db = texels[i][2] - palette[p][2];
+			float distance = dr * dr + dg * dg + db * db;
+			if (distance < bestDistance)
+			{
+				bestDistance = distance;
+				best = p;
+			}
+		}
+		outIndices |= (uint32_t)best << (i * 2);
+		error += bestDistance;
+	}
+	return error;
+}
+
+// endpoints along the principal axis of the block's colors, then one least squares refit of the
+// endpoints to the chosen indices
+static void encodeColorBlock(const unsigned char rgba[16][4], unsigned char out[8])
+{
+	float texels[16][3];
+	float mean[3] = { 0.f, 0.f, 0.f };
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			texels[i][c] = rgba[i][c];
+			mean[c] += texels[i][c] / 16.f;
+		}
+	}
+
+	float covariance[6] = { 0.f };	// rr rg rb gg gb bb
+	for (int i = 0; i < 16; i++)
+	{
+		float r = texels[i][0] - mean[0], g = texels[i][1] - mean[1], b = texels[i][2] - mean[2];
+		covariance[0] += r * r; covariance[1] += r * g; covariance[2] += r * b;
+		covariance[3] += g * g; covariance[4] += g * b; covariance[5] += b * b;
+	}
+
+	// power iteration, converges in a few steps for the dominant axis
+	float axis[3] = { 1.f, 1.f, 1.f };
+	for (int iteration = 0; iteration < 6; iteration++)
+	{
+		float next[3] = {
+			covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+			covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+			covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2],
+		};
+		float length = max(fabsf(next[0]), max(fabsf(next[1]), fabsf(next[2])));
+		if (length == 0.f) break;
+		for (int c = 0; c < 3; c++) axis[c] = next[c] / length;
+	}
+
+	int low = 0, high = 0;
+	float lowT = INFINITY, highT = -INFINITY;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = (texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2];
+		if (t < lowT) { lowT = t; low = i; }
+		if (t > highT) { highT = t; high = i; }
+	}
+
+	uint16_t c0 = packColor565(texels[high]), c1 = packColor565(texels[low]);
+	uint32_t indices;
+	float error = fitIndices(texels, c0, c1, indices);
+
+	// refit: every index weighs the two endpoints, solve the 2x2 normal equations per channel
+	static const float WEIGHT0[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f };
+	float aa = 0.f, ab = 0.f, bb = 0.f, ax[3] = { 0.f }, bx[3] = { 0.f };
+	for (int i = 0; i < 16; i++)
+	{
+		float a = WEIGHT0[(indices >> (i * 2)) & 3], b = 1.f - a;
+		aa += a * a; ab += a * b; bb += b * b;
+		for (int c = 0; c < 3; c++)
+		{
+			ax[c] += a * texels[i][c];
+			bx[c] += b * texels[i][c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) > 1e-6f)
+	{
+		float e0[3], e1[3];
+		for (int c = 0; c < 3; c++)
+		{
+			e0[c] = (ax[c] * bb - bx[c] * ab) / determinant;
+			e1[c] = (bx[c] * aa - ax[c] * ab) / determinant;
+		}
+		uint16_t r0 = packColor565(e0), r1 = packColor565(e1);
+		uint32_t refitIndices;
+		float refitError = fitIndices(texels, r0, r1, refitIndices);
+		if (refitError < error)
+		{
+			c0 = r0;
+			c1 = r1;
+			indices = refitIndices;
+		}
+	}
+
+	// c0 > c1 selects the four color mode, swapping the endpoints swaps index 0/1 and 2/3
+	if (c0 < c1)
+	{
+		swap(c0, c1);
+		indices ^= 0x55555555u;
+	}
+	else if (c0 == c1)
+	{
+		indices = 0;
+	}
+
+	out[0] = (unsigned char)(c0 & 0xff); out[1] = (unsigned char)(c0 >> 8);
+	out[2] = (unsigned char)(c1 & 0xff); out[3] = (unsigned char)(c1 >> 8);
+	for (int i = 0; i < 4; i++) out[4 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+// eight interpolated alphas between the block's extremes
+static void encodeAlphaBlock(const unsigned char rgba[16][4], unsigned char out[8])
+{
+	int a0 = 0, a1 = 255;
+	for (int i = 0; i < 16; i++)
+	{
+		a0 = max(a0, (int)rgba[i][3]);
+		a1 = min(a1, (int)rgba[i][3]);
+	}
+
+	uint64_t indices = 0;
+	if (a0 > a1)
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			// steps from a1 (0) to a0 (7), palette index 0 is a0, 1 is a1, 2..7 the steps in between from a0 down
+			int step = (int)((float)(rgba[i][3] - a1) * 7.f / (float)(a0 - a1) + 0.5f);
+			uint64_t index = step == 7 ? 0 : step == 0 ? 1 : (uint64_t)(8 - step);
+			indices |= index << (i * 3);
+		}
+	}
+
+	out[0] = (unsigned char)a0;
+	out[1] = (unsigned char)a1;
+	for (int i = 0; i < 6; i++) out[2 + i] = (unsigned char)(indices >> (i * 8));
+}
+
+void encodeBlocks(const unsigned char* rgba, int width, int height, BlockFormat format, unsigned char* out, unsigned int threads)
+{
+	int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+	size_t bytesPerBlock = blockBytes(format);
+
+	auto encodeRows = [&](int firstRow, int lastRow) {
+		unsigned char block[16][4];
+		for (int by = firstRow; by < lastRow; by++)
+		{
+			for (int bx = 0; bx < blocksX; bx++)
+			{
+				// partial blocks at the edges repeat the last row/column
+				for (int i = 0; i < 16; i++)
+				{
+					int x = min(bx * 4 + (i & 3), width - 1), y = min(by * 4 + (i >> 2), height - 1);
+					memcpy(block[i], &rgba[((size_t)y * width + x) * 4], 4);
+				}
+				unsigned char* dst = out + ((size_t)by * blocksX + bx) * bytesPerBlock;
+				if (format == BlockFormat::BC3)
+				{
+					encodeAlphaBlock(block, dst);
+					encodeColorBlock(block, dst + 8);
+				}
+				else
+				{
+					encodeColorBlock(block, dst);
+				}
+			}
+		}
+	};
+
+	int rangeCount = (int)min<unsigned int>(threads, (unsigned int)max(1, blocksY / MIN_BLOCK_ROWS));
+	if (rangeCount <= 1)
+	{
+		encodeRows(0, blocksY);
+		return;
+	}
+
+	int step = (blocksY + rangeCount - 1) / rangeCount;
+	vector<future<void>> futures;
+	for (int first = 0; first < blocksY; first += step)
+	{
+		futures.push_back(async(launch::async, encodeRows, first, min(blocksY, first + step)));
+	}
+	for (future<void>& f : futures) f.get();
+}
+
+
+// ================= CompressedTexture ====================
+
+const unsigned char* CompressedTexture::data() const
+{
+	return file.isOpen() ? (const unsigned char*)file.begin() + fileOffset : blocks.data();
+}
+
+size_t CompressedTexture::byteSize() const
+{
+	size_t size = 0;
+	for (const CompressedLevel& level : levels) size += level.size;
+	return size;
+}
+
+CompressedTexture compressTexture(const unsigned char* pixels, int width, int height, int nrComponents, unsigned int threads, const MipOptions& mips)
+{
+	if (!pixels || width <= 0 || height <= 0 || nrComponents < 1 || nrComponents > 4)
+		throw invalid_argument("CompressedTexture::invalid image");
+	if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+
+	vector<unsigned char> rgba;
+	bool hasAlpha = expandToRgba(pixels, width, height, nrComponents, rgba);
+
+	CompressedTexture texture;
+	texture.format = hasAlpha ? BlockFormat::BC3 : BlockFormat::BC1;
+	texture.width = width;
+	texture.height = height;
+	texture.mipOptions = mips.key();
+
+	// level sizes first so the blocks are allocated once
+	size_t totalSize = 0;
+	for (int w = width, h = height;; w = max(1, w / 2), h = max(1, h / 2))
+	{
+		CompressedLevel level;
+		level.width = w;
+		level.height = h;
+		level.offset = totalSize;
+		level.size = compressedLevelSize(texture.format, w, h);
+		texture.levels.push_back(level);
+		totalSize += level.size;
+		if (w == 1 && h == 1) break;
+	}
+	texture.blocks.resize(totalSize);
+
+	encodeBlocks(rgba.data(), width, height, texture.format, texture.blocks.data(), threads);
+	buildMipChain(rgba.data(), width, height, 4, mips, threads, [&](int level, const unsigned char* texels, int levelWidth, int levelHeight) {
+		encodeBlocks(texels, levelWidth, levelHeight, texture.format, texture.blocks.data() + texture.levels[level].offset, threads);
+	});
+	return texture;
+}
+
+string compressedTexturePath(const char* imageFilename)
+{
+	return string(imageFilename) + ".bctex";
+}
+
+bool loadCompressedTexture(const char* imageFilename, CompressedTexture& outTexture, const MipOptions& mips)
+{
+	MappedFile cacheFile;
+	if (!cacheFile.open(compressedTexturePath(imageFilename).c_str())) return false;
+	if (cacheFile.size() < sizeof(CompressedTextureHeader)) return false;
+
+	CompressedTextureHeader header;
+	memcpy(&header, cacheFile.begin(), sizeof(header));
+
+	// format checks
+	if (memcmp(header.magic, COMPRESSED_TEXTURE_MAGIC, sizeof(COMPRESSED_TEXTURE_MAGIC)) != 0) return false;
+	if (header.version != COMPRESSED_TEXTURE_VERSION) return false;
+	if (header.format != (uint32_t)BlockFormat::BC1 && header.format != (uint32_t)BlockFormat::BC3) return false;
+	if (header.width == 0 || header.height == 0 || header.levelCount == 0 || header.levelCount > 32) return false;
+	if (header.mipOptions != mips.key()) return false;
+	if (sizeof(CompressedTextureHeader) + (size_t)header.levelCount * sizeof(CompressedTextureLevel) > cacheFile.size()) return false;
+
+	CompressedTexture texture;
+	texture.format = (BlockFormat)header.format;
+	texture.width = (int)header.width;
+	texture.height = (int)header.height;
+	texture.mipOptions = header.mipOptions;
+	uint64_t nextOffset = 0;
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		CompressedTextureLevel record;
+		memcpy(&record, cacheFile.begin() + sizeof(CompressedTextureHeader) + i * sizeof(CompressedTextureLevel), sizeof(record));
+		if (record.width == 0 || record.height == 0 || record.size != compressedLevelSize(texture.format, (int)record.width, (int)record.height)) return false;
+		if (record.offset > cacheFile.size() || record.size > cacheFile.size() - record.offset) return false;
+
+		// levels are back to back so the whole chain is one copy
+		if (i == 0) texture.fileOffset = (size_t)record.offset;
+		else if (record.offset != nextOffset) return false;
+		nextOffset = record.offset + record.size;
+
+		CompressedLevel level;
+		level.width = (int)record.width;
+		level.height = (int)record.height;
+		level.offset = (size_t)(record.offset - texture.fileOffset);
+		level.size = (size_t)record.size;
+		texture.levels.push_back(level);
+	}
+
+	// source checks, the content hash is only computed when the size matches but the mtime moved
+	if (!sourceUnchanged(imageFilename, header.sourceSize, header.sourceMtime, header.sourceHash)) return false;
+
+	texture.file = move(cacheFile);
+	outTexture = move(texture);
+	return true;
+}
+
+void writeCompressedTexture(const char* imageFilename, const CompressedTexture& texture)
+{
+	CompressedTextureHeader header{};
+	memcpy(header.magic, COMPRESSED_TEXTURE_MAGIC, sizeof(COMPRESSED_TEXTURE_MAGIC));
+	header.version = COMPRESSED_TEXTURE_VERSION;
+	header.format = (uint32_t)texture.format;
+	header.width = (uint32_t)texture.width;
+	header.height = (uint32_t)texture.height;
+	header.levelCount = (uint32_t)texture.levels.size();
+	header.mipOptions = texture.mipOptions;
+
+	if (!sourceIdentity(imageFilename, header.sourceSize, header.sourceMtime))
+		throw invalid_argument("CompressedTexture::source file doesn't exist");
+	MappedFile sourceFile;
+	if (!sourceFile.open(imageFilename)) throw invalid_argument("CompressedTexture::source file can't be read");
+	header.sourceHash = hashBytes(sourceFile.begin(), sourceFile.size());
+
+	// levels follow each other in the file as in memory, only shifted by the aligned table
+	uint64_t dataOffset = alignUp(sizeof(CompressedTextureHeader) + texture.levels.size() * sizeof(CompressedTextureLevel), 16);
+	vector<CompressedTextureLevel> records;
+	for (const CompressedLevel& level : texture.levels)
+	{
+		records.push_back(CompressedTextureLevel{ (uint32_t)level.width, (uint32_t)level.height, dataOffset + level.offset, level.size });
+	}
+
+	// write to a temporary file first so a crash never leaves a half written cache behind
+	string cacheFilename = compressedTexturePath(imageFilename);
+	string tempFilename = cacheFilename + ".tmp";
+	{
+		ofstream out(tempFilename, ios::binary | ios::trunc);
+		if (!out.good()) throw invalid_argument("CompressedTexture::can't create cache file");
+
+		static const char zeros[16] = {};
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)records.data(), records.size() * sizeof(CompressedTextureLevel));
+		out.write(zeros, (streamsize)(dataOffset - (uint64_t)out.tellp()));
+		out.write((const char*)texture.data(), (streamsize)texture.byteSize());
+
+		if (!out.good()) throw invalid_argument("CompressedTexture::fail writing cache file");
+	}
+
+	error_code ec;
+	filesystem::rename(tempFilename, cacheFilename, ec);
+	if (ec)
+	{
+		filesystem::remove(tempFilename, ec);
+		throw invalid_argument("CompressedTexture::can't replace cache file");
+	}
+}
+
+bool acquireCompressedTexture(const char* imageFilename, CompressedTexture& outTexture, const MipOptions& mips)
+{
+	if (loadCompressedTexture(imageFilename, outTexture, mips)) return true;
+
+	int width, height, nrComponents;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* pixels = stbi_load(imageFilename, &width, &height, &nrComponents, 0);
+	if (!pixels) return false;
+
+	try
+	{
+		outTexture = compressTexture(pixels, width, height, nrComponents, 0, mips);
+	}
+	catch (...)
+	{
+		stbi_image_free(pixels);
+		throw;
+	}
+	stbi_image_free(pixels);
+
+	try
+	{
+		writeCompressedTexture(imageFilename, outTexture);
+	}
+	catch (const std::exception& e)
+	{
+		cout << "Fail writing texture cache: " << e.what() << endl;
+	}
+	return true;
+}
+
+
+// ================= gl ====================
+
+GLenum compressedInternalFormat(BlockFormat format)
+{
+	return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+bool compressedFormatSupported(BlockFormat format)
+{
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+	if (count <= 0) return false;
+
+	vector<GLint> formats(count);
+	glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, formats.data());
+	return find(formats.begin(), formats.end(), (GLint)compressedInternalFormat(format)) != formats.end();
+}
+
+void uploadCompressedLevels(const CompressedTexture& texture, const unsigned char* levelData)
+{
+	GLenum format = compressedInternalFormat(texture.format);
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		const CompressedLevel& level = texture.levels[i];
+		const void* pixels = (const void*)((uintptr_t)levelData + level.offset);
+		glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, format, level.width, level.height, 0, (GLsizei)level.size, pixels);
+	}
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+}
+
+size_t uncompressedTextureBytes(int width, int height)
+{
+	size_t size = 0;
+	for (int w = width, h = height;; w = max(1, w / 2), h = max(1, h / 2))
+	{
+		size += (size_t)w * h * 4;
+		if (w == 1 && h == 1) break;
+	}
+	return size;
+}
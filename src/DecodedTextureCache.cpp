@@ -0,0 +1,401 @@
+#include "DecodedTextureCache.h"
+#include "MipChain.h"
+#include "SourceIdentity.h"
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+using namespace std;
+
+static const char DECODED_TEXTURE_MAGIC[8] = { 'S', 'S', 'T', 'E', 'X', 'C', 'H', 0 };
+static const char* ENTRY_EXTENSION = ".texcache";
+static const uint32_t MAX_PATH_LENGTH = 4096;
+
+struct DecodedTextureHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t nrComponents;
+
+	// source identity
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t levelCount;
+	uint32_t pathLength;	// source path right after the header, not terminated
+	uint32_t mipOptions;	// MipOptions::key
+	uint32_t padding;
+};
+
+struct DecodedTextureLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint64_t offset;	// from the start of the file
+	uint64_t size;
+};
+
+
+// ================= helpers ====================
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// the same file reached as "a/b.png" or "a/./b.png" shares one entry
+static string normalizedPath(const char* filename)
+{
+	return filesystem::path(filename).lexically_normal().generic_string();
+}
+
+static bool isEntry(const filesystem::directory_entry& entry)
+{
+	return entry.is_regular_file() && entry.path().extension() == ENTRY_EXTENSION;
+}
+
+
+// ================= DecodedTexture ====================
+
+const unsigned char* DecodedTexture::data() const
+{
+	return file.isOpen() ? (const unsigned char*)file.begin() + fileOffset : pixels.data();
+}
+
+size_t DecodedTexture::byteSize() const
+{
+	size_t size = 0;
+	for (const DecodedLevel& level : levels) size += level.size;
+	return size;
+}
+
+DecodedTexture buildDecodedTexture(const unsigned char* pixels, int width, int height, int nrComponents, bool mipmaps, const MipOptions& mips, unsigned int threads)
+{
+	if (!pixels || width <= 0 || height <= 0 || nrComponents < 1 || nrComponents > 4)
+		throw invalid_argument("DecodedTextureCache::invalid image");
+
+	DecodedTexture texture;
+	texture.width = width;
+	texture.height = height;
+	texture.nrComponents = nrComponents == 1 ? 1 : 4;
+	texture.mipOptions = mips.key();
+
+	// level sizes first so the texels are allocated once
+	size_t totalSize = 0;
+	int levelCount = mipmaps ? mipLevelCount(width, height) : 1;
+	for (int i = 0, w = width, h = height; i < levelCount; i++, w = max(1, w / 2), h = max(1, h / 2))
+	{
+		DecodedLevel level;
+		level.width = w;
+		level.height = h;
+		level.offset = totalSize;
+		level.size = (size_t)w * h * texture.nrComponents;
+		texture.levels.push_back(level);
+		totalSize += level.size;
+	}
+	texture.pixels.resize(totalSize);
+
+	const DecodedLevel& base = texture.levels[0];
+	if (texture.nrComponents == 1)
+	{
+		memcpy(texture.pixels.data(), pixels, base.size);
+	}
+	else
+	{
+		vector<unsigned char> rgba;
+		expandToRgba(pixels, width, height, nrComponents, rgba);
+		memcpy(texture.pixels.data(), rgba.data(), base.size);
+	}
+
+	if (mipmaps)
+	{
+		buildMipChain(texture.pixels.data(), width, height, texture.nrComponents, mips, threads, [&](int level, const unsigned char* texels, int, int) {
+			memcpy(texture.pixels.data() + texture.levels[level].offset, texels, texture.levels[level].size);
+		});
+	}
+	return texture;
+}
+
+bool decodeTexture(const char* imageFilename, bool mipmaps, DecodedTexture& outTexture, const MipOptions& mips)
+{
+	int width, height, nrComponents;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* pixels = stbi_load(imageFilename, &width, &height, &nrComponents, 0);
+	if (!pixels) return false;
+
+	try
+	{
+		outTexture = buildDecodedTexture(pixels, width, height, nrComponents, mipmaps, mips);
+	}
+	catch (...)
+	{
+		stbi_image_free(pixels);
+		throw;
+	}
+	stbi_image_free(pixels);
+	return true;
+}
+
+
+// ================= DecodedTextureCache ====================
+
+DecodedTextureCache::DecodedTextureCache(const string& directory, uint64_t capacityBytes) : directory(directory), capacity(capacityBytes)
+{
+}
+
+bool DecodedTextureCache::load(const char* imageFilename, bool mipmaps, DecodedTexture& outTexture, const MipOptions& mips)
+{
+	string entryFilename = entryPath(imageFilename);
+	MappedFile entryFile;
+	if (!entryFile.open(entryFilename.c_str())) return false;
+	if (entryFile.size() < sizeof(DecodedTextureHeader)) return false;
+
+	DecodedTextureHeader header;
+	memcpy(&header, entryFile.begin(), sizeof(header));
+
+	// format checks
+	if (memcmp(header.magic, DECODED_TEXTURE_MAGIC, sizeof(DECODED_TEXTURE_MAGIC)) != 0) return false;
+	if (header.version != DECODED_TEXTURE_VERSION) return false;
+	if (header.nrComponents != 1 && header.nrComponents != 4) return false;
+	if (header.width == 0 || header.height == 0 || header.pathLength > MAX_PATH_LENGTH) return false;
+	int fullChain = mipLevelCount((int)header.width, (int)header.height);
+	if (header.levelCount != 1 && header.levelCount != (uint32_t)fullChain) return false;
+	if (mipmaps && ((int)header.levelCount != fullChain || (fullChain > 1 && header.mipOptions != mips.key()))) return false;
+	size_t tableOffset = sizeof(DecodedTextureHeader) + header.pathLength;
+	if (tableOffset + (size_t)header.levelCount * sizeof(DecodedTextureLevel) > entryFile.size()) return false;
+
+	// another path with the same hash
+	string path = normalizedPath(imageFilename);
+	if (path.size() != header.pathLength || memcmp(path.data(), entryFile.begin() + sizeof(DecodedTextureHeader), path.size()) != 0) return false;
+
+	DecodedTexture texture;
+	texture.width = (int)header.width;
+	texture.height = (int)header.height;
+	texture.nrComponents = (int)header.nrComponents;
+	texture.mipOptions = header.mipOptions;
+	uint32_t levelCount = mipmaps ? header.levelCount : 1;
+	uint64_t nextOffset = 0;
+	for (uint32_t i = 0; i < levelCount; i++)
+	{
+		DecodedTextureLevel record;
+		memcpy(&record, entryFile.begin() + tableOffset + i * sizeof(DecodedTextureLevel), sizeof(record));
+		uint32_t width = max(1u, header.width >> i), height = max(1u, header.height >> i);
+		if (record.width != width || record.height != height || record.size != (uint64_t)width * height * header.nrComponents) return false;
+		if (record.offset > entryFile.size() || record.size > entryFile.size() - record.offset) return false;
+
+		// levels are back to back so the whole chain is one copy
+		if (i == 0) texture.fileOffset = (size_t)record.offset;
+		else if (record.offset != nextOffset) return false;
+		nextOffset = record.offset + record.size;
+
+		DecodedLevel level;
+		level.width = (int)record.width;
+		level.height = (int)record.height;
+		level.offset = (size_t)(record.offset - texture.fileOffset);
+		level.size = (size_t)record.size;
+		texture.levels.push_back(level);
+	}
+
+	// source checks, the content hash is only computed when the size matches but the mtime moved
+	if (!sourceUnchanged(imageFilename, header.sourceSize, header.sourceMtime, header.sourceHash)) return false;
+
+	// the mtime orders the entries for eviction
+	error_code ec;
+	filesystem::last_write_time(entryFilename, filesystem::file_time_type::clock::now(), ec);
+
+	texture.file = move(entryFile);
+	outTexture = move(texture);
+	return true;
+}
+
+void DecodedTextureCache::write(const char* imageFilename, const DecodedTexture& texture)
+{
+	string path = normalizedPath(imageFilename);
+	if (path.size() > MAX_PATH_LENGTH) throw invalid_argument("DecodedTextureCache::source path too long");
+
+	DecodedTextureHeader header{};
+	memcpy(header.magic, DECODED_TEXTURE_MAGIC, sizeof(DECODED_TEXTURE_MAGIC));
+	header.version = DECODED_TEXTURE_VERSION;
+	header.nrComponents = (uint32_t)texture.nrComponents;
+	header.width = (uint32_t)texture.width;
+	header.height = (uint32_t)texture.height;
+	header.levelCount = (uint32_t)texture.levels.size();
+	header.pathLength = (uint32_t)path.size();
+	header.mipOptions = texture.mipOptions;
+
+	if (!sourceIdentity(imageFilename, header.sourceSize, header.sourceMtime))
+		throw invalid_argument("DecodedTextureCache::source file doesn't exist");
+	MappedFile sourceFile;
+	if (!sourceFile.open(imageFilename)) throw invalid_argument("DecodedTextureCache::source file can't be read");
+	header.sourceHash = hashBytes(sourceFile.begin(), sourceFile.size());
+
+	// levels follow each other in the file as in memory, only shifted by the aligned header
+	uint64_t dataOffset = alignUp(sizeof(DecodedTextureHeader) + path.size() + texture.levels.size() * sizeof(DecodedTextureLevel), 16);
+	vector<DecodedTextureLevel> records;
+	for (const DecodedLevel& level : texture.levels)
+	{
+		records.push_back(DecodedTextureLevel{ (uint32_t)level.width, (uint32_t)level.height, dataOffset + level.offset, level.size });
+	}
+
+	error_code ec;
+	filesystem::create_directories(directory, ec);
+	if (ec) throw invalid_argument("DecodedTextureCache::can't create cache directory");
+
+	// write to a temporary file first so a crash never leaves a half written entry behind
+	string entryFilename = entryPath(imageFilename);
+	string tempFilename = entryFilename + "." + to_string(writeCount++) + ".tmp";
+	{
+		ofstream out(tempFilename, ios::binary | ios::trunc);
+		if (!out.good()) throw invalid_argument("DecodedTextureCache::can't create cache entry");
+
+		static const char zeros[16] = {};
+		out.write((const char*)&header, sizeof(header));
+		out.write(path.data(), (streamsize)path.size());
+		out.write((const char*)records.data(), records.size() * sizeof(DecodedTextureLevel));
+		out.write(zeros, (streamsize)(dataOffset - (uint64_t)out.tellp()));
+		out.write((const char*)texture.data(), (streamsize)texture.byteSize());
+
+		if (!out.good())
+		{
+			out.close();
+			filesystem::remove(tempFilename, ec);
+			throw invalid_argument("DecodedTextureCache::fail writing cache entry");
+		}
+	}
+
+	filesystem::rename(tempFilename, entryFilename, ec);
+	if (ec)
+	{
+		filesystem::remove(tempFilename, ec);
+		throw invalid_argument("DecodedTextureCache::can't replace cache entry");
+	}
+
+	evict();
+}
+
+bool DecodedTextureCache::acquire(const char* imageFilename, bool mipmaps, DecodedTexture& outTexture, const MipOptions& mips)
+{
+	if (load(imageFilename, mipmaps, outTexture, mips)) return true;
+	if (!decodeTexture(imageFilename, mipmaps, outTexture, mips)) return false;
+
+	try
+	{
+		write(imageFilename, outTexture);
+	}
+	catch (const std::exception& e)
+	{
+		cout << "Fail writing texture cache: " << e.what() << endl;
+	}
+	return true;
+}
+
+uint64_t DecodedTextureCache::evict()
+{
+	lock_guard<mutex> lock(evictMutex);
+
+	struct Entry
+	{
+		filesystem::path path;
+		uint64_t size;
+		filesystem::file_time_type lastUse;
+	};
+	vector<Entry> entries;
+	uint64_t total = 0;
+
+	error_code ec;
+	for (filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (!isEntry(*it)) continue;
+		error_code entryError;
+		Entry entry{ it->path(), (uint64_t)it->file_size(entryError), it->last_write_time(entryError) };
+		if (entryError) continue;
+		entries.push_back(entry);
+		total += entry.size;
+	}
+	if (total <= capacity) return 0;
+
+	// oldest use first, an entry that can't be removed (mapped on windows) is skipped
+	sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+	uint64_t removed = 0;
+	for (const Entry& entry : entries)
+	{
+		if (total - removed <= capacity) break;
+		if (filesystem::remove(entry.path, ec)) removed += entry.size;
+	}
+	return removed;
+}
+
+void DecodedTextureCache::clear()
+{
+	lock_guard<mutex> lock(evictMutex);
+
+	error_code ec;
+	vector<filesystem::path> entries;
+	for (filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+	{
+		if (isEntry(*it)) entries.push_back(it->path());
+	}
+	for (const filesystem::path& entry : entries) filesystem::remove(entry, ec);
+}
+
+uint64_t DecodedTextureCache::size() const
+{
+	uint64_t total = 0;
+	error_code ec;
+	for (filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+	{
+		error_code entryError;
+		if (isEntry(*it)) total += (uint64_t)it->file_size(entryError);
+	}
+	return total;
+}
+
+uint64_t DecodedTextureCache::getCapacity() const
+{
+	return capacity;
+}
+
+const string& DecodedTextureCache::getDirectory() const
+{
+	return directory;
+}
+
+string DecodedTextureCache::entryPath(const char* imageFilename) const
+{
+	string path = normalizedPath(imageFilename);
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hashBytes(path.data(), path.size()));
+	return directory + "/" + name + ENTRY_EXTENSION;
+}
+
+
+// ================= gl ====================
+
+void uploadDecodedLevels(GLenum target, const DecodedTexture& texture, const unsigned char* levelData)
+{
+	GLenum internalFormat = texture.nrComponents == 1 ? GL_R8 : GL_RGBA8;
+	GLenum format = texture.nrComponents == 1 ? GL_RED : GL_RGBA;
+
+	// R8 rows aren't 4 byte aligned
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (size_t i = 0; i < texture.levels.size(); i++)
+	{
+		const DecodedLevel& level = texture.levels[i];
+		const void* pixels = (const void*)((uintptr_t)levelData + level.offset);
+		glTexImage2D(target, (GLint)i, internalFormat, level.width, level.height, 0, format, GL_UNSIGNED_BYTE, pixels);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	if (target == GL_TEXTURE_2D)
+	{
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)texture.levels.size() - 1);
+	}
+}
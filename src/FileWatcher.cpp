@@ -0,0 +1,146 @@
+#include "FileWatcher.h"
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const int SETTLE_MS = 100;			// quiet time before a change is reported
+static const int POLL_INTERVAL_MS = 250;	// stat interval without inotify
+
+// one key per file however it was spelled ("./a/../b.png" and "b.png")
+static string normalizePath(const filesystem::path& path)
+{
+	string normalized = path.lexically_normal().generic_string();
+	return normalized.empty() ? string(".") : normalized;
+}
+
+FileWatcher::FileWatcher()
+{
+#ifdef __linux__
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC); // polling if it fails
+#endif
+}
+
+FileWatcher::~FileWatcher()
+{
+#ifdef __linux__
+	if (inotifyFd >= 0) ::close(inotifyFd);
+#endif
+}
+
+void FileWatcher::watch(const string& path)
+{
+	string key = normalizePath(path);
+
+	lock_guard<mutex> lock(filesMutex);
+	auto found = files.find(key);
+	if (found != files.end())
+	{
+		vector<string>& paths = found->second.paths;
+		if (find(paths.begin(), paths.end(), path) == paths.end()) paths.push_back(path);
+		return;
+	}
+
+	WatchedFile file;
+	file.paths.push_back(path);
+	error_code error;
+	file.mtime = filesystem::last_write_time(key, error);
+	file.size = filesystem::file_size(key, error);
+	files.emplace(key, file);
+
+#ifdef __linux__
+	// the directory is watched, saving through a temporary file and a rename replaces the file's inode
+	string directory = normalizePath(filesystem::path(key).parent_path());
+	if (inotifyFd >= 0 && find_if(directories.begin(), directories.end(), [&](const auto& entry) { return entry.second == directory; }) == directories.end())
+	{
+		int descriptor = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_MOVED_TO);
+		if (descriptor >= 0) directories[descriptor] = directory;
+	}
+#endif
+}
+
+vector<string> FileWatcher::waitForChanges(int timeoutMs)
+{
+	Clock::time_point deadline = Clock::now() + chrono::milliseconds(timeoutMs);
+	for (;;)
+	{
+		Clock::time_point now = Clock::now();
+		vector<string> settled;
+		bool pending;
+		{
+			lock_guard<mutex> lock(filesMutex);
+			for (auto it = changed.begin(); it != changed.end();)
+			{
+				if (now - it->second >= chrono::milliseconds(SETTLE_MS))
+				{
+					const vector<string>& paths = files[it->first].paths;
+					settled.insert(settled.end(), paths.begin(), paths.end());
+					it = changed.erase(it);
+				}
+				else it++;
+			}
+			pending = !changed.empty();
+		}
+		if (!settled.empty() || now >= deadline) return settled;
+
+		int waitMs = (int)chrono::duration_cast<chrono::milliseconds>(deadline - now).count();
+		if (pending) waitMs = min(waitMs, SETTLE_MS);
+		waitForEvents(max(waitMs, 1));
+	}
+}
+
+void FileWatcher::waitForEvents(int waitMs)
+{
+#ifdef __linux__
+	if (inotifyFd >= 0)
+	{
+		pollfd descriptor{ inotifyFd, POLLIN, 0 };
+		if (poll(&descriptor, 1, waitMs) <= 0) return;
+
+		alignas(inotify_event) char buffer[4096];
+		ssize_t length;
+		while ((length = read(inotifyFd, buffer, sizeof(buffer))) > 0)
+		{
+			Clock::time_point now = Clock::now();
+			lock_guard<mutex> lock(filesMutex);
+			for (char* cur = buffer; cur < buffer + length;)
+			{
+				const inotify_event* event = (const inotify_event*)cur;
+				cur += sizeof(inotify_event) + event->len;
+
+				auto directory = directories.find(event->wd);
+				if (event->len == 0 || directory == directories.end()) continue;
+				string key = normalizePath(filesystem::path(directory->second) / event->name);
+				if (files.count(key)) changed[key] = now;
+			}
+		}
+		return;
+	}
+#endif
+
+	this_thread::sleep_for(chrono::milliseconds(min(waitMs, POLL_INTERVAL_MS)));
+
+	Clock::time_point now = Clock::now();
+	lock_guard<mutex> lock(filesMutex);
+	for (auto& entry : files)
+	{
+		error_code error;
+		filesystem::file_time_type mtime = filesystem::last_write_time(entry.first, error);
+		if (error) continue; // being replaced, seen on the next poll
+		uintmax_t size = filesystem::file_size(entry.first, error);
+		if (error) continue;
+
+		if (mtime != entry.second.mtime || size != entry.second.size)
+		{
+			entry.second.mtime = mtime;
+			entry.second.size = size;
+			changed[entry.first] = now;
+		}
+	}
+}
@@ -0,0 +1,633 @@
+
+#include "GlbReader.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+static const uint32_t GLB_MAGIC = 0x46546C67;		// "glTF"
+static const uint32_t GLB_VERSION = 2;
+static const uint32_t GLB_CHUNK_JSON = 0x4E4F534A;	// "JSON"
+static const uint32_t GLB_CHUNK_BIN = 0x004E4942;	// "BIN\0"
+
+static const int GLTF_MODE_TRIANGLES = 4;
+static const int MAX_NODE_DEPTH = 256;
+static const size_t MAX_NODE_VISITS = 1 << 16;	// nodes shared by several parents are visited once per parent
+
+// ================= json ====================
+
+// just enough json for the gltf chunk, objects keep their member order
+struct JsonValue
+{
+	enum Type { NUL, BOOLEAN, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+	bool boolean = false;
+	double number = 0.0;
+	string str;
+	vector<JsonValue> items;
+	vector<pair<string, JsonValue>> members;
+
+	const JsonValue* find(const char* key) const
+	{
+		if (type != OBJECT) return nullptr;
+		for (const auto& member : members)
+		{
+			if (member.first == key) return &member.second;
+		}
+		return nullptr;
+	}
+};
+
+class JsonParser
+{
+public:
+	JsonParser(const char* begin, const char* end) : cur(begin), end(end) {}
+
+	JsonValue parseDocument()
+	{
+		JsonValue value = parseValue(0);
+		skipSpace();
+		if (cur != end) fail();
+		return value;
+	}
+
+private:
+	static const int MAX_DEPTH = 64;
+
+	const char* cur;
+	const char* end;
+
+	[[noreturn]] void fail()
+	{
+		throw invalid_argument("GlbFileReader::invalid json chunk");
+	}
+
+	void skipSpace()
+	{
+		while (cur < end && (*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r')) cur++;
+	}
+
+	bool consume(char c)
+	{
+		skipSpace();
+		if (cur < end && *cur == c)
+		{
+			cur++;
+			return true;
+		}
+		return false;
+	}
+
+	void expect(char c)
+	{
+		if (!consume(c)) fail();
+	}
+
+	void literal(const char* word)
+	{
+		size_t length = strlen(word);
+		if ((size_t)(end - cur) < length || memcmp(cur, word, length) != 0) fail();
+		cur += length;
+	}
+
+	JsonValue parseValue(int depth)
+	{
+		if (depth > MAX_DEPTH) fail();
+		skipSpace();
+		if (cur == end) fail();
+
+		JsonValue value;
+		switch (*cur)
+		{
+		case '{':
+			cur++;
+			value.type = JsonValue::OBJECT;
+			if (consume('}')) return value;
+			do
+			{
+				skipSpace();
+				string key = parseString();
+				expect(':');
+				value.members.emplace_back(move(key), parseValue(depth + 1));
+			} while (consume(','));
+			expect('}');
+			return value;
+		case '[':
+			cur++;
+			value.type = JsonValue::ARRAY;
+			if (consume(']')) return value;
+			do
+			{
+				value.items.push_back(parseValue(depth + 1));
+			} while (consume(','));
+			expect(']');
+			return value;
+		case '"':
+			value.type = JsonValue::STRING;
+			value.str = parseString();
+			return value;
+		case 't':
+			literal("true");
+			value.type = JsonValue::BOOLEAN;
+			value.boolean = true;
+			return value;
+		case 'f':
+			literal("false");
+			value.type = JsonValue::BOOLEAN;
+			return value;
+		case 'n':
+			literal("null");
+			return value;
+		default:
+		{
+			from_chars_result res = from_chars(cur, end, value.number);
+			if (res.ec != errc()) fail();
+			cur = res.ptr;
+			value.type = JsonValue::NUMBER;
+			return value;
+		}
+		}
+	}
+
+	unsigned int parseHex4()
+	{
+		if (end - cur < 4) fail();
+		unsigned int code = 0;
+		from_chars_result res = from_chars(cur, cur + 4, code, 16);
+		if (res.ec != errc() || res.ptr != cur + 4) fail();
+		cur += 4;
+		return code;
+	}
+
+	string parseString()
+	{
+		if (cur == end || *cur != '"') fail();
+		cur++;
+
+		string out;
+		while (cur < end && *cur != '"')
+		{
+			if (*cur != '\\')
+			{
+				out += *cur++;
+				continue;
+			}
+
+			cur++;
+			if (cur == end) fail();
+			char escape = *cur++;
+			switch (escape)
+			{
+			case '"': case '\\': case '/': out += escape; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				unsigned int code = parseHex4();
+				if (code >= 0xD800 && code < 0xDC00 && end - cur >= 6 && cur[0] == '\\' && cur[1] == 'u')
+				{
+					cur += 2;
+					unsigned int low = parseHex4();
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				// utf-8
+				if (code < 0x80) out += (char)code;
+				else if (code < 0x800)
+				{
+					out += (char)(0xC0 | (code >> 6));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				else if (code < 0x10000)
+				{
+					out += (char)(0xE0 | (code >> 12));
+					out += (char)(0x80 | ((code >> 6) & 0x3F));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				else
+				{
+					out += (char)(0xF0 | (code >> 18));
+					out += (char)(0x80 | ((code >> 12) & 0x3F));
+					out += (char)(0x80 | ((code >> 6) & 0x3F));
+					out += (char)(0x80 | (code & 0x3F));
+				}
+				break;
+			}
+			default: fail();
+			}
+		}
+		if (cur == end) fail();
+		cur++;
+		return out;
+	}
+};
+
+
+// ================= helpers ====================
+
+static const vector<JsonValue>& arrayMember(const JsonValue& object, const char* key)
+{
+	static const vector<JsonValue> empty;
+	const JsonValue* value = object.find(key);
+	if (!value) return empty;
+	if (value->type != JsonValue::ARRAY) throw invalid_argument(string("GlbFileReader::") + key + " is not an array");
+	return value->items;
+}
+
+static double numberMember(const JsonValue& object, const char* key, double fallback)
+{
+	const JsonValue* value = object.find(key);
+	if (!value) return fallback;
+	if (value->type != JsonValue::NUMBER) throw invalid_argument(string("GlbFileReader::") + key + " is not a number");
+	return value->number;
+}
+
+// non negative integer member, fallback when missing
+static size_t sizeMember(const JsonValue& object, const char* key, size_t fallback)
+{
+	double value = numberMember(object, key, (double)fallback);
+	if (value < 0.0 || value != floor(value) || value > 9007199254740992.0) throw invalid_argument(string("GlbFileReader::") + key + " is not a valid size");
+	return (size_t)value;
+}
+
+// required index into an array of count elements
+static size_t indexMember(const JsonValue& object, const char* key, size_t count)
+{
+	if (!object.find(key)) throw invalid_argument(string("GlbFileReader::missing ") + key);
+	size_t index = sizeMember(object, key, 0);
+	if (index >= count) throw invalid_argument(string("GlbFileReader::") + key + " out of range");
+	return index;
+}
+
+static string stringMember(const JsonValue& object, const char* key)
+{
+	const JsonValue* value = object.find(key);
+	if (!value) return string();
+	if (value->type != JsonValue::STRING) throw invalid_argument(string("GlbFileReader::") + key + " is not a string");
+	return value->str;
+}
+
+static int componentSize(GLenum componentType)
+{
+	switch (componentType)
+	{
+	case GL_BYTE: case GL_UNSIGNED_BYTE: return 1;
+	case GL_SHORT: case GL_UNSIGNED_SHORT: return 2;
+	case GL_UNSIGNED_INT: case GL_FLOAT: return 4;
+	}
+	throw invalid_argument("GlbFileReader::invalid accessor component type");
+}
+
+static int componentCount(const string& type)
+{
+	if (type == "SCALAR") return 1;
+	if (type == "VEC2") return 2;
+	if (type == "VEC3") return 3;
+	if (type == "VEC4") return 4;
+	throw invalid_argument("GlbFileReader::unsupported accessor type " + type);
+}
+
+// validated byte range of an accessor inside the binary chunk
+struct GlbAccessor
+{
+	GLenum componentType;
+	int components;
+	bool normalized;
+	size_t count;
+	size_t byteOffset;
+	int byteStride;		// as given by the buffer view, 0 when tightly packed
+};
+
+static GlbAccessor resolveAccessor(const JsonValue& root, size_t accessorIdx, size_t binarySize)
+{
+	const JsonValue& accessor = arrayMember(root, "accessors")[accessorIdx];
+	if (accessor.find("sparse")) throw invalid_argument("GlbFileReader::sparse accessors are not supported");
+
+	GlbAccessor out;
+	out.componentType = (GLenum)sizeMember(accessor, "componentType", 0);
+	out.components = componentCount(stringMember(accessor, "type"));
+	const JsonValue* normalized = accessor.find("normalized");
+	out.normalized = normalized && normalized->type == JsonValue::BOOLEAN && normalized->boolean;
+	out.count = sizeMember(accessor, "count", 0);
+	if (out.count == 0) throw invalid_argument("GlbFileReader::empty accessor");
+
+	const vector<JsonValue>& bufferViews = arrayMember(root, "bufferViews");
+	const JsonValue& view = bufferViews[indexMember(accessor, "bufferView", bufferViews.size())];
+	if (indexMember(view, "buffer", arrayMember(root, "buffers").size()) != 0)
+		throw invalid_argument("GlbFileReader::only the binary chunk buffer is supported");
+
+	size_t viewOffset = sizeMember(view, "byteOffset", 0);
+	size_t viewLength = sizeMember(view, "byteLength", 0);
+	out.byteStride = (int)sizeMember(view, "byteStride", 0);
+	if (viewOffset > binarySize || viewLength > binarySize - viewOffset) throw invalid_argument("GlbFileReader::buffer view out of range");
+
+	int size = componentSize(out.componentType);
+	size_t elementSize = (size_t)size * out.components;
+	size_t stride = out.byteStride ? out.byteStride : elementSize;
+	size_t accessorOffset = sizeMember(accessor, "byteOffset", 0);
+	out.byteOffset = viewOffset + accessorOffset;
+
+	if (out.byteOffset % size != 0 || stride % size != 0) throw invalid_argument("GlbFileReader::misaligned accessor");
+	if (stride < elementSize || stride > 252) throw invalid_argument("GlbFileReader::invalid buffer view stride");
+	if (accessorOffset > viewLength || out.count - 1 > viewLength / stride ||
+		stride * (out.count - 1) + elementSize > viewLength - accessorOffset)
+	{
+		throw invalid_argument("GlbFileReader::accessor out of range");
+	}
+	return out;
+}
+
+static GlbAttribute vertexAttribute(const GlbAccessor& accessor, size_t vertexCount)
+{
+	if (vertexCount && accessor.count != vertexCount) throw invalid_argument("GlbFileReader::attribute counts differ");
+
+	GlbAttribute attribute;
+	attribute.format = VertexAttrib{ accessor.components, accessor.componentType, accessor.normalized };
+	attribute.byteOffset = accessor.byteOffset;
+	attribute.byteStride = accessor.byteStride;
+	attribute.count = accessor.count;
+	return attribute;
+}
+
+static glm::mat4 nodeTransform(const JsonValue& node)
+{
+	const vector<JsonValue>& matrix = arrayMember(node, "matrix");
+	if (matrix.size() == 16)
+	{
+		float values[16];
+		for (int i = 0; i < 16; i++) values[i] = (float)matrix[i].number;
+		return glm::make_mat4(values); // column major like gltf
+	}
+
+	const vector<JsonValue>& t = arrayMember(node, "translation");
+	const vector<JsonValue>& r = arrayMember(node, "rotation");
+	const vector<JsonValue>& s = arrayMember(node, "scale");
+	glm::mat4 transform(1.f);
+	if (t.size() == 3) transform = glm::translate(transform, glm::vec3(t[0].number, t[1].number, t[2].number));
+	if (r.size() == 4) transform *= glm::mat4_cast(glm::quat((float)r[3].number, (float)r[0].number, (float)r[1].number, (float)r[2].number));
+	if (s.size() == 3) transform = glm::scale(transform, glm::vec3(s[0].number, s[1].number, s[2].number));
+	return transform;
+}
+
+// largest index of a tightly packed index accessor, one pass over the binary chunk
+template <typename T>
+static size_t maxIndex(const unsigned char* bytes, size_t count)
+{
+	const T* indices = (const T*)bytes;
+	T largest = 0;
+	for (size_t i = 0; i < count; i++) largest = max(largest, indices[i]);
+	return largest;
+}
+
+// bounds of a float vec3 attribute, the optional accessor min/max isn't trusted either
+static void positionBounds(const unsigned char* binary, const GlbAttribute& position, glm::vec3& minPosition, glm::vec3& maxPosition)
+{
+	size_t stride = position.byteStride ? position.byteStride : sizeof(glm::vec3);
+	for (size_t i = 0; i < position.count; i++)
+	{
+		glm::vec3 vertex;
+		memcpy(&vertex, binary + position.byteOffset + i * stride, sizeof(vertex));
+		minPosition = i == 0 ? vertex : glm::min(minPosition, vertex);
+		maxPosition = i == 0 ? vertex : glm::max(maxPosition, vertex);
+	}
+}
+
+// visits counts every node visited so far, a node graph that shares children expands exponentially
+static void collectInstances(const JsonValue& root, size_t nodeIdx, const glm::mat4& parent, int depth, size_t& visits, GlbFileData& data)
+{
+	const vector<JsonValue>& nodes = arrayMember(root, "nodes");
+	if (depth > MAX_NODE_DEPTH) throw invalid_argument("GlbFileReader::node hierarchy too deep");
+	if (++visits > MAX_NODE_VISITS) throw invalid_argument("GlbFileReader::too many node instances");
+
+	const JsonValue& node = nodes[nodeIdx];
+	glm::mat4 transform = parent * nodeTransform(node);
+	if (node.find("mesh")) data.instances.push_back(GlbInstance{ (int)indexMember(node, "mesh", data.meshes.size()), transform });
+
+	for (const JsonValue& child : arrayMember(node, "children"))
+	{
+		if (child.type != JsonValue::NUMBER || child.number < 0 || child.number >= nodes.size()) throw invalid_argument("GlbFileReader::child out of range");
+		collectInstances(root, (size_t)child.number, transform, depth + 1, visits, data);
+	}
+}
+
+
+// ================= reader ====================
+
+GlbFileData GlbFileReader::read(const char* filename)
+{
+	GlbFileData data;
+	data.filename = filename;
+	if (!data.file.open(filename)) throw invalid_argument("GlbFileReader::file doesn't exist");
+
+	// header and chunks
+	const unsigned char* bytes = (const unsigned char*)data.file.begin();
+	size_t size = data.file.size();
+	uint32_t header[3];
+	if (size < sizeof(header)) throw invalid_argument("GlbFileReader::not a glb file");
+	memcpy(header, bytes, sizeof(header));
+	if (header[0] != GLB_MAGIC) throw invalid_argument("GlbFileReader::not a glb file");
+	if (header[1] != GLB_VERSION) throw invalid_argument("GlbFileReader::only gltf 2.0 is supported");
+	if (header[2] > size) throw invalid_argument("GlbFileReader::truncated file");
+
+	const char* json = nullptr;
+	size_t jsonSize = 0;
+	size_t offset = sizeof(header);
+	while (offset + 8 <= header[2])
+	{
+		uint32_t chunk[2];
+		memcpy(chunk, bytes + offset, sizeof(chunk));
+		offset += sizeof(chunk);
+		if (chunk[0] > header[2] - offset) throw invalid_argument("GlbFileReader::truncated chunk");
+
+		if (chunk[1] == GLB_CHUNK_JSON && !json)
+		{
+			json = (const char*)bytes + offset;
+			jsonSize = chunk[0];
+		}
+		else if (chunk[1] == GLB_CHUNK_BIN && !data.binary)
+		{
+			data.binary = bytes + offset;
+			data.binarySize = chunk[0];
+		}
+		offset += (chunk[0] + 3) & ~3u;
+	}
+	if (!json) throw invalid_argument("GlbFileReader::missing json chunk");
+
+	JsonValue root = JsonParser(json, json + jsonSize).parseDocument();
+	const vector<JsonValue>& buffers = arrayMember(root, "buffers");
+	if (!buffers.empty() && buffers[0].find("uri")) throw invalid_argument("GlbFileReader::external buffers are not supported");
+
+	// meshes
+	const vector<JsonValue>& materials = arrayMember(root, "materials");
+	for (const JsonValue& meshJson : arrayMember(root, "meshes"))
+	{
+		GlbMesh mesh;
+		mesh.name = stringMember(meshJson, "name");
+		for (const JsonValue& primitiveJson : arrayMember(meshJson, "primitives"))
+		{
+			if (numberMember(primitiveJson, "mode", GLTF_MODE_TRIANGLES) != GLTF_MODE_TRIANGLES)
+			{
+				cout << "GlbFileReader::Warning non triangle primitive in " << filename << ", ignored" << endl;
+				continue;
+			}
+
+			const JsonValue* attributes = primitiveJson.find("attributes");
+			if (!attributes) throw invalid_argument("GlbFileReader::primitive without attributes");
+			size_t accessorCount = arrayMember(root, "accessors").size();
+
+			GlbPrimitive primitive;
+			GlbAccessor position = resolveAccessor(root, indexMember(*attributes, "POSITION", accessorCount), data.binarySize);
+			if (position.componentType != GL_FLOAT || position.components != 3) throw invalid_argument("GlbFileReader::POSITION must be float vec3");
+			primitive.position = vertexAttribute(position, 0);
+			positionBounds(data.binary, primitive.position, primitive.minPosition, primitive.maxPosition);
+
+			if (attributes->find("NORMAL"))
+			{
+				GlbAccessor normal = resolveAccessor(root, indexMember(*attributes, "NORMAL", accessorCount), data.binarySize);
+				if (normal.componentType != GL_FLOAT || normal.components != 3) throw invalid_argument("GlbFileReader::NORMAL must be float vec3");
+				primitive.normal = vertexAttribute(normal, position.count);
+			}
+			if (attributes->find("TEXCOORD_0"))
+			{
+				GlbAccessor texCoord = resolveAccessor(root, indexMember(*attributes, "TEXCOORD_0", accessorCount), data.binarySize);
+				bool validType = texCoord.componentType == GL_FLOAT ||
+					((texCoord.componentType == GL_UNSIGNED_BYTE || texCoord.componentType == GL_UNSIGNED_SHORT) && texCoord.normalized);
+				if (!validType || texCoord.components != 2) throw invalid_argument("GlbFileReader::invalid TEXCOORD_0 format");
+				primitive.texCoord = vertexAttribute(texCoord, position.count);
+			}
+
+			if (primitiveJson.find("indices"))
+			{
+				GlbAccessor indices = resolveAccessor(root, indexMember(primitiveJson, "indices", accessorCount), data.binarySize);
+				bool validType = indices.componentType == GL_UNSIGNED_BYTE || indices.componentType == GL_UNSIGNED_SHORT || indices.componentType == GL_UNSIGNED_INT;
+				if (!validType || indices.components != 1) throw invalid_argument("GlbFileReader::invalid index format");
+				if (indices.byteStride && indices.byteStride != componentSize(indices.componentType)) throw invalid_argument("GlbFileReader::strided indices");
+
+				// the optional max bound isn't trusted, the gpu would read past the vertices
+				const unsigned char* indexBytes = data.binary + indices.byteOffset;
+				size_t largest = indices.componentType == GL_UNSIGNED_BYTE ? maxIndex<uint8_t>(indexBytes, indices.count) :
+					indices.componentType == GL_UNSIGNED_SHORT ? maxIndex<uint16_t>(indexBytes, indices.count) :
+					maxIndex<uint32_t>(indexBytes, indices.count);
+				if (largest >= position.count) throw invalid_argument("GlbFileReader::index out of range");
+
+				primitive.indexType = indices.componentType;
+				primitive.indexOffset = indices.byteOffset;
+				primitive.indexCount = indices.count;
+			}
+
+			if (primitiveJson.find("material")) primitive.material = (int)indexMember(primitiveJson, "material", materials.size());
+			mesh.primitives.push_back(primitive);
+		}
+		data.meshes.push_back(move(mesh));
+	}
+
+	// default scene, every mesh at the origin when there's no scene
+	const vector<JsonValue>& scenes = arrayMember(root, "scenes");
+	if (!scenes.empty())
+	{
+		const JsonValue& scene = scenes[root.find("scene") ? indexMember(root, "scene", scenes.size()) : 0];
+		size_t nodeCount = arrayMember(root, "nodes").size();
+		size_t visits = 0;
+		for (const JsonValue& node : arrayMember(scene, "nodes"))
+		{
+			if (node.type != JsonValue::NUMBER || node.number < 0 || node.number >= nodeCount) throw invalid_argument("GlbFileReader::scene node out of range");
+			collectInstances(root, (size_t)node.number, glm::mat4(1.f), 0, visits, data);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < data.meshes.size(); i++) data.instances.push_back(GlbInstance{ (int)i, glm::mat4(1.f) });
+	}
+
+	// materials, pbr approximated with phong terms
+	const vector<JsonValue>& textures = arrayMember(root, "textures");
+	const vector<JsonValue>& images = arrayMember(root, "images");
+	map<size_t, int> imageTextures;
+	for (size_t i = 0; i < materials.size(); i++)
+	{
+		const JsonValue& material = materials[i];
+		SubMtl subMtl;
+
+		glm::vec4 baseColor(1.f);
+		float metallic = 1.f, roughness = 1.f;
+		const JsonValue* pbr = material.find("pbrMetallicRoughness");
+		if (pbr)
+		{
+			const vector<JsonValue>& factor = arrayMember(*pbr, "baseColorFactor");
+			if (factor.size() == 4) baseColor = glm::vec4(factor[0].number, factor[1].number, factor[2].number, factor[3].number);
+			metallic = (float)numberMember(*pbr, "metallicFactor", 1.0);
+			roughness = (float)numberMember(*pbr, "roughnessFactor", 1.0);
+
+			const JsonValue* baseTexture = pbr->find("baseColorTexture");
+			if (baseTexture)
+			{
+				const JsonValue& texture = textures[indexMember(*baseTexture, "index", textures.size())];
+				size_t imageIdx = indexMember(texture, "source", images.size());
+				auto found = imageTextures.find(imageIdx);
+				if (found != imageTextures.end())
+				{
+					subMtl.diffuseColorTextureIdx = found->second;
+				}
+				else
+				{
+					const JsonValue& image = images[imageIdx];
+					string uri = stringMember(image, "uri");
+					EmbeddedTexture embedded;
+					string textureFilename;
+					if (image.find("bufferView"))
+					{
+						const JsonValue& view = arrayMember(root, "bufferViews")[indexMember(image, "bufferView", arrayMember(root, "bufferViews").size())];
+						size_t viewOffset = sizeMember(view, "byteOffset", 0);
+						size_t viewLength = sizeMember(view, "byteLength", 0);
+						if (viewOffset > data.binarySize || viewLength > data.binarySize - viewOffset) throw invalid_argument("GlbFileReader::image out of range");
+						embedded = EmbeddedTexture{ data.binary + viewOffset, viewLength };
+						textureFilename = data.filename + "#image" + to_string(imageIdx); // registry key
+					}
+					else if (!uri.empty() && uri.compare(0, 5, "data:") != 0)
+					{
+						textureFilename = (filesystem::path(filename).parent_path() / uri).generic_string();
+					}
+
+					if (!textureFilename.empty())
+					{
+						subMtl.diffuseColorTextureIdx = (int)data.materials.textureFilenames.size();
+						data.materials.textureFilenames.push_back(textureFilename);
+						data.materials.embeddedTextures.push_back(embedded);
+					}
+					else
+					{
+						cout << "GlbFileReader::Warning data uri image in " << filename << ", ignored" << endl;
+					}
+					imageTextures[imageIdx] = subMtl.diffuseColorTextureIdx;
+				}
+			}
+		}
+
+		subMtl.diffuseColor = Vector3{ baseColor.r, baseColor.g, baseColor.b };
+		subMtl.opacity = stringMember(material, "alphaMode") == "BLEND" ? baseColor.a : 1.f;
+		glm::vec3 specular = glm::mix(glm::vec3(0.04f), glm::vec3(baseColor), metallic);
+		subMtl.specularColor = Vector3{ specular.r, specular.g, specular.b };
+		float alpha = max(roughness * roughness, 0.01f);
+		subMtl.shininess = min(2.f / (alpha * alpha) - 2.f, 1024.f);
+		if (subMtl.shininess < 1.f) subMtl.shininess = 1.f;
+
+		string name = stringMember(material, "name");
+		if (name.empty()) name = "material" + to_string(i);
+		else if (data.materials.materialNames.count(name)) name += "#" + to_string(i); // names must be unique
+		data.materials.materialNames[name] = (int)data.materials.materials.size();
+		data.materials.materials.push_back(subMtl);
+	}
+
+	return data;
+}
@@ -0,0 +1,78 @@
+#include "HotReloader.h"
+#include <algorithm>
+#include <iostream>
+
+using namespace std;
+
+static const int WATCH_TIMEOUT_MS = 200;	// how long stopping the reloader may take
+
+HotReloader::HotReloader()
+{
+	thread = std::thread(&HotReloader::run, this);
+}
+
+HotReloader::~HotReloader()
+{
+	running = false;
+	thread.join();
+}
+
+void HotReloader::watch(const vector<string>& paths, Load load)
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		assets.push_back(Asset{ paths, load });
+	}
+	for (const string& path : paths) watcher.watch(path);
+}
+
+int HotReloader::applyPending()
+{
+	vector<function<void()>> swaps;
+	{
+		lock_guard<std::mutex> lock(mutex);
+		swaps.swap(pending);
+	}
+	for (const function<void()>& swap : swaps) swap();
+	return (int)swaps.size();
+}
+
+void HotReloader::run()
+{
+	while (running)
+	{
+		vector<string> changed = watcher.waitForChanges(WATCH_TIMEOUT_MS);
+		if (changed.empty()) continue;
+
+		// assets touched by the change, once even if several of their files changed
+		vector<Load> loads;
+		{
+			lock_guard<std::mutex> lock(mutex);
+			for (const Asset& asset : assets)
+			{
+				bool touched = any_of(asset.paths.begin(), asset.paths.end(), [&](const string& path) {
+					return find(changed.begin(), changed.end(), path) != changed.end();
+				});
+				if (touched) loads.push_back(asset.load);
+			}
+		}
+
+		for (const string& path : changed) cout << "Reloading " << path << endl;
+		for (const Load& load : loads)
+		{
+			function<void()> swap;
+			try
+			{
+				swap = load();
+			}
+			catch (const exception& e)
+			{
+				cout << "HotReloader::Reload failed, asset kept: " << e.what() << endl;
+			}
+			if (!swap) continue;
+
+			lock_guard<std::mutex> lock(mutex);
+			pending.push_back(swap);
+		}
+	}
+}
@@ -0,0 +1,179 @@
+#include "MappedFile.h"
+#include <stdint.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const char* filename)
+{
+	open(filename);
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	moveFrom(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		moveFrom(other);
+	}
+	return *this;
+}
+
+bool MappedFile::open(const char* filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	length = (size_t)fileSize.QuadPart;
+
+	// empty files can't be mapped, they are still valid (empty) views
+	if (length > 0)
+	{
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			close();
+			return false;
+		}
+		mappingHandle = mapping;
+
+		bytes = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (bytes == NULL)
+		{
+			close();
+			return false;
+		}
+	}
+#else
+	int fd = ::open(filename, O_RDONLY);
+	if (fd < 0) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0)
+	{
+		::close(fd);
+		return false;
+	}
+	fileDescriptor = fd;
+	length = (size_t)st.st_size;
+
+	if (length > 0)
+	{
+		void* view = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (view == MAP_FAILED)
+		{
+			close();
+			return false;
+		}
+		madvise(view, length, MADV_SEQUENTIAL);
+		bytes = (const char*)view;
+	}
+#endif
+
+	opened = true;
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if (bytes) UnmapViewOfFile(bytes);
+	if (mappingHandle) CloseHandle((HANDLE)mappingHandle);
+	if (fileHandle) CloseHandle((HANDLE)fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (bytes) munmap((void*)bytes, length);
+	if (fileDescriptor >= 0) ::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	bytes = nullptr;
+	length = 0;
+	opened = false;
+}
+
+bool MappedFile::isOpen() const
+{
+	return opened;
+}
+
+size_t MappedFile::size() const
+{
+	return length;
+}
+
+const char* MappedFile::begin() const
+{
+	return bytes;
+}
+
+const char* MappedFile::end() const
+{
+	return bytes + length;
+}
+
+void MappedFile::release(const char* rangeBegin, const char* rangeEnd) const
+{
+	if (!bytes || rangeEnd <= rangeBegin) return;
+
+	// only whole pages inside the range
+	const size_t pageSize = 4096;
+	uintptr_t first = ((uintptr_t)rangeBegin + pageSize - 1) / pageSize * pageSize;
+	uintptr_t last = (uintptr_t)rangeEnd / pageSize * pageSize;
+	if (last <= first) return;
+
+#ifdef _WIN32
+	// unlocking pages that aren't locked removes them from the working set
+	VirtualUnlock((void*)first, last - first);
+#else
+	madvise((void*)first, last - first, MADV_DONTNEED);
+#endif
+}
+
+void MappedFile::moveFrom(MappedFile& other)
+{
+	bytes = other.bytes;
+	length = other.length;
+	opened = other.opened;
+#ifdef _WIN32
+	fileHandle = other.fileHandle;
+	mappingHandle = other.mappingHandle;
+	other.fileHandle = nullptr;
+	other.mappingHandle = nullptr;
+#else
+	fileDescriptor = other.fileDescriptor;
+	other.fileDescriptor = -1;
+#endif
+	other.bytes = nullptr;
+	other.length = 0;
+	other.opened = false;
+}
@@ -0,0 +1,130 @@
+
+#include "MaterialLibrary.h"
+#include <glm/gtc/type_ptr.hpp>
+#include <filesystem>
+#include <stdexcept>
+
+using namespace std;
+
+// same file, same key: "./a/../b.png" and "b.png" resolve to one entry
+static string normalizePath(const string& path)
+{
+	error_code error;
+	filesystem::path canonical = filesystem::weakly_canonical(filesystem::path(path), error);
+	if (error) canonical = filesystem::path(path).lexically_normal();
+	return canonical.generic_string();
+}
+
+MaterialLibrary::MaterialLibrary(function<GLuint(const char*)> load, function<GLuint(const unsigned char*, size_t)> loadFromMemory)
+	: load(load), loadFromMemory(loadFromMemory)
+{
+	materials.push_back(Material());
+}
+
+GLuint MaterialLibrary::acquireTexture(const string& path)
+{
+	string key = normalizePath(path);
+	auto found = textures.find(key);
+	if (found != textures.end()) return found->second;
+
+	GLuint texture = load(path.c_str());
+	textures.emplace(key, texture);
+	return texture;
+}
+
+GLuint MaterialLibrary::acquireTexture(const string& path, const EmbeddedTexture& embedded)
+{
+	if (!embedded.bytes) return acquireTexture(path);
+	if (!loadFromMemory) throw invalid_argument("MaterialLibrary::No loader for embedded textures");
+
+	string key = normalizePath(path);
+	auto found = textures.find(key);
+	if (found != textures.end()) return found->second;
+
+	GLuint texture = loadFromMemory(embedded.bytes, embedded.size);
+	textures.emplace(key, texture);
+	return texture;
+}
+
+vector<int> MaterialLibrary::addMaterials(const ObjectFileData& data, const vector<string>& materialNames)
+{
+	return addMaterials(data.mtlFileData, data.mtlFilename, materialNames);
+}
+
+vector<int> MaterialLibrary::addMaterials(const MaterialFileData& mtl, const string& sourceFilename, const vector<string>& materialNames)
+{
+	string mtlKey = sourceFilename.empty() ? string() : normalizePath(sourceFilename);
+
+	vector<int> ids(materialNames.size(), 0);
+	for (size_t i = 0; i < materialNames.size(); i++)
+	{
+		auto mtlFound = mtl.materialNames.find(materialNames[i]);
+		if (mtlFound == mtl.materialNames.end()) continue; // default material
+
+		string key = mtlKey + '\n' + materialNames[i];
+		auto found = materialIds.find(key);
+		if (found != materialIds.end())
+		{
+			ids[i] = found->second;
+			continue;
+		}
+
+		const SubMtl& subMtl = mtl.materials[mtlFound->second];
+		Material material;
+		material.ambientColor = glm::vec3(subMtl.ambientColor.x, subMtl.ambientColor.y, subMtl.ambientColor.z);
+		material.diffuseColor = glm::vec3(subMtl.diffuseColor.x, subMtl.diffuseColor.y, subMtl.diffuseColor.z);
+		material.specularColor = glm::vec3(subMtl.specularColor.x, subMtl.specularColor.y, subMtl.specularColor.z);
+		material.shininess = subMtl.shininess;
+		material.opacity = subMtl.opacity;
+		if (subMtl.diffuseColorTextureIdx >= 0)
+		{
+			int textureIdx = subMtl.diffuseColorTextureIdx;
+			EmbeddedTexture embedded = textureIdx < (int)mtl.embeddedTextures.size() ? mtl.embeddedTextures[textureIdx] : EmbeddedTexture();
+			material.diffuseTexture = acquireTexture(mtl.textureFilenames[textureIdx], embedded);
+		}
+
+		ids[i] = (int)materials.size();
+		materialIds.emplace(key, ids[i]);
+		materials.push_back(material);
+	}
+	return ids;
+}
+
+const Material& MaterialLibrary::getMaterial(int materialId) const
+{
+	if (materialId < 0 || materialId >= (int)materials.size()) throw invalid_argument("MaterialLibrary::Invalid material id");
+	return materials[materialId];
+}
+
+size_t MaterialLibrary::getMaterialCount() const
+{
+	return materials.size();
+}
+
+size_t MaterialLibrary::getTextureCount() const
+{
+	return textures.size();
+}
+
+void MaterialLibrary::bind(int materialId, unsigned int shaderProgram) const
+{
+	const Material& material = getMaterial(materialId);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, material.diffuseTexture);
+	setUniforms(material, material.diffuseTexture != 0, shaderProgram);
+}
+
+void MaterialLibrary::bindNeutral(unsigned int shaderProgram) const
+{
+	setUniforms(Material(), true, shaderProgram);
+}
+
+void MaterialLibrary::setUniforms(const Material& material, bool textured, unsigned int shaderProgram) const
+{
+	glUniform3fv(glGetUniformLocation(shaderProgram, "materialAmbient"), 1, glm::value_ptr(material.ambientColor));
+	glUniform3fv(glGetUniformLocation(shaderProgram, "materialDiffuse"), 1, glm::value_ptr(material.diffuseColor));
+	glUniform3fv(glGetUniformLocation(shaderProgram, "materialSpecular"), 1, glm::value_ptr(material.specularColor));
+	glUniform1f(glGetUniformLocation(shaderProgram, "materialShininess"), material.shininess);
+	glUniform1f(glGetUniformLocation(shaderProgram, "materialOpacity"), material.opacity);
+	glUniform1i(glGetUniformLocation(shaderProgram, "materialTextured"), textured);
+}
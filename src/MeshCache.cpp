@@ -0,0 +1,313 @@
+#include "MeshCache.h"
+#include "MappedFile.h"
+#include "SourceIdentity.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+
+using namespace std;
+
+static const char MESH_CACHE_MAGIC[8] = { 'S', 'S', 'M', 'E', 'S', 'H', 0, 0 };
+static const int MESH_CACHE_LAYOUT[3] = { 3, 2, 3 }; // position, texture coordinate, normal
+
+struct MeshCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t subObjectCount;
+
+	// source identity
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+
+	// vertex attribute layout, float count per attribute (as passed to glSetupVertexObject)
+	uint32_t attribCount;
+	int32_t attribLayout[4];
+
+	// MESH_CACHE_*_OPTIMIZED passes applied to the buffers
+	uint32_t optimizeFlags;
+	uint32_t padding;
+
+	// blob offsets from the start of the file, in bytes
+	uint64_t stringOffset;
+	uint64_t stringSize;
+	uint64_t vertexOffset;
+	uint64_t vertexCount;	// floats
+	uint64_t indexOffset;
+	uint64_t indexCount;
+	uint64_t lodOffset;
+	uint64_t lodCount;
+
+	// string blob ranges of the mtl filename
+	uint32_t mtlFilenameOffset;
+	uint32_t mtlFilenameLength;
+};
+
+struct MeshCacheSubObj
+{
+	uint32_t nameOffset, nameLength;
+	uint32_t groupOffset, groupLength;
+	uint32_t materialOffset, materialLength;
+	uint32_t smoothOffset, smoothLength;
+	uint32_t faceType;
+	uint32_t padding;
+
+	uint64_t firstVertex;	// first float of the sub object in the vertex blob
+	uint64_t vertexCount;	// floats
+	uint64_t firstIndex;
+	uint64_t indexCount;
+
+	// vertex cache stats before/after optimization (acmr, atvr)
+	float cacheStatsBefore[2];
+	float cacheStatsAfter[2];
+
+	uint32_t firstLod;
+	uint32_t lodCount;
+};
+
+struct MeshCacheLod
+{
+	uint64_t firstIndex;
+	uint64_t indexCount;
+	float error;
+	uint32_t padding;
+};
+
+
+// ================= helpers ====================
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t appendString(string& blob, const string& str)
+{
+	uint32_t offset = (uint32_t)blob.size();
+	blob += str;
+	return offset;
+}
+
+
+// ================= cache ====================
+
+string meshCachePath(const char* objFilename)
+{
+	return string(objFilename) + ".meshcache";
+}
+
+bool loadMeshCache(const char* objFilename, ObjectFileData& outData, unsigned int optimizeFlags)
+{
+	string cacheFilename = meshCachePath(objFilename);
+	MappedFile cacheFile;
+	if (!cacheFile.open(cacheFilename.c_str())) return false;
+	if (cacheFile.size() < sizeof(MeshCacheHeader)) return false;
+
+	MeshCacheHeader header;
+	memcpy(&header, cacheFile.begin(), sizeof(header));
+
+	// format checks
+	if (memcmp(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC)) != 0) return false;
+	if (header.version != MESH_CACHE_VERSION) return false;
+	if (header.attribCount != 3) return false;
+	for (int i = 0; i < 3; i++)
+	{
+		if (header.attribLayout[i] != MESH_CACHE_LAYOUT[i]) return false;
+	}
+	if (header.optimizeFlags != optimizeFlags) return false;
+
+	size_t subObjTableEnd = sizeof(MeshCacheHeader) + (size_t)header.subObjectCount * sizeof(MeshCacheSubObj);
+	if (subObjTableEnd > cacheFile.size() ||
+		header.lodOffset + header.lodCount * sizeof(MeshCacheLod) > cacheFile.size() ||
+		header.stringOffset + header.stringSize > cacheFile.size() ||
+		header.vertexOffset + header.vertexCount * sizeof(float) > cacheFile.size() ||
+		header.indexOffset + header.indexCount * sizeof(uint32_t) > cacheFile.size())
+	{
+		return false;
+	}
+
+	// source checks, the content hash is only computed when the size matches but the mtime moved
+	if (!sourceUnchanged(objFilename, header.sourceSize, header.sourceMtime, header.sourceHash)) return false;
+
+	const char* strings = cacheFile.begin() + header.stringOffset;
+	const float* vertexBlob = (const float*)(cacheFile.begin() + header.vertexOffset);
+	const uint32_t* indexBlob = (const uint32_t*)(cacheFile.begin() + header.indexOffset);
+
+	auto blobString = [&](uint32_t offset, uint32_t length) {
+		if ((uint64_t)offset + length > header.stringSize) throw invalid_argument("MeshCache::corrupted string blob");
+		return string(strings + offset, length);
+	};
+
+	ObjectFileData data;
+	try
+	{
+		data.objFilename = objFilename;
+		data.mtlFilename = blobString(header.mtlFilenameOffset, header.mtlFilenameLength);
+
+		data.subObjects.resize(header.subObjectCount);
+		for (uint32_t i = 0; i < header.subObjectCount; i++)
+		{
+			MeshCacheSubObj record;
+			memcpy(&record, cacheFile.begin() + sizeof(MeshCacheHeader) + i * sizeof(MeshCacheSubObj), sizeof(record));
+			if (record.firstVertex + record.vertexCount > header.vertexCount ||
+				record.firstIndex + record.indexCount > header.indexCount ||
+				(uint64_t)record.firstLod + record.lodCount > header.lodCount)
+			{
+				return false;
+			}
+
+			SubObj& subObj = data.subObjects[i];
+			subObj.modelObjectName = blobString(record.nameOffset, record.nameLength);
+			subObj.groupName = blobString(record.groupOffset, record.groupLength);
+			subObj.useMaterial = blobString(record.materialOffset, record.materialLength);
+			subObj.smoothShadding = blobString(record.smoothOffset, record.smoothLength);
+			subObj.faceType = (FaceType)record.faceType;
+			subObj.cacheStatsBefore = VertexCacheStats{ record.cacheStatsBefore[0], record.cacheStatsBefore[1] };
+			subObj.cacheStatsAfter = VertexCacheStats{ record.cacheStatsAfter[0], record.cacheStatsAfter[1] };
+
+			subObj.indexedVertices.assign(vertexBlob + record.firstVertex, vertexBlob + record.firstVertex + record.vertexCount);
+			subObj.indices.assign(indexBlob + record.firstIndex, indexBlob + record.firstIndex + record.indexCount);
+
+			subObj.lods.resize(record.lodCount);
+			for (uint32_t l = 0; l < record.lodCount; l++)
+			{
+				MeshCacheLod lodRecord;
+				memcpy(&lodRecord, cacheFile.begin() + header.lodOffset + (record.firstLod + l) * sizeof(MeshCacheLod), sizeof(lodRecord));
+				if (lodRecord.firstIndex + lodRecord.indexCount > header.indexCount) return false;
+
+				subObj.lods[l].indices.assign(indexBlob + lodRecord.firstIndex, indexBlob + lodRecord.firstIndex + lodRecord.indexCount);
+				subObj.lods[l].error = lodRecord.error;
+			}
+		}
+	}
+	catch (const invalid_argument&)
+	{
+		return false;
+	}
+
+	outData = move(data);
+	return true;
+}
+
+void writeMeshCache(const char* objFilename, const ObjectFileData& data, unsigned int optimizeFlags)
+{
+	MeshCacheHeader header{};
+	memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(MESH_CACHE_MAGIC));
+	header.version = MESH_CACHE_VERSION;
+	header.subObjectCount = (uint32_t)data.subObjects.size();
+	header.attribCount = 3;
+	for (int i = 0; i < 3; i++) header.attribLayout[i] = MESH_CACHE_LAYOUT[i];
+	header.optimizeFlags = optimizeFlags;
+
+	if (!sourceIdentity(objFilename, header.sourceSize, header.sourceMtime))
+		throw invalid_argument("MeshCache::source file doesn't exist");
+	MappedFile sourceFile;
+	if (!sourceFile.open(objFilename)) throw invalid_argument("MeshCache::source file can't be read");
+	header.sourceHash = hashBytes(sourceFile.begin(), sourceFile.size());
+
+	// sub object table and string blob
+	string strings;
+	header.mtlFilenameOffset = appendString(strings, data.mtlFilename);
+	header.mtlFilenameLength = (uint32_t)data.mtlFilename.size();
+
+	vector<MeshCacheSubObj> records(data.subObjects.size());
+	vector<MeshCacheLod> lodRecords;
+	uint64_t vertexCount = 0;
+	uint64_t indexCount = 0;
+	for (size_t i = 0; i < data.subObjects.size(); i++)
+	{
+		const SubObj& subObj = data.subObjects[i];
+		MeshCacheSubObj& record = records[i];
+		record.nameOffset = appendString(strings, subObj.modelObjectName);
+		record.nameLength = (uint32_t)subObj.modelObjectName.size();
+		record.groupOffset = appendString(strings, subObj.groupName);
+		record.groupLength = (uint32_t)subObj.groupName.size();
+		record.materialOffset = appendString(strings, subObj.useMaterial);
+		record.materialLength = (uint32_t)subObj.useMaterial.size();
+		record.smoothOffset = appendString(strings, subObj.smoothShadding);
+		record.smoothLength = (uint32_t)subObj.smoothShadding.size();
+		record.faceType = (uint32_t)subObj.faceType;
+		record.cacheStatsBefore[0] = subObj.cacheStatsBefore.acmr;
+		record.cacheStatsBefore[1] = subObj.cacheStatsBefore.atvr;
+		record.cacheStatsAfter[0] = subObj.cacheStatsAfter.acmr;
+		record.cacheStatsAfter[1] = subObj.cacheStatsAfter.atvr;
+
+		record.firstVertex = vertexCount;
+		record.vertexCount = subObj.indexedVertices.size();
+		record.firstIndex = indexCount;
+		record.indexCount = subObj.indices.size();
+		vertexCount += record.vertexCount;
+		indexCount += record.indexCount;
+	}
+
+	// lod indices follow all full resolution indices
+	for (size_t i = 0; i < data.subObjects.size(); i++)
+	{
+		const SubObj& subObj = data.subObjects[i];
+		records[i].firstLod = (uint32_t)lodRecords.size();
+		records[i].lodCount = (uint32_t)subObj.lods.size();
+		for (const MeshLod& lod : subObj.lods)
+		{
+			lodRecords.push_back(MeshCacheLod{ indexCount, lod.indices.size(), lod.error, 0 });
+			indexCount += lod.indices.size();
+		}
+	}
+
+	header.lodOffset = sizeof(MeshCacheHeader) + records.size() * sizeof(MeshCacheSubObj);
+	header.lodCount = lodRecords.size();
+	header.stringOffset = header.lodOffset + lodRecords.size() * sizeof(MeshCacheLod);
+	header.stringSize = strings.size();
+	header.vertexOffset = alignUp(header.stringOffset + header.stringSize, 16);
+	header.vertexCount = vertexCount;
+	header.indexOffset = alignUp(header.vertexOffset + vertexCount * sizeof(float), 16);
+	header.indexCount = indexCount;
+
+	// write to a temporary file first so a crash never leaves a half written cache behind
+	string cacheFilename = meshCachePath(objFilename);
+	string tempFilename = cacheFilename + ".tmp";
+	{
+		ofstream out(tempFilename, ios::binary | ios::trunc);
+		if (!out.good()) throw invalid_argument("MeshCache::can't create cache file");
+
+		auto padTo = [&](uint64_t offset) {
+			static const char zeros[16] = {};
+			uint64_t pos = (uint64_t)out.tellp();
+			out.write(zeros, (streamsize)(offset - pos));
+		};
+
+		out.write((const char*)&header, sizeof(header));
+		if (!records.empty()) out.write((const char*)records.data(), records.size() * sizeof(MeshCacheSubObj));
+		if (!lodRecords.empty()) out.write((const char*)lodRecords.data(), lodRecords.size() * sizeof(MeshCacheLod));
+		out.write(strings.data(), strings.size());
+
+		padTo(header.vertexOffset);
+		for (const SubObj& subObj : data.subObjects)
+		{
+			if (!subObj.indexedVertices.empty())
+				out.write((const char*)subObj.indexedVertices.data(), subObj.indexedVertices.size() * sizeof(float));
+		}
+
+		padTo(header.indexOffset);
+		for (const SubObj& subObj : data.subObjects)
+		{
+			if (!subObj.indices.empty())
+				out.write((const char*)subObj.indices.data(), subObj.indices.size() * sizeof(uint32_t));
+		}
+		for (const SubObj& subObj : data.subObjects)
+		{
+			for (const MeshLod& lod : subObj.lods)
+				out.write((const char*)lod.indices.data(), lod.indices.size() * sizeof(uint32_t));
+		}
+
+		if (!out.good()) throw invalid_argument("MeshCache::fail writing cache file");
+	}
+
+	error_code ec;
+	filesystem::rename(tempFilename, cacheFilename, ec);
+	if (ec)
+	{
+		filesystem::remove(tempFilename, ec);
+		throw invalid_argument("MeshCache::can't replace cache file");
+	}
+}
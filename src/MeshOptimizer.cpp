@@ -0,0 +1,353 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static const int LRU_CACHE_SIZE = 32;	// lru size the triangle scoring is tuned for
+
+// ================= vertex cache analysis ====================
+
+VertexCacheStats analyzeVertexCache(const vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats;
+	if (indices.size() < 3 || vertexCount == 0) return stats;
+
+	// fifo emulated with timestamps, a vertex is still cached if fewer than cacheSize misses happened since it was loaded
+	vector<unsigned int> loadedAt(vertexCount, 0);
+	unsigned int timestamp = cacheSize + 1;
+	size_t misses = 0;
+	size_t referenced = 0;
+
+	for (unsigned int idx : indices)
+	{
+		if (loadedAt[idx] == 0) referenced++;
+		if (timestamp - loadedAt[idx] > cacheSize)
+		{
+			loadedAt[idx] = timestamp++;
+			misses++;
+		}
+	}
+
+	stats.acmr = (float)misses / (float)(indices.size() / 3);
+	stats.atvr = (float)misses / (float)referenced;
+	return stats;
+}
+
+
+// ================= vertex cache optimization ====================
+
+static float vertexScore(int cachePos, unsigned int liveTriangles)
+{
+	// vertices without remaining triangles must never attract a triangle
+	if (liveTriangles == 0) return -1.f;
+
+	float score = 0.f;
+	if (cachePos >= 0)
+	{
+		// the 3 vertices of the last triangle get a fixed score so the next one doesn't just reuse the same edge
+		if (cachePos < 3) score = 0.75f;
+		else score = powf(1.f - (float)(cachePos - 3) / (float)(LRU_CACHE_SIZE - 3), 1.5f);
+	}
+
+	// favour vertices with few triangles left so they are finished and leave the cache for good
+	score += 2.f / sqrtf((float)liveTriangles);
+	return score;
+}
+
+void optimizeVertexCache(vector<unsigned int>& indices, size_t vertexCount)
+{
+	size_t triCount = indices.size() / 3;
+	if (triCount == 0) return;
+
+	// vertex -> triangles adjacency, the live part of each list shrinks as triangles are emitted
+	vector<unsigned int> liveTriangles(vertexCount, 0);
+	for (unsigned int idx : indices) liveTriangles[idx]++;
+
+	vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; v++) adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+
+	vector<unsigned int> adjacency(indices.size());
+	{
+		vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for (size_t t = 0; t < triCount; t++)
+		{
+			for (int k = 0; k < 3; k++) adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+		}
+	}
+
+	vector<int> cachePos(vertexCount, -1);
+	vector<float> vScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) vScore[v] = vertexScore(-1, liveTriangles[v]);
+
+	vector<float> tScore(triCount);
+	vector<bool> emitted(triCount, false);
+	int bestTri = -1;
+	float bestScore = -1.f;
+	for (size_t t = 0; t < triCount; t++)
+	{
+		tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+		if (tScore[t] > bestScore)
+		{
+			bestScore = tScore[t];
+			bestTri = (int)t;
+		}
+	}
+
+	vector<unsigned int> cache;
+	vector<unsigned int> newCache;
+	cache.reserve(LRU_CACHE_SIZE + 3);
+	newCache.reserve(LRU_CACHE_SIZE + 3);
+
+	vector<unsigned int> output;
+	output.reserve(indices.size());
+	size_t scanCursor = 0;
+
+	for (size_t emittedCount = 0; emittedCount < triCount; emittedCount++)
+	{
+		// nothing in the cache scored, take the next triangle in input order
+		if (bestTri < 0)
+		{
+			while (emitted[scanCursor]) scanCursor++;
+			bestTri = (int)scanCursor;
+		}
+
+		const unsigned int* tri = &indices[(size_t)bestTri * 3];
+		output.insert(output.end(), tri, tri + 3);
+		emitted[bestTri] = true;
+
+		// drop the triangle from the live adjacency of its vertices
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			unsigned int* list = &adjacency[adjacencyOffset[v]];
+			unsigned int live = liveTriangles[v];
+			for (unsigned int j = 0; j < live; j++)
+			{
+				if (list[j] == (unsigned int)bestTri)
+				{
+					list[j] = list[live - 1];
+					break;
+				}
+			}
+			liveTriangles[v]--;
+		}
+
+		// lru update, the triangle's vertices move to the front
+		newCache.assign(tri, tri + 3);
+		for (unsigned int v : cache)
+		{
+			if (v != tri[0] && v != tri[1] && v != tri[2]) newCache.push_back(v);
+		}
+
+		for (size_t i = 0; i < newCache.size(); i++)
+		{
+			unsigned int v = newCache[i];
+			cachePos[v] = i < LRU_CACHE_SIZE ? (int)i : -1;
+			vScore[v] = vertexScore(cachePos[v], liveTriangles[v]);
+		}
+		if (newCache.size() > LRU_CACHE_SIZE) newCache.resize(LRU_CACHE_SIZE);
+		swap(cache, newCache);
+
+		// only triangles touching the cache changed score, the best of them goes next
+		bestTri = -1;
+		bestScore = -1.f;
+		for (unsigned int v : cache)
+		{
+			const unsigned int* list = &adjacency[adjacencyOffset[v]];
+			for (unsigned int j = 0; j < liveTriangles[v]; j++)
+			{
+				unsigned int t = list[j];
+				tScore[t] = vScore[indices[t * 3]] + vScore[indices[t * 3 + 1]] + vScore[indices[t * 3 + 2]];
+				if (tScore[t] > bestScore)
+				{
+					bestScore = tScore[t];
+					bestTri = (int)t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+
+// ================= overdraw optimization ====================
+
+struct TriangleCluster
+{
+	size_t firstTri;
+	size_t triCount;
+	float sortKey;
+};
+
+static Vector3 vertexPosition(const vector<float>& vertices, int stride, unsigned int idx)
+{
+	const float* p = &vertices[(size_t)idx * stride];
+	return Vector3{ p[0], p[1], p[2] };
+}
+
+void optimizeOverdraw(vector<unsigned int>& indices, const vector<float>& vertices, int stride, float threshold)
+{
+	size_t triCount = indices.size() / 3;
+	size_t vertexCount = vertices.size() / stride;
+	if (triCount == 0) return;
+
+	float meshAcmr = analyzeVertexCache(indices, vertexCount).acmr;
+
+	// clusters start where the cache was flushed anyway (all 3 vertices missed), or once the running
+	// cluster, simulated from a cold cache, is within threshold of the mesh ACMR
+	vector<TriangleCluster> clusters;
+	vector<unsigned int> loadedAt(vertexCount, 0);
+	unsigned int timestamp = VERTEX_CACHE_SIZE + 1;
+	size_t clusterMisses = 0;
+
+	auto simulate = [&](size_t t) {
+		int misses = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int idx = indices[t * 3 + k];
+			if (timestamp - loadedAt[idx] > VERTEX_CACHE_SIZE)
+			{
+				loadedAt[idx] = timestamp++;
+				misses++;
+			}
+		}
+		return misses;
+	};
+
+	for (size_t t = 0; t < triCount; t++)
+	{
+		int misses = simulate(t);
+
+		bool boundary = clusters.empty() || misses == 3;
+		if (!boundary)
+		{
+			const TriangleCluster& current = clusters.back();
+			if (current.triCount >= VERTEX_CACHE_SIZE && (float)clusterMisses <= threshold * meshAcmr * (float)current.triCount)
+			{
+				// the next cluster may be drawn after any other one, it starts from a cold cache
+				boundary = true;
+				timestamp += VERTEX_CACHE_SIZE + 1;
+				misses = simulate(t);
+			}
+		}
+		if (boundary)
+		{
+			clusters.push_back(TriangleCluster{ t, 0, 0.f });
+			clusterMisses = 0;
+		}
+		clusters.back().triCount++;
+		clusterMisses += misses;
+	}
+
+	// area weighted centroid and normal of each cluster, and of the whole mesh
+	vector<Vector3> centroids(clusters.size());
+	vector<Vector3> normals(clusters.size());
+	Vector3 meshCentroid{ 0.f, 0.f, 0.f };
+	float meshArea = 0.f;
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		Vector3 centroid{ 0.f, 0.f, 0.f };
+		Vector3 normal{ 0.f, 0.f, 0.f };
+		float area = 0.f;
+
+		for (size_t t = clusters[c].firstTri; t < clusters[c].firstTri + clusters[c].triCount; t++)
+		{
+			Vector3 a = vertexPosition(vertices, stride, indices[t * 3]);
+			Vector3 b = vertexPosition(vertices, stride, indices[t * 3 + 1]);
+			Vector3 d = vertexPosition(vertices, stride, indices[t * 3 + 2]);
+
+			Vector3 e1{ b.x - a.x, b.y - a.y, b.z - a.z };
+			Vector3 e2{ d.x - a.x, d.y - a.y, d.z - a.z };
+			Vector3 n{ e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+			float triArea = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+
+			centroid.x += (a.x + b.x + d.x) * triArea;
+			centroid.y += (a.y + b.y + d.y) * triArea;
+			centroid.z += (a.z + b.z + d.z) * triArea;
+			normal.x += n.x;
+			normal.y += n.y;
+			normal.z += n.z;
+			area += triArea;
+		}
+
+		meshCentroid.x += centroid.x;
+		meshCentroid.y += centroid.y;
+		meshCentroid.z += centroid.z;
+		meshArea += area;
+
+		float invArea = area > 0.f ? 1.f / (3.f * area) : 0.f;
+		centroids[c] = Vector3{ centroid.x * invArea, centroid.y * invArea, centroid.z * invArea };
+
+		float normalLength = sqrtf(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+		float invLength = normalLength > 0.f ? 1.f / normalLength : 0.f;
+		normals[c] = Vector3{ normal.x * invLength, normal.y * invLength, normal.z * invLength };
+	}
+
+	float invMeshArea = meshArea > 0.f ? 1.f / (3.f * meshArea) : 0.f;
+	meshCentroid = Vector3{ meshCentroid.x * invMeshArea, meshCentroid.y * invMeshArea, meshCentroid.z * invMeshArea };
+
+	// clusters facing away from the center are likely in front of the rest, draw them first
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		clusters[c].sortKey =
+			(centroids[c].x - meshCentroid.x) * normals[c].x +
+			(centroids[c].y - meshCentroid.y) * normals[c].y +
+			(centroids[c].z - meshCentroid.z) * normals[c].z;
+	}
+	stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& a, const TriangleCluster& b) {
+		return a.sortKey > b.sortKey;
+	});
+
+	vector<unsigned int> output;
+	output.reserve(indices.size());
+	for (const TriangleCluster& cluster : clusters)
+	{
+		output.insert(output.end(), indices.begin() + cluster.firstTri * 3, indices.begin() + (cluster.firstTri + cluster.triCount) * 3);
+	}
+	indices.swap(output);
+}
+
+
+// ================= vertex fetch optimization ====================
+
+void optimizeVertexFetch(vector<float>& vertices, vector<unsigned int>& indices, int stride)
+{
+	size_t vertexCount = vertices.size() / stride;
+	vector<unsigned int> remap(vertexCount, ~0u);
+	vector<float> output;
+	output.reserve(vertices.size());
+
+	unsigned int nextVertex = 0;
+	for (unsigned int& idx : indices)
+	{
+		if (remap[idx] == ~0u)
+		{
+			remap[idx] = nextVertex++;
+			output.insert(output.end(), vertices.begin() + (size_t)idx * stride, vertices.begin() + ((size_t)idx + 1) * stride);
+		}
+		idx = remap[idx];
+	}
+	vertices.swap(output);
+}
+
+
+// ================= sub object pass ====================
+
+void optimizeSubObj(SubObj& subObj, int stride, bool overdraw)
+{
+	vector<float>& vertices = subObj.indexedVertices;
+	vector<unsigned int>& indices = subObj.indices;
+	if (indices.empty()) return;
+
+	size_t vertexCount = vertices.size() / stride;
+	subObj.cacheStatsBefore = analyzeVertexCache(indices, vertexCount);
+
+	optimizeVertexCache(indices, vertexCount);
+	if (overdraw) optimizeOverdraw(indices, vertices, stride);
+	optimizeVertexFetch(vertices, indices, stride);
+
+	subObj.cacheStatsAfter = analyzeVertexCache(indices, vertices.size() / stride);
+}
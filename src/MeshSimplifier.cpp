@@ -0,0 +1,464 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static const double BORDER_WEIGHT = 10.0;		// border/seam planes against face planes
+static const float FLIP_THRESHOLD = 0.25f;		// smallest cosine between a triangle normal before and after a collapse
+static const float MIN_LOD_REDUCTION = 0.9f;	// a level keeping more triangles than this ratio isn't worth storing
+
+enum class VertexKind
+{
+	MANIFOLD,	// moves onto any neighbour
+	BORDER,		// slides along its open edges
+	SEAM,		// slides along the seam, its twin follows on the other side
+	LOCKED
+};
+
+// weighted sum of squared plane distances, x'Ax + 2b'x + c
+struct Quadric
+{
+	double a00, a01, a02, a11, a12, a22;
+	double b0, b1, b2;
+	double c;
+	double weight;
+};
+
+struct EdgeCollapse
+{
+	unsigned int from, to;
+	unsigned int twinFrom, twinTo;	// seam twin, ~0u if none
+	float cost;
+};
+
+// triangles around each vertex
+struct VertexTriangles
+{
+	vector<unsigned int> offsets;	// vertexCount + 1
+	vector<unsigned int> triangles;
+};
+
+// open edges of a vertex, an edge is open when no triangle has its reverse
+struct OpenEdges
+{
+	unsigned int out = ~0u, in = ~0u;	// other end of the last open edge leaving/entering the vertex
+	int outCount = 0, inCount = 0;
+};
+
+
+// ================= helpers ====================
+
+static Vector3 sub(const Vector3& a, const Vector3& b)
+{
+	return Vector3{ a.x - b.x, a.y - b.y, a.z - b.z };
+}
+
+static Vector3 cross(const Vector3& a, const Vector3& b)
+{
+	return Vector3{ a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+}
+
+static float dot(const Vector3& a, const Vector3& b)
+{
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+static void addPlane(Quadric& q, const Vector3& n, float d, double w)
+{
+	q.a00 += w * n.x * n.x; q.a01 += w * n.x * n.y; q.a02 += w * n.x * n.z;
+	q.a11 += w * n.y * n.y; q.a12 += w * n.y * n.z; q.a22 += w * n.z * n.z;
+	q.b0 += w * n.x * d; q.b1 += w * n.y * d; q.b2 += w * n.z * d;
+	q.c += w * d * d;
+	q.weight += w;
+}
+
+static void addQuadric(Quadric& q, const Quadric& other)
+{
+	q.a00 += other.a00; q.a01 += other.a01; q.a02 += other.a02;
+	q.a11 += other.a11; q.a12 += other.a12; q.a22 += other.a22;
+	q.b0 += other.b0; q.b1 += other.b1; q.b2 += other.b2;
+	q.c += other.c;
+	q.weight += other.weight;
+}
+
+// weighted mean of the squared plane distances
+static double quadricError(const Quadric& q, const Vector3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double r = q.a00 * x * x + q.a11 * y * y + q.a22 * z * z
+		+ 2.0 * (q.a01 * x * y + q.a02 * x * z + q.a12 * y * z)
+		+ 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z)
+		+ q.c;
+	return q.weight > 0.0 ? fabs(r) / q.weight : 0.0;
+}
+
+static void buildVertexTriangles(VertexTriangles& adj, const vector<unsigned int>& indices, size_t vertexCount)
+{
+	adj.offsets.assign(vertexCount + 1, 0);
+	for (unsigned int idx : indices) adj.offsets[idx + 1]++;
+	for (size_t v = 0; v < vertexCount; v++) adj.offsets[v + 1] += adj.offsets[v];
+
+	adj.triangles.resize(indices.size());
+	vector<unsigned int> fill(adj.offsets.begin(), adj.offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) adj.triangles[fill[indices[i]]++] = (unsigned int)(i / 3);
+}
+
+// some triangle has the directed edge a -> b
+static bool hasEdge(const VertexTriangles& adj, const vector<unsigned int>& indices, unsigned int a, unsigned int b)
+{
+	for (unsigned int i = adj.offsets[a]; i < adj.offsets[a + 1]; i++)
+	{
+		const unsigned int* tri = &indices[(size_t)adj.triangles[i] * 3];
+		for (int k = 0; k < 3; k++)
+		{
+			if (tri[k] == a && tri[(k + 1) % 3] == b) return true;
+		}
+	}
+	return false;
+}
+
+static OpenEdges findOpenEdges(const VertexTriangles& adj, const vector<unsigned int>& indices, unsigned int v)
+{
+	OpenEdges open;
+	for (unsigned int i = adj.offsets[v]; i < adj.offsets[v + 1]; i++)
+	{
+		const unsigned int* tri = &indices[(size_t)adj.triangles[i] * 3];
+		int k = tri[0] == v ? 0 : tri[1] == v ? 1 : 2;
+		unsigned int next = tri[(k + 1) % 3];
+		unsigned int prev = tri[(k + 2) % 3];
+
+		if (!hasEdge(adj, indices, next, v))
+		{
+			open.out = next;
+			open.outCount++;
+		}
+		if (!hasEdge(adj, indices, v, prev))
+		{
+			open.in = prev;
+			open.inCount++;
+		}
+	}
+	return open;
+}
+
+static bool isSimpleOpen(const OpenEdges& open)
+{
+	return open.outCount == 1 && open.inCount == 1;
+}
+
+// moving from onto to turns a remaining triangle of from (nearly) upside down
+static bool collapseFlips(const VertexTriangles& adj, const vector<unsigned int>& indices, const vector<Vector3>& positions,
+	const vector<unsigned int>& positionId, unsigned int from, unsigned int to)
+{
+	for (unsigned int i = adj.offsets[from]; i < adj.offsets[from + 1]; i++)
+	{
+		const unsigned int* tri = &indices[(size_t)adj.triangles[i] * 3];
+		if (positionId[tri[0]] == positionId[to] || positionId[tri[1]] == positionId[to] || positionId[tri[2]] == positionId[to]) continue;
+
+		Vector3 p[3], moved[3];
+		for (int k = 0; k < 3; k++)
+		{
+			p[k] = positions[tri[k]];
+			moved[k] = tri[k] == from ? positions[to] : p[k];
+		}
+
+		Vector3 before = cross(sub(p[1], p[0]), sub(p[2], p[0]));
+		Vector3 after = cross(sub(moved[1], moved[0]), sub(moved[2], moved[0]));
+		if (dot(before, after) < FLIP_THRESHOLD * sqrtf(dot(before, before) * dot(after, after))) return true;
+	}
+	return false;
+}
+
+
+// ================= simplification ====================
+
+float meshRadius(const vector<float>& vertices, int stride)
+{
+	size_t vertexCount = vertices.size() / stride;
+	if (vertexCount == 0) return 0.f;
+
+	Vector3 minP{ vertices[0], vertices[1], vertices[2] };
+	Vector3 maxP = minP;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const float* p = &vertices[v * stride];
+		minP = Vector3{ min(minP.x, p[0]), min(minP.y, p[1]), min(minP.z, p[2]) };
+		maxP = Vector3{ max(maxP.x, p[0]), max(maxP.y, p[1]), max(maxP.z, p[2]) };
+	}
+
+	Vector3 center{ (minP.x + maxP.x) * 0.5f, (minP.y + maxP.y) * 0.5f, (minP.z + maxP.z) * 0.5f };
+	float radius = 0.f;
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		Vector3 d = sub(Vector3{ vertices[v * stride], vertices[v * stride + 1], vertices[v * stride + 2] }, center);
+		radius = max(radius, dot(d, d));
+	}
+	return sqrtf(radius);
+}
+
+vector<unsigned int> simplifyMesh(const vector<float>& vertices, const vector<unsigned int>& indices, int stride,
+	size_t targetIndexCount, float* outError)
+{
+	size_t vertexCount = vertices.size() / stride;
+	vector<unsigned int> result = indices;
+	if (outError) *outError = 0.f;
+	if (result.size() <= targetIndexCount || vertexCount == 0) return result;
+
+	// positions scaled to the unit sphere, so errors are relative to the mesh radius
+	float radius = meshRadius(vertices, stride);
+	float invRadius = radius > 0.f ? 1.f / radius : 1.f;
+	vector<Vector3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		const float* p = &vertices[v * stride];
+		positions[v] = Vector3{ p[0] * invRadius, p[1] * invRadius, p[2] * invRadius };
+	}
+
+	// vertices sharing a position (split by uv or normal) get the same id and form a sibling ring
+	vector<unsigned int> positionId(vertexCount);
+	vector<unsigned int> sibling(vertexCount);
+	vector<unsigned int> siblingCount(vertexCount, 1);
+	{
+		vector<unsigned int> order(vertexCount);
+		for (size_t v = 0; v < vertexCount; v++) order[v] = (unsigned int)v;
+		auto samePosition = [&](unsigned int a, unsigned int b) {
+			return positions[a].x == positions[b].x && positions[a].y == positions[b].y && positions[a].z == positions[b].z;
+		};
+		sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+			if (positions[a].x != positions[b].x) return positions[a].x < positions[b].x;
+			if (positions[a].y != positions[b].y) return positions[a].y < positions[b].y;
+			return positions[a].z < positions[b].z;
+		});
+
+		for (size_t first = 0; first < vertexCount;)
+		{
+			size_t last = first + 1;
+			while (last < vertexCount && samePosition(order[first], order[last])) last++;
+			for (size_t i = first; i < last; i++)
+			{
+				positionId[order[i]] = order[first];
+				sibling[order[i]] = order[i + 1 < last ? i + 1 : first];
+				siblingCount[order[i]] = (unsigned int)(last - first);
+			}
+			first = last;
+		}
+	}
+
+	VertexTriangles adj;
+	buildVertexTriangles(adj, result, vertexCount);
+
+	// classify once, the collapse rules keep borders and seams intact afterwards
+	vector<VertexKind> kind(vertexCount, VertexKind::LOCKED);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		OpenEdges open = findOpenEdges(adj, result, (unsigned int)v);
+		bool closed = open.outCount == 0 && open.inCount == 0;
+
+		if (siblingCount[v] == 1)
+		{
+			if (closed) kind[v] = VertexKind::MANIFOLD;
+			else if (isSimpleOpen(open)) kind[v] = VertexKind::BORDER;
+		}
+		else if (siblingCount[v] == 2 && isSimpleOpen(open))
+		{
+			// the open edges of both twins must be the two sides of the same seam
+			OpenEdges twinOpen = findOpenEdges(adj, result, sibling[v]);
+			if (isSimpleOpen(twinOpen) &&
+				positionId[open.out] == positionId[twinOpen.in] &&
+				positionId[open.in] == positionId[twinOpen.out])
+			{
+				kind[v] = VertexKind::SEAM;
+			}
+		}
+	}
+
+	// face planes weighted by area, open edges (borders and seams) add a perpendicular plane to keep their shape
+	vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t t = 0; t < result.size() / 3; t++)
+	{
+		const unsigned int* tri = &result[t * 3];
+		Vector3 normal = cross(sub(positions[tri[1]], positions[tri[0]]), sub(positions[tri[2]], positions[tri[0]]));
+		float doubleArea = sqrtf(dot(normal, normal));
+		if (doubleArea == 0.f) continue;
+		normal = Vector3{ normal.x / doubleArea, normal.y / doubleArea, normal.z / doubleArea };
+
+		float d = -dot(normal, positions[tri[0]]);
+		for (int k = 0; k < 3; k++) addPlane(quadrics[tri[k]], normal, d, doubleArea * 0.5);
+
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int a = tri[k], b = tri[(k + 1) % 3];
+			if (hasEdge(adj, result, b, a)) continue;
+
+			Vector3 edge = sub(positions[b], positions[a]);
+			Vector3 edgeNormal = cross(edge, normal);
+			float length = sqrtf(dot(edgeNormal, edgeNormal));
+			if (length == 0.f) continue;
+			edgeNormal = Vector3{ edgeNormal.x / length, edgeNormal.y / length, edgeNormal.z / length };
+
+			float edgeD = -dot(edgeNormal, positions[a]);
+			double w = dot(edge, edge) * BORDER_WEIGHT;
+			addPlane(quadrics[a], edgeNormal, edgeD, w);
+			addPlane(quadrics[b], edgeNormal, edgeD, w);
+		}
+	}
+
+	vector<unsigned int> remap(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++) remap[v] = (unsigned int)v;
+	vector<OpenEdges> openEdges(vertexCount);
+	vector<char> touched(vertexCount);
+	vector<EdgeCollapse> collapses;
+	double maxError = 0.0;
+
+	// passes of independent collapses, cheapest first, until the target is met or nothing can move
+	while (result.size() > targetIndexCount)
+	{
+		buildVertexTriangles(adj, result, vertexCount);
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			if (kind[v] == VertexKind::BORDER || kind[v] == VertexKind::SEAM) openEdges[v] = findOpenEdges(adj, result, (unsigned int)v);
+		}
+
+		auto tryCollapse = [&](unsigned int from, unsigned int to) {
+			EdgeCollapse collapse{ from, to, ~0u, ~0u, 0.f };
+			Quadric q = quadrics[from];
+
+			if (kind[from] == VertexKind::LOCKED) return;
+			if (kind[from] != VertexKind::MANIFOLD)
+			{
+				// only along the open edge, onto a vertex of the same border/seam or a corner
+				const OpenEdges& open = openEdges[from];
+				if (!isSimpleOpen(open) || (open.out != to && open.in != to)) return;
+				if (kind[to] != kind[from] && kind[to] != VertexKind::LOCKED) return;
+			}
+			if (kind[from] == VertexKind::SEAM)
+			{
+				// the twin takes the matching edge on its side of the seam
+				unsigned int twin = sibling[from];
+				const OpenEdges& twinOpen = openEdges[twin];
+				if (!isSimpleOpen(twinOpen)) return;
+				unsigned int twinTo = openEdges[from].out == to ? twinOpen.in : twinOpen.out;
+				if (positionId[twinTo] != positionId[to]) return;
+
+				collapse.twinFrom = twin;
+				collapse.twinTo = twinTo;
+				addQuadric(q, quadrics[twin]);
+			}
+
+			collapse.cost = (float)quadricError(q, positions[to]);
+			collapses.push_back(collapse);
+		};
+
+		collapses.clear();
+		for (size_t t = 0; t < result.size() / 3; t++)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = result[t * 3 + k], b = result[t * 3 + (k + 1) % 3];
+				// closed edges show up in both of their triangles
+				if (a > b && hasEdge(adj, result, b, a)) continue;
+				tryCollapse(a, b);
+				tryCollapse(b, a);
+			}
+		}
+		sort(collapses.begin(), collapses.end(), [](const EdgeCollapse& a, const EdgeCollapse& b) {
+			return a.cost < b.cost;
+		});
+
+		// a collapse needs its whole neighbourhood untouched in this pass, so the flip check sees final positions
+		size_t triCount = result.size() / 3;
+		size_t targetTriCount = targetIndexCount / 3;
+		size_t removed = 0;
+		size_t applied = 0;
+		fill(touched.begin(), touched.end(), 0);
+
+		auto ringTouched = [&](unsigned int v) {
+			for (unsigned int i = adj.offsets[v]; i < adj.offsets[v + 1]; i++)
+			{
+				const unsigned int* tri = &result[(size_t)adj.triangles[i] * 3];
+				if (touched[positionId[tri[0]]] || touched[positionId[tri[1]]] || touched[positionId[tri[2]]]) return true;
+			}
+			return false;
+		};
+		auto touchRing = [&](unsigned int v) {
+			for (unsigned int i = adj.offsets[v]; i < adj.offsets[v + 1]; i++)
+			{
+				const unsigned int* tri = &result[(size_t)adj.triangles[i] * 3];
+				for (int k = 0; k < 3; k++) touched[positionId[tri[k]]] = 1;
+			}
+		};
+
+		for (const EdgeCollapse& collapse : collapses)
+		{
+			if (triCount - removed <= targetTriCount) break;
+
+			bool hasTwin = collapse.twinFrom != ~0u;
+			if (ringTouched(collapse.from) || (hasTwin && ringTouched(collapse.twinFrom))) continue;
+			if (collapseFlips(adj, result, positions, positionId, collapse.from, collapse.to)) continue;
+			if (hasTwin && collapseFlips(adj, result, positions, positionId, collapse.twinFrom, collapse.twinTo)) continue;
+
+			touchRing(collapse.from);
+			remap[collapse.from] = collapse.to;
+			addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			if (hasTwin)
+			{
+				touchRing(collapse.twinFrom);
+				remap[collapse.twinFrom] = collapse.twinTo;
+				addQuadric(quadrics[collapse.twinTo], quadrics[collapse.twinFrom]);
+			}
+
+			removed += kind[collapse.from] == VertexKind::BORDER ? 1 : 2;
+			maxError = max(maxError, (double)collapse.cost);
+			applied++;
+		}
+		if (applied == 0) break;
+
+		// move collapsed corners and drop the triangles that lost their area
+		size_t writeIdx = 0;
+		for (size_t t = 0; t < result.size() / 3; t++)
+		{
+			unsigned int a = remap[result[t * 3]], b = remap[result[t * 3 + 1]], c = remap[result[t * 3 + 2]];
+			if (positionId[a] == positionId[b] || positionId[b] == positionId[c] || positionId[a] == positionId[c]) continue;
+			result[writeIdx++] = a;
+			result[writeIdx++] = b;
+			result[writeIdx++] = c;
+		}
+		result.resize(writeIdx);
+		for (size_t v = 0; v < vertexCount; v++) remap[v] = (unsigned int)v;
+	}
+
+	if (outError) *outError = sqrtf((float)maxError);
+	return result;
+}
+
+
+// ================= lod chain ====================
+
+void buildLodChain(SubObj& subObj, int stride)
+{
+	subObj.lods.clear();
+	subObj.lods.reserve(MESH_LOD_COUNT - 1);
+
+	const vector<float>& vertices = subObj.indexedVertices;
+	size_t vertexCount = vertices.size() / stride;
+	float error = 0.f;
+
+	for (unsigned int level = 1; level < MESH_LOD_COUNT; level++)
+	{
+		const vector<unsigned int>& source = subObj.lods.empty() ? subObj.indices : subObj.lods.back().indices;
+		size_t target = (size_t)(source.size() / 3 * MESH_LOD_REDUCTION) * 3;
+
+		float levelError;
+		MeshLod lod;
+		lod.indices = simplifyMesh(vertices, source, stride, target, &levelError);
+		if (lod.indices.empty() || lod.indices.size() > source.size() * MIN_LOD_REDUCTION) break;
+
+		// each level is simplified from the previous one, so the errors add up
+		error += levelError;
+		lod.error = error;
+		optimizeVertexCache(lod.indices, vertexCount);
+		subObj.lods.push_back(move(lod));
+	}
+}
@@ -0,0 +1,487 @@
+#include "MipChain.h"
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_CHAIN_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+static const float FILTER_RADIUS = 3.f;		// kaiser and lanczos support, in texels of the smaller level
+static const float KAISER_ALPHA = 4.f;
+static const int BAND_ROWS = 32;			// output rows filtered together, their source rows stay in cache
+static const int MIN_THREAD_ROWS = 64;		// output rows per thread below which a level stays on one thread
+static const int LINEAR_TABLE_SIZE = 16384;	// linear -> sRGB steps, fine enough for the darkest sRGB values
+
+
+// ================= sRGB ====================
+
+// texel values stay 0..255, in linear light for sRGB channels
+struct SrgbTables
+{
+	float toLinear[256];
+	unsigned char toSrgb[LINEAR_TABLE_SIZE];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.f;
+			toLinear[i] = 255.f * (c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f));
+		}
+		for (int i = 0; i < LINEAR_TABLE_SIZE; i++)
+		{
+			float c = (float)i / (LINEAR_TABLE_SIZE - 1);
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+			toSrgb[i] = (unsigned char)(s * 255.f + 0.5f);
+		}
+	}
+};
+
+static const SrgbTables& srgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+float srgbToLinear(unsigned char value)
+{
+	return srgbTables().toLinear[value];
+}
+
+unsigned char linearToSrgb(float value)
+{
+	int step = (int)(value * ((LINEAR_TABLE_SIZE - 1) / 255.f) + 0.5f);
+	return srgbTables().toSrgb[max(0, min(LINEAR_TABLE_SIZE - 1, step))];
+}
+
+
+// ================= filter kernels ====================
+
+static float sinc(float x)
+{
+	if (fabsf(x) < 1e-6f) return 1.f;
+	float px = 3.14159265f * x;
+	return sinf(px) / px;
+}
+
+// modified bessel function of the first kind, order 0
+static float besselI0(float x)
+{
+	float sum = 1.f, term = 1.f;
+	for (int k = 1; k < 32; k++)
+	{
+		term *= (x / (2.f * k)) * (x / (2.f * k));
+		sum += term;
+		if (term < sum * 1e-8f) break;
+	}
+	return sum;
+}
+
+// x in texels of the smaller level
+static float kernelWeight(MipFilter filter, float x)
+{
+	x = fabsf(x);
+	switch (filter)
+	{
+	case MipFilter::Box:
+		return x <= 0.5f ? 1.f : 0.f;
+	case MipFilter::Kaiser:
+	{
+		if (x >= FILTER_RADIUS) return 0.f;
+		float t = x / FILTER_RADIUS;
+		return sinc(x) * besselI0(KAISER_ALPHA * sqrtf(1.f - t * t)) / besselI0(KAISER_ALPHA);
+	}
+	default:
+		return x < FILTER_RADIUS ? sinc(x) * sinc(x / FILTER_RADIUS) : 0.f;
+	}
+}
+
+// the same number of taps for every output texel of an axis (padded with zero weights), source
+// indices clamped to the edge
+struct AxisWeights
+{
+	int taps = 0;
+	vector<int> indices;	// outSize * taps
+	vector<float> weights;
+};
+
+static AxisWeights axisWeights(MipFilter filter, int inSize, int outSize)
+{
+	float scale = (float)inSize / (float)outSize;
+	float support = (filter == MipFilter::Box ? 0.5f : FILTER_RADIUS) * scale;
+
+	vector<vector<pair<int, float>>> perOutput(outSize);
+	int taps = 1;
+	for (int i = 0; i < outSize; i++)
+	{
+		float center = (i + 0.5f) * scale - 0.5f;
+		int first = (int)floorf(center - support), last = (int)ceilf(center + support);
+		float sum = 0.f;
+		for (int k = first; k <= last; k++)
+		{
+			float w = kernelWeight(filter, (k - center) / scale);
+			if (w == 0.f) continue;
+			perOutput[i].push_back({ min(max(k, 0), inSize - 1), w });
+			sum += w;
+		}
+		// nothing in reach (1 texel levels), the nearest texel
+		if (perOutput[i].empty() || sum == 0.f)
+		{
+			perOutput[i].assign(1, { min(max((int)floorf(center + 0.5f), 0), inSize - 1), 1.f });
+			sum = 1.f;
+		}
+		for (auto& tap : perOutput[i]) tap.second /= sum;
+		taps = max(taps, (int)perOutput[i].size());
+	}
+
+	AxisWeights axis;
+	axis.taps = taps;
+	axis.indices.resize((size_t)outSize * taps);
+	axis.weights.resize((size_t)outSize * taps, 0.f);
+	for (int i = 0; i < outSize; i++)
+	{
+		for (int t = 0; t < taps; t++)
+		{
+			bool padding = t >= (int)perOutput[i].size();
+			axis.indices[(size_t)i * taps + t] = padding ? perOutput[i].back().first : perOutput[i][t].first;
+			axis.weights[(size_t)i * taps + t] = padding ? 0.f : perOutput[i][t].second;
+		}
+	}
+	return axis;
+}
+
+
+// ================= box filter, 8 bit ====================
+
+// the last row/column of odd sizes is folded into its neighbour
+static void downsampleBox(const unsigned char* pixels, int width, int height, int channels, unsigned char* out, int outWidth, int firstRow, int lastRow)
+{
+	for (int y = firstRow; y < lastRow; y++)
+	{
+		int y0 = min(y * 2, height - 1), y1 = min(y * 2 + 1, height - 1);
+		const unsigned char* row0 = pixels + (size_t)y0 * width * channels;
+		const unsigned char* row1 = pixels + (size_t)y1 * width * channels;
+		unsigned char* dst = out + (size_t)y * outWidth * channels;
+		int x = 0;
+
+#ifdef MIP_CHAIN_SSE2
+		// rgba, two output texels from four source texels of both rows
+		if (channels == 4 && width > 1)
+		{
+			const __m128i zero = _mm_setzero_si128(), rounding = _mm_set1_epi16(2);
+			for (; x + 2 <= outWidth; x += 2)
+			{
+				__m128i a = _mm_loadu_si128((const __m128i*)(row0 + x * 8));
+				__m128i b = _mm_loadu_si128((const __m128i*)(row1 + x * 8));
+				__m128i low = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+				__m128i high = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+				low = _mm_add_epi16(low, _mm_srli_si128(low, 8));
+				high = _mm_add_epi16(high, _mm_srli_si128(high, 8));
+				__m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(low, high), rounding), 2);
+				_mm_storel_epi64((__m128i*)(dst + x * 4), _mm_packus_epi16(sum, zero));
+			}
+		}
+#endif
+
+		for (; x < outWidth; x++)
+		{
+			int x0 = min(x * 2, width - 1) * channels, x1 = min(x * 2 + 1, width - 1) * channels;
+			for (int c = 0; c < channels; c++)
+			{
+				dst[x * channels + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+			}
+		}
+	}
+}
+
+
+// ================= separable filter, float ====================
+
+// one source row to floats, sRGB channels to linear light
+static void rowToFloat(const unsigned char* row, int width, int channels, bool srgb, float* out)
+{
+	const float* toLinear = srgbTables().toLinear;
+	size_t count = (size_t)width * channels;
+	if (!srgb)
+	{
+		for (size_t i = 0; i < count; i++) out[i] = row[i];
+		return;
+	}
+	for (size_t i = 0; i < count; i += 4)
+	{
+		out[i] = toLinear[row[i]];
+		out[i + 1] = toLinear[row[i + 1]];
+		out[i + 2] = toLinear[row[i + 2]];
+		out[i + 3] = row[i + 3];
+	}
+}
+
+static void horizontalPass(const float* row, int channels, const AxisWeights& axis, int outWidth, float* out)
+{
+	const int taps = axis.taps;
+#ifdef MIP_CHAIN_SSE2
+	if (channels == 4)
+	{
+		for (int x = 0; x < outWidth; x++)
+		{
+			const int* indices = &axis.indices[(size_t)x * taps];
+			const float* weights = &axis.weights[(size_t)x * taps];
+			__m128 sum = _mm_setzero_ps();
+			for (int t = 0; t < taps; t++)
+			{
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(row + (size_t)indices[t] * 4)));
+			}
+			_mm_storeu_ps(out + (size_t)x * 4, sum);
+		}
+		return;
+	}
+#endif
+	for (int x = 0; x < outWidth; x++)
+	{
+		const int* indices = &axis.indices[(size_t)x * taps];
+		const float* weights = &axis.weights[(size_t)x * taps];
+		for (int c = 0; c < channels; c++)
+		{
+			float sum = 0.f;
+			for (int t = 0; t < taps; t++) sum += weights[t] * row[(size_t)indices[t] * channels + c];
+			out[(size_t)x * channels + c] = sum;
+		}
+	}
+}
+
+// out = sum of weights[t] * rows[t], channels don't matter here
+static void verticalPass(const float* const* rows, const float* weights, int taps, size_t count, float* out)
+{
+	size_t i = 0;
+#if defined(__AVX__)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		for (int t = 0; t < taps; t++) sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[t]), _mm256_loadu_ps(rows[t] + i)));
+		_mm256_storeu_ps(out + i, sum);
+	}
+#endif
+#ifdef MIP_CHAIN_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		for (int t = 0; t < taps; t++) sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[t]), _mm_loadu_ps(rows[t] + i)));
+		_mm_storeu_ps(out + i, sum);
+	}
+#endif
+	for (; i < count; i++)
+	{
+		float sum = 0.f;
+		for (int t = 0; t < taps; t++) sum += weights[t] * rows[t][i];
+		out[i] = sum;
+	}
+}
+
+// filtered floats back to 8 bit, linear channels re-encoded as sRGB (ringing is clamped)
+static void rowToBytes(const float* row, int width, int channels, bool srgb, unsigned char* out)
+{
+	const unsigned char* toSrgb = srgbTables().toSrgb;
+	const float linearScale = (LINEAR_TABLE_SIZE - 1) / 255.f;
+	for (size_t i = 0; i < (size_t)width * channels; i++)
+	{
+		float v = min(max(row[i], 0.f), 255.f);
+		bool linear = srgb && (i & 3) != 3;
+		out[i] = linear ? toSrgb[(int)(v * linearScale + 0.5f)] : (unsigned char)(v + 0.5f);
+	}
+}
+
+static void filterRows(const unsigned char* pixels, int width, int channels, bool srgb, const AxisWeights& xAxis, const AxisWeights& yAxis,
+	unsigned char* out, int outWidth, int firstRow, int lastRow)
+{
+	size_t sourceCount = (size_t)width * channels, outCount = (size_t)outWidth * channels;
+	vector<float> sourceRow(sourceCount), band, outRow(outCount);
+	vector<const float*> rows(yAxis.taps);
+
+	// source rows of a band are filtered horizontally once, then every output row of the band is a vertical sum
+	for (int bandFirst = firstRow; bandFirst < lastRow; bandFirst += BAND_ROWS)
+	{
+		int bandLast = min(lastRow, bandFirst + BAND_ROWS);
+		// tap indices only grow, along a row's taps and from row to row
+		int sourceFirst = yAxis.indices[(size_t)bandFirst * yAxis.taps];
+		int sourceLast = yAxis.indices[(size_t)(bandLast - 1) * yAxis.taps + yAxis.taps - 1];
+
+		band.resize((size_t)(sourceLast - sourceFirst + 1) * outCount);
+		for (int y = sourceFirst; y <= sourceLast; y++)
+		{
+			rowToFloat(pixels + (size_t)y * sourceCount, width, channels, srgb, sourceRow.data());
+			horizontalPass(sourceRow.data(), channels, xAxis, outWidth, &band[(size_t)(y - sourceFirst) * outCount]);
+		}
+
+		for (int y = bandFirst; y < bandLast; y++)
+		{
+			for (int t = 0; t < yAxis.taps; t++)
+			{
+				rows[t] = &band[(size_t)(yAxis.indices[(size_t)y * yAxis.taps + t] - sourceFirst) * outCount];
+			}
+			verticalPass(rows.data(), &yAxis.weights[(size_t)y * yAxis.taps], yAxis.taps, outCount, outRow.data());
+			rowToBytes(outRow.data(), outWidth, channels, srgb, out + (size_t)y * outCount);
+		}
+	}
+}
+
+
+// ================= alpha coverage ====================
+
+// share of texels whose alpha, scaled, passes reference (0..255)
+static float coverage(const size_t histogram[256], size_t texels, float scale, float reference)
+{
+	size_t passing = 0;
+	for (int a = 0; a < 256; a++)
+	{
+		if (min(255.f, a * scale) > reference) passing += histogram[a];
+	}
+	return (float)passing / (float)texels;
+}
+
+static void alphaHistogram(const unsigned char* rgba, size_t texels, size_t histogram[256])
+{
+	fill(histogram, histogram + 256, 0);
+	for (size_t i = 0; i < texels; i++) histogram[rgba[i * 4 + 3]]++;
+}
+
+// scales the alpha of a level so its coverage matches the base level's
+static void preserveCoverage(unsigned char* rgba, size_t texels, float targetCoverage, float reference)
+{
+	size_t histogram[256];
+	alphaHistogram(rgba, texels, histogram);
+
+	float low = 0.f, high = 4.f, scale = 1.f;
+	for (int i = 0; i < 16; i++)
+	{
+		scale = (low + high) * 0.5f;
+		if (coverage(histogram, texels, scale, reference) < targetCoverage) low = scale;
+		else high = scale;
+	}
+	// coverage moves in steps, take the side of the step closer to the target
+	float lowError = fabs(coverage(histogram, texels, low, reference) - targetCoverage);
+	float highError = fabs(coverage(histogram, texels, high, reference) - targetCoverage);
+	scale = lowError < highError ? low : high;
+
+	unsigned char table[256];
+	for (int a = 0; a < 256; a++) table[a] = (unsigned char)min(255.f, a * scale + 0.5f);
+	for (size_t i = 0; i < texels; i++) rgba[i * 4 + 3] = table[rgba[i * 4 + 3]];
+}
+
+
+// ================= mip chain ====================
+
+uint32_t MipOptions::key() const
+{
+	uint32_t coverageKey = (uint32_t)(min(max(alphaCoverage, 0.f), 1.f) * 255.f + 0.5f);
+	return (uint32_t)filter | (srgb ? 0x100u : 0u) | coverageKey << 16;
+}
+
+bool expandToRgba(const unsigned char* pixels, int width, int height, int nrComponents, vector<unsigned char>& outRgba)
+{
+	size_t texels = (size_t)width * height;
+	outRgba.resize(texels * 4);
+	bool hasAlpha = false;
+	bool gray = nrComponents < 3;
+	for (size_t i = 0; i < texels; i++)
+	{
+		const unsigned char* src = pixels + i * nrComponents;
+		unsigned char* dst = &outRgba[i * 4];
+		dst[0] = src[0];
+		dst[1] = gray ? src[0] : src[1];
+		dst[2] = gray ? src[0] : src[2];
+		dst[3] = nrComponents == 2 ? src[1] : nrComponents == 4 ? src[3] : 255;
+		hasAlpha = hasAlpha || dst[3] != 255;
+	}
+	return hasAlpha;
+}
+
+void buildMipChain(const unsigned char* pixels, int width, int height, int channels, const MipOptions& options, unsigned int threads,
+	const function<void(int level, const unsigned char* texels, int width, int height)>& onLevel)
+{
+	if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+	bool srgb = options.srgb && channels == 4;
+	bool keepCoverage = options.alphaCoverage > 0.f && channels == 4;
+	float reference = options.alphaCoverage * 255.f;
+
+	float baseCoverage = 0.f;
+	if (keepCoverage)
+	{
+		size_t histogram[256];
+		alphaHistogram(pixels, (size_t)width * height, histogram);
+		baseCoverage = coverage(histogram, (size_t)width * height, 1.f, reference);
+	}
+
+	vector<unsigned char> above, level, scaled;
+	const unsigned char* source = pixels;
+	for (int i = 1; width > 1 || height > 1; i++)
+	{
+		int outWidth = max(1, width / 2), outHeight = max(1, height / 2);
+		level.resize((size_t)outWidth * outHeight * channels);
+
+		// the plain 2x2 average doesn't need floats
+		bool integerBox = options.filter == MipFilter::Box && !srgb;
+		AxisWeights xAxis, yAxis;
+		if (!integerBox)
+		{
+			xAxis = axisWeights(options.filter, width, outWidth);
+			yAxis = axisWeights(options.filter, height, outHeight);
+		}
+		auto filterRange = [&](int firstRow, int lastRow) {
+			if (integerBox) downsampleBox(source, width, height, channels, level.data(), outWidth, firstRow, lastRow);
+			else filterRows(source, width, channels, srgb, xAxis, yAxis, level.data(), outWidth, firstRow, lastRow);
+		};
+
+		int rangeCount = (int)min<unsigned int>(threads, (unsigned int)max(1, outHeight / MIN_THREAD_ROWS));
+		if (rangeCount <= 1)
+		{
+			filterRange(0, outHeight);
+		}
+		else
+		{
+			int step = (outHeight + rangeCount - 1) / rangeCount;
+			vector<future<void>> futures;
+			for (int first = 0; first < outHeight; first += step)
+			{
+				futures.push_back(async(launch::async, filterRange, first, min(outHeight, first + step)));
+			}
+			for (future<void>& f : futures) f.get();
+		}
+
+		// the next level is filtered from the unscaled alpha, scaling compounds down the chain otherwise
+		if (keepCoverage)
+		{
+			scaled.assign(level.begin(), level.end());
+			preserveCoverage(scaled.data(), (size_t)outWidth * outHeight, baseCoverage, reference);
+			onLevel(i, scaled.data(), outWidth, outHeight);
+		}
+		else
+		{
+			onLevel(i, level.data(), outWidth, outHeight);
+		}
+
+		swap(above, level);
+		source = above.data();
+		width = outWidth;
+		height = outHeight;
+	}
+}
+
+int mipLevelCount(int width, int height)
+{
+	int levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = max(1, width / 2);
+		height = max(1, height / 2);
+		levels++;
+	}
+	return levels;
+}
@@ -0,0 +1,62 @@
+
+#include "ModelBuffer.h"
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+
+using namespace std;
+
+ModelBuffer packModel(const ObjectFileData& data, int stride)
+{
+	if (stride <= 0) throw invalid_argument("ModelBuffer::Invalid vertex stride");
+
+	ModelBuffer model;
+
+	// material ids in order of first use
+	map<string, int> materialIds;
+	vector<int> subObjectMaterials(data.subObjects.size());
+	size_t vertexFloats = 0, indexCount = 0;
+	for (size_t i = 0; i < data.subObjects.size(); i++)
+	{
+		const SubObj& subObj = data.subObjects[i];
+		auto found = materialIds.emplace(subObj.useMaterial, (int)model.materialNames.size());
+		if (found.second) model.materialNames.push_back(subObj.useMaterial);
+		subObjectMaterials[i] = found.first->second;
+
+		vertexFloats += subObj.indexedVertices.size();
+		indexCount += subObj.indices.size();
+	}
+	if (vertexFloats / stride > UINT32_MAX) throw invalid_argument("ModelBuffer::Too many vertices for 32 bit indices");
+
+	model.vertices.reserve(vertexFloats);
+	model.indices.reserve(indexCount);
+	model.subObjectRanges.resize(data.subObjects.size());
+	model.materialRanges.resize(model.materialNames.size());
+	for (int materialId = 0; materialId < (int)model.materialRanges.size(); materialId++)
+	{
+		model.materialRanges[materialId] = DrawRange{ 0, 0, materialId };
+	}
+
+	// sub objects of a material are packed back to back, in file order within the material
+	vector<size_t> order(data.subObjects.size());
+	for (size_t i = 0; i < order.size(); i++) order[i] = i;
+	stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return subObjectMaterials[a] < subObjectMaterials[b]; });
+
+	for (size_t i : order)
+	{
+		const SubObj& subObj = data.subObjects[i];
+		int materialId = subObjectMaterials[i];
+		unsigned int baseVertex = (unsigned int)(model.vertices.size() / stride);
+
+		DrawRange& materialRange = model.materialRanges[materialId];
+		if (materialRange.indexCount == 0) materialRange.firstIndex = model.indices.size();
+		materialRange.indexCount += subObj.indices.size();
+		model.subObjectRanges[i] = DrawRange{ model.indices.size(), subObj.indices.size(), materialId };
+
+		model.vertices.insert(model.vertices.end(), subObj.indexedVertices.begin(), subObj.indexedVertices.end());
+		for (unsigned int index : subObj.indices) model.indices.push_back(baseVertex + index);
+	}
+
+	return model;
+}
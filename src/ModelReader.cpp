@@ -1,98 +1,259 @@
 
 #include "ModelReader.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "NumberParser.h"
+#include "ObjKeywords.h"
+#include <algorithm>
+#include <cstdint>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <future>
+#include <thread>
 
 using namespace std;
 
-template<typename K, typename V>
-static map<V, K> reverse_map(const map<K, V>& m) {
-	map<V, K> r;
-	for (const auto& kv : m)
-		r[kv.second] = kv.first;
-	return r;
-}
-
-enum ObjKeywords
-{
-	NULL_KEYWORD,
-	COMMENT,
-	MATERIAL_FILE,
-	OBJECT,
-	GROUP,
-	VERTEX,
-	TEXTURE_MAP,
-	NORMAL,
-	USE_MATERIAL,
-	SMOOTH_SHADDING,
-	FACE_INDEX,
-	LINE_INDEX,
+// parser state of one streamed byte range
+struct ObjStreamState
+{
+	FaceType faceType = FaceType::NO_TYPE;	// face type of the current object
+	bool seenObject = false;				// an "o" or "g" line was found in this range
+	const char* firstFaceLine = nullptr;	// first face before any "o"/"g" line, reported if its type mismatches on merge
+	const char* firstLineKeyword = nullptr;	// first ignored "l" line
+};
+
+// record counts of a byte range, found by a pass over the line keywords before parsing
+struct ObjRecordCounts
+{
+	size_t vertices = 0;
+	size_t texCoords = 0;
+	size_t normals = 0;
+	vector<size_t> sectionFaces{ 0 };	// faces after each "o"/"g"/"usemtl" line, [0] before the first one
 };
 
-enum class MtlKeywords
-{
-	// MAIN KEYWORDS
-	NULL_KEYWORD,
-	COMMENT,
-	MATERIAL,
-	K_AMBIENT,
-	K_DIFFUSE,
-	K_SPECULAR,
-	N_SHININESS,
-	OPACITY,
-	TRANSPARENCY,
-	TRANSMISSION_FILTER_COLOR,
-	N_OPTICAL_DENSITY,
-	ILLUMINATION_MODEL,
-	MAP_AMBIENT,
-	MAP_DIFFUSE,
-	MAP_SPECULAR,
-	MAP_ALPHA,
-	MAP_BUMP_1,
-	MAP_BUMP_2,
-	MAP_DISPLACEMENT,
-	MAP_STENCIL_DECAL,
-	// TEXTURE KEYWORDS
-	TEXTURE_OPTION
+// per thread chunk of an obj file, sub object 0 continues the object left open by the previous chunk
+struct ObjChunk
+{
+	ObjectFileData data;
+	ObjStreamState state;
+	ObjRecordCounts counts;
 };
 
-enum class FaceType
+// stream sink collecting a chunk into ObjectFileData, buffers are reserved from the record counts
+class ObjChunkSink : public ObjStreamSink
 {
-	NO_TYPE,
-	V,
-	V_VT_VN,
-	V_VN,
-	V_VT
+public:
+	ObjChunkSink(ObjectFileData& data, const ObjRecordCounts& counts) : data(data), counts(counts)
+	{
+		data.vertices.reserve(counts.vertices);
+		data.texCoords.reserve(counts.texCoords);
+		data.normals.reserve(counts.normals);
+		data.subObjects.push_back(SubObj());
+		reserveSection();
+	}
+
+	void onMaterialFile(const string& mtlFilename) override { data.mtlFilename = mtlFilename; }
+	void onObject(string_view name) override
+	{
+		SubObj& subObj = startSection();
+		subObj.modelObjectName = name;
+		subObj.groupName.clear();
+		nextSection();
+	}
+	void onGroup(string_view name) override
+	{
+		startSection().groupName = name;
+		nextSection();
+	}
+	void onMaterial(string_view name) override
+	{
+		// faces already drawn with the previous material keep their own range
+		if (!data.subObjects.back().verticesIdx.empty()) startSection();
+		data.subObjects.back().useMaterial = name;
+		nextSection();
+	}
+	void onSmoothShading(string_view value) override { data.subObjects.back().smoothShadding = value; }
+
+	void onVertices(const Vector3* vertices, size_t count) override { data.vertices.insert(data.vertices.end(), vertices, vertices + count); }
+	void onTexCoords(const Vector2* texCoords, size_t count) override { data.texCoords.insert(data.texCoords.end(), texCoords, texCoords + count); }
+	void onNormals(const Vector3* normals, size_t count) override { data.normals.insert(data.normals.end(), normals, normals + count); }
+
+	void onFaces(const ObjFaceCorner* corners, size_t faceCount, FaceType type) override
+	{
+		SubObj& subObj = data.subObjects.back();
+		subObj.faceType = type;
+		bool hasTexCoords = type == FaceType::V_VT_VN || type == FaceType::V_VT;
+		bool hasNormals = type == FaceType::V_VT_VN || type == FaceType::V_VN;
+		if (hasTexCoords && subObj.textureMapIdx.capacity() < subObj.verticesIdx.capacity()) subObj.textureMapIdx.reserve(subObj.verticesIdx.capacity());
+		if (hasNormals && subObj.normalsIdx.capacity() < subObj.verticesIdx.capacity()) subObj.normalsIdx.reserve(subObj.verticesIdx.capacity());
+		for (size_t i = 0; i < faceCount * 3; i++)
+		{
+			subObj.verticesIdx.push_back(corners[i].v);
+			if (hasTexCoords) subObj.textureMapIdx.push_back(corners[i].vt);
+			if (hasNormals) subObj.normalsIdx.push_back(corners[i].vn);
+		}
+	}
+
+private:
+	ObjectFileData& data;
+	const ObjRecordCounts& counts;
+	size_t section = 0;
+
+	// face indices of the current section, a section that didn't split its sub object had no faces
+	void reserveSection()
+	{
+		if (section >= counts.sectionFaces.size()) return;
+		SubObj& subObj = data.subObjects.back();
+		subObj.verticesIdx.reserve(subObj.verticesIdx.size() + counts.sectionFaces[section] * 3);
+	}
+
+	void nextSection()
+	{
+		section++;
+		reserveSection();
+	}
+
+	// new sub object carrying over the state of the current one
+	SubObj& startSection()
+	{
+		SubObj next;
+		const SubObj& current = data.subObjects.back();
+		next.modelObjectName = current.modelObjectName;
+		next.groupName = current.groupName;
+		next.useMaterial = current.useMaterial;
+		next.smoothShadding = current.smoothShadding;
+		data.subObjects.push_back(move(next));
+		return data.subObjects.back();
+	}
 };
 
-// tokenize keywords
-static map< ObjKeywords, const string > objKeyMap = {
-	{	COMMENT,			"#"			},
-	{	MATERIAL_FILE,		"mtllib"	},
-	{	OBJECT,				"o"			},
-	{	GROUP,				"g"			},
-	{	VERTEX,				"v"			},
-	{	TEXTURE_MAP,		"vt"		},
-	{	NORMAL,				"vn"		},
-	{	USE_MATERIAL,		"usemtl"	},
-	{	SMOOTH_SHADDING,	"s"			},
-	{	FACE_INDEX,			"f"			},
-	{	LINE_INDEX,			"l"			},
+// fill the state a chunk's sub object couldn't know from the last sub object of the previous chunks
+// (an empty object name means no "o" was seen before it in its chunk)
+static void inheritSection(SubObj& next, const SubObj& previous)
+{
+	if (next.modelObjectName.empty())
+	{
+		next.modelObjectName = previous.modelObjectName;
+		if (next.groupName.empty()) next.groupName = previous.groupName;
+	}
+	if (next.useMaterial.empty()) next.useMaterial = previous.useMaterial;
+	if (next.smoothShadding.empty()) next.smoothShadding = previous.smoothShadding;
+}
+
+// (v, vt, vn) index triple identifying one unique vertex
+struct VertexKey
+{
+	unsigned int v;
+	unsigned int vt;
+	unsigned int vn;
+
+	bool operator==(const VertexKey& other) const
+	{
+		return v == other.v && vt == other.vt && vn == other.vn;
+	}
 };
-static map< const string, ObjKeywords> objValMap = reverse_map(objKeyMap);
-
-static map< MtlKeywords, const string > mtlKeyMap = {
-	{	MtlKeywords::COMMENT,				"#"			},
-	{	MtlKeywords::MATERIAL,				"newmtl"	},
-	{	MtlKeywords::K_AMBIENT,				"Ka"		},
-	{	MtlKeywords::K_DIFFUSE,				"Kd"		},
-	{	MtlKeywords::K_SPECULAR,			"Ks"		},
-	{	MtlKeywords::N_SHININESS,			"Ns"		},
-	{	MtlKeywords::N_OPTICAL_DENSITY,		"Ni"		},
-	{	MtlKeywords::OPACITY,				"d"			},
-	{	MtlKeywords::TRANSPARENCY,			"Tr"		},
-	{	MtlKeywords::MAP_DIFFUSE,			"map_Kd"	},
-	{	MtlKeywords::ILLUMINATION_MODEL,	"illum"		},
+
+struct VertexKeyHash
+{
+	size_t operator()(const VertexKey& key) const
+	{
+		uint64_t h = key.v * 0x9E3779B97F4A7C15ull;
+		h ^= (key.vt + 0x632BE59BD9B4E019ull) * 0xC2B2AE3D27D4EB4Full;
+		h ^= (key.vn + 0x165667B19E3779F9ull) * 0x85EBCA77C2B2AE63ull;
+		return (size_t)(h ^ (h >> 29));
+	}
 };
-static map< const string, MtlKeywords> mtlKeyVal = reverse_map(mtlKeyMap);
+
+// chunks smaller than this aren't worth a thread
+static const size_t MIN_CHUNK_BYTES = 4 * 1024 * 1024;
+
+// records buffered before a chunk sink is fed
+static const size_t CHUNK_BATCH_SIZE = 16384;
+
+// floats per indexed vertex (position, texture coordinate, normal)
+static const int INDEXED_VERTEX_STRIDE = 8;
+
+// triangles/vertices per thread below which generating attributes stays on one thread
+static const size_t MIN_ATTRIBUTE_RANGE = 65536;
+
+static const float ATTRIBUTE_PI = 3.14159265f;
+
+// moves src when that doesn't drop a larger reservation of dst
+template<typename T>
+static void appendRange(vector<T>& dst, vector<T>& src)
+{
+	if (dst.empty() && src.capacity() >= dst.capacity()) dst = move(src);
+	else dst.insert(dst.end(), src.begin(), src.end());
+}
+
+// open addressing slots per key of a hash table, power of two and at most half full
+static const size_t HASH_SLOTS_PER_KEY = 2;
+static const unsigned int EMPTY_SLOT = UINT_MAX;
+
+// first block of the per read scratch arena, later blocks grow geometrically
+static const size_t SCRATCH_INITIAL_BYTES = 1024 * 1024;
+
+// run body over [0, count) split into one contiguous range per thread, small counts stay on the calling thread
+static void parallelFor(size_t count, size_t threadCount, const function<void(size_t, size_t)>& body)
+{
+	size_t rangeCount = min(threadCount, max<size_t>(1, count / MIN_ATTRIBUTE_RANGE));
+	if (rangeCount <= 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	size_t step = (count + rangeCount - 1) / rangeCount;
+	vector<future<void>> futures;
+	for (size_t begin = 0; begin < count; begin += step)
+	{
+		futures.push_back(async(launch::async, body, begin, min(count, begin + step)));
+	}
+	for (future<void>& f : futures) f.wait();
+	for (future<void>& f : futures) f.get();
+}
+
+// calls record(keyword) with the first token of every non blank line of [begin, end)
+template<typename Record>
+static void forEachLineKeyword(const char* begin, const char* end, Record record)
+{
+	const char* cur = begin;
+	while (cur < end)
+	{
+		const char* eol = (const char*)memchr(cur, '\n', end - cur);
+		if (!eol) eol = end;
+		while (cur < eol && (*cur == ' ' || *cur == '\t')) cur++;
+		const char* first = cur;
+		while (cur < eol && *cur != ' ' && *cur != '\t' && *cur != '\r') cur++;
+		if (cur != first) record(string_view(first, cur - first));
+		cur = eol + 1;
+	}
+}
+
+// size pre-pass of a chunk, only the keywords are looked at so it runs at memory speed
+static ObjRecordCounts countObjRecords(TextCursor range)
+{
+	ObjRecordCounts counts;
+	forEachLineKeyword(range.cur, range.end, [&](string_view keyword) {
+		switch (classifyObjKeyword(keyword))
+		{
+		case VERTEX:		counts.vertices++; break;
+		case TEXTURE_MAP:	counts.texCoords++; break;
+		case NORMAL:		counts.normals++; break;
+		case FACE_INDEX:	counts.sectionFaces.back()++; break;
+		case OBJECT:
+		case GROUP:
+		case USE_MATERIAL:	counts.sectionFaces.push_back(0); break;
+		default:			break;
+		}
+		});
+	return counts;
+}
 
 
 
@@ -100,15 +261,107 @@ static map< const string, MtlKeywords> mtlKeyVal = reverse_map(mtlKeyMap);
 
 ObjectFileData ObjFileReader::read(const char* filename, bool parseMtl)
 {
-	ObjectFileData data = readObj(filename);
-	expandVertices(data);
-	cout << "Object loaded: " << data.objFilename << endl;
-	if (parseMtl) // cuz functionality of mtl loader is incomplete (default to false)
+	auto startTime = chrono::steady_clock::now();
+	ObjectFileData data;
+	lastTimings = ObjReadTimings();
+	auto timed = [](double& seconds, const function<void()>& stage) {
+		auto stageStart = chrono::steady_clock::now();
+		stage();
+		seconds += chrono::duration<double>(chrono::steady_clock::now() - stageStart).count();
+	};
+
+	unsigned int optimizeFlags = 0;
+	if (optimizeMeshes) optimizeFlags |= MESH_CACHE_VERTEX_CACHE_OPTIMIZED;
+	if (optimizeMeshes && optimizeOverdraw) optimizeFlags |= MESH_CACHE_OVERDRAW_OPTIMIZED;
+	if (generateLods) optimizeFlags |= MESH_CACHE_LODS_GENERATED;
+	if (generateSphericalUVs) optimizeFlags |= MESH_CACHE_SPHERICAL_UVS;
+
+	// warm start: unchanged sources are served from the binary mesh cache
+	// temporaries of the parsing stages come from one arena and are freed together
+	pmr::monotonic_buffer_resource scratch(SCRATCH_INITIAL_BYTES);
+
+	bool fromCache = false;
+	if (useMeshCache) timed(lastTimings.cache, [&]() { fromCache = loadMeshCache(filename, data, optimizeFlags); });
+	lastTimings.fromCache = fromCache;
+	if (!fromCache)
+	{
+		timed(lastTimings.readObj, [&]() { data = readObj(filename); });
+		timed(lastTimings.completeAttributes, [&]() { completeAttributes(data, &scratch); });
+		timed(lastTimings.expandVertices, [&]() { expandVertices(data); });
+		timed(lastTimings.indexVertices, [&]() { indexVertices(data, &scratch); });
+		scratch.release();
+		if (optimizeMeshes)
+		{
+			timed(lastTimings.optimize, [&]() {
+				for (SubObj& subObj : data.subObjects) optimizeSubObj(subObj, INDEXED_VERTEX_STRIDE, optimizeOverdraw);
+			});
+		}
+		if (generateLods)
+		{
+			timed(lastTimings.lods, [&]() {
+				for (SubObj& subObj : data.subObjects) buildLodChain(subObj, INDEXED_VERTEX_STRIDE);
+			});
+		}
+
+		if (useMeshCache)
+		{
+			try
+			{
+				timed(lastTimings.cache, [&]() { writeMeshCache(filename, data, optimizeFlags); });
+			}
+			catch (const std::exception& e)
+			{
+				cout << "Fail writing mesh cache: " << e.what() << endl;
+			}
+		}
+	}
+	chrono::duration<double> loadTime = chrono::steady_clock::now() - startTime;
+
+	if (logging)
+	{
+		ifstream sizeCheck(filename, ios::binary | ios::ate);
+		double megaBytes = (double)sizeCheck.tellg() / (1024.0 * 1024.0);
+		cout << "Object loaded: " << data.objFilename << (fromCache ? " [cache]" : "")
+			<< " (" << loadTime.count() * 1000.0 << " ms, " << megaBytes / loadTime.count() << " MB/s)" << endl;
+	}
+	if (logging && optimizeMeshes)
+	{
+		// triangle weighted over all sub objects
+		double triangles = 0.0, vertices = 0.0;
+		VertexCacheStats before, after;
+		for (const SubObj& subObj : data.subObjects)
+		{
+			double tris = (double)(subObj.indices.size() / 3);
+			double verts = (double)(subObj.indexedVertices.size() / INDEXED_VERTEX_STRIDE);
+			before.acmr += (float)(subObj.cacheStatsBefore.acmr * tris);
+			after.acmr += (float)(subObj.cacheStatsAfter.acmr * tris);
+			before.atvr += (float)(subObj.cacheStatsBefore.atvr * verts);
+			after.atvr += (float)(subObj.cacheStatsAfter.atvr * verts);
+			triangles += tris;
+			vertices += verts;
+		}
+		if (triangles > 0.0)
+		{
+			cout << "Vertex cache: ACMR " << before.acmr / triangles << " -> " << after.acmr / triangles
+				<< ", ATVR " << before.atvr / vertices << " -> " << after.atvr / vertices << endl;
+		}
+	}
+	if (logging && generateLods)
+	{
+		for (const SubObj& subObj : data.subObjects)
+		{
+			if (subObj.lods.empty()) continue;
+			cout << "LODs " << subObj.modelObjectName << ": " << subObj.indices.size() / 3;
+			for (const MeshLod& lod : subObj.lods) cout << " -> " << lod.indices.size() / 3;
+			cout << " triangles, error " << subObj.lods.back().error << endl;
+		}
+	}
+	if (parseMtl && !data.mtlFilename.empty())
 	{
 		try
 		{
-			readMtl(data);
-			cout << "Material loaded: " << data.mtlFilename << endl;
+			timed(lastTimings.readMtl, [&]() { readMtl(data, &scratch); });
+			if (logging) cout << "Material loaded: " << data.mtlFilename << endl;
 		}
 		catch (const std::exception& e)
 		{
@@ -116,195 +369,518 @@ ObjectFileData ObjFileReader::read(const char* filename, bool parseMtl)
 			cout << e.what() << endl << endl;
 		}
 	}
+	lastTimings.total = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
 	return data;
 }
 
+const ObjReadTimings& ObjFileReader::getLastTimings() const
+{
+	return lastTimings;
+}
+
+void ObjFileReader::setParseThreads(unsigned int threads)
+{
+	parseThreads = threads;
+}
+
+void ObjFileReader::setGenerateSphericalUVs(bool value)
+{
+	generateSphericalUVs = value;
+}
+
+void ObjFileReader::setUseMeshCache(bool value)
+{
+	useMeshCache = value;
+}
+
+void ObjFileReader::setOptimizeMeshes(bool value)
+{
+	optimizeMeshes = value;
+}
+
+void ObjFileReader::setOptimizeOverdraw(bool value)
+{
+	optimizeOverdraw = value;
+}
+
+void ObjFileReader::setGenerateLods(bool value)
+{
+	generateLods = value;
+}
+
+void ObjFileReader::setLogging(bool value)
+{
+	logging = value;
+}
+
 ObjectFileData ObjFileReader::readObj(const char* filename)
 {
-	// ignore line boolean
-	bool detectedLineKeyword = false;
+	// input, the whole file is mapped and tokenized in place
+	MappedFile inputFile;
+
+	if (!inputFile.open(filename)) throw invalid_argument("ObjFileReader::file doesn't exist");
 
-	// input
-	ifstream inputFile(filename);
+	// split the file at line boundaries, one chunk per thread (small files stay on the calling thread)
+	size_t threadCount = parseThreads ? parseThreads : max(1u, thread::hardware_concurrency());
+	size_t chunkCount = min(threadCount, max<size_t>(1, inputFile.size() / MIN_CHUNK_BYTES));
+	vector<TextCursor> ranges = splitLines(inputFile.begin(), inputFile.end(), chunkCount);
 
-	if (!inputFile.good()) throw invalid_argument("ObjFileReader::file doesn't exist");
+	vector<ObjChunk> chunks(ranges.size());
+	if (chunks.size() == 1)
+	{
+		chunks[0].counts = countObjRecords(ranges[0]);
+		ObjChunkSink sink(chunks[0].data, chunks[0].counts);
+		streamObjRange(filename, inputFile.begin(), inputFile.end(), ranges[0], sink, CHUNK_BATCH_SIZE, chunks[0].state);
+	}
+	else
+	{
+		vector<future<void>> futures;
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			futures.push_back(async(launch::async, [&, i]() {
+				chunks[i].counts = countObjRecords(ranges[i]);
+				ObjChunkSink sink(chunks[i].data, chunks[i].counts);
+				streamObjRange(filename, inputFile.begin(), inputFile.end(), ranges[i], sink, CHUNK_BATCH_SIZE, chunks[i].state);
+				}));
+		}
+
+		// wait for every worker before rethrowing, errors are reported in file order
+		for (future<void>& f : futures) f.wait();
+		for (future<void>& f : futures) f.get();
+	}
+
+	// merge chunks in file order, indices are global so only the sub object boundaries need stitching
 	ObjectFileData data;
 	string sFilename(filename);
 	data.objFilename = sFilename;
 
-	// intermediate data
-	char delim = ' ';
-	char faceDelim = '/';
+	// attributes are copied once into buffers of the final size, a single chunk is moved as is
+	if (chunks.size() > 1)
+	{
+		size_t vertexCount = 0, texCoordCount = 0, normalCount = 0;
+		for (const ObjChunk& chunk : chunks)
+		{
+			vertexCount += chunk.counts.vertices;
+			texCoordCount += chunk.counts.texCoords;
+			normalCount += chunk.counts.normals;
+		}
+		data.vertices.reserve(vertexCount);
+		data.texCoords.reserve(texCoordCount);
+		data.normals.reserve(normalCount);
+	}
 
+	const char* firstLineKeyword = nullptr;
+	for (ObjChunk& chunk : chunks)
+	{
+		ObjectFileData& part = chunk.data;
 
-	string line = "";
-	FaceType faceType = FaceType::NO_TYPE;
-	FaceType detectedFaceType = FaceType::NO_TYPE;
-	Vector2 tempP;
-	Vector3 tempT;
-	vector<unsigned int> tempUI;
+		if (!part.mtlFilename.empty()) data.mtlFilename = part.mtlFilename;
+		if (!firstLineKeyword) firstLineKeyword = chunk.state.firstLineKeyword;
+
+		appendRange(data.vertices, part.vertices);
+		appendRange(data.texCoords, part.texCoords);
+		appendRange(data.normals, part.normals);
+
+		// first sub object continues the object that was open at the end of the previous chunk
+		SubObj& continued = part.subObjects[0];
+		bool hasContent = !continued.verticesIdx.empty() || !continued.useMaterial.empty() || !continued.smoothShadding.empty();
+		if (hasContent)
+		{
+			if (data.subObjects.empty())
+			{
+				data.subObjects.push_back(move(continued));
+			}
+			else
+			{
+				SubObj& open = data.subObjects.back();
+				if (open.faceType != FaceType::NO_TYPE && continued.faceType != FaceType::NO_TYPE &&
+					open.faceType != continued.faceType)
+				{
+					ParseContext ctx{ filename, inputFile.begin(), inputFile.end(), chunk.state.firstFaceLine };
+					throw parseError(ctx, "ObjFileReader::Inconsistent Face Indices Type");
+				}
+
+				if (!continued.useMaterial.empty() && !open.verticesIdx.empty())
+				{
+					// usemtl right at the chunk start, same split as within a chunk (any usemtl after faces,
+					// even of the same material)
+					inheritSection(continued, open);
+					data.subObjects.push_back(move(continued));
+				}
+				else
+				{
+					if (open.faceType == FaceType::NO_TYPE) open.faceType = continued.faceType;
+					if (!continued.useMaterial.empty()) open.useMaterial = continued.useMaterial;
+					if (!continued.smoothShadding.empty()) open.smoothShadding = continued.smoothShadding;
+					appendRange(open.verticesIdx, continued.verticesIdx);
+					appendRange(open.textureMapIdx, continued.textureMapIdx);
+					appendRange(open.normalsIdx, continued.normalsIdx);
+				}
+			}
+		}
+
+		for (size_t i = 1; i < part.subObjects.size(); i++)
+		{
+			if (!data.subObjects.empty()) inheritSection(part.subObjects[i], data.subObjects.back());
+			data.subObjects.push_back(move(part.subObjects[i]));
+		}
+	}
+
+	// "o"/"g"/"usemtl" lines directly followed by another one leave sections without faces
+	data.subObjects.erase(remove_if(data.subObjects.begin(), data.subObjects.end(),
+		[](const SubObj& subObj) { return subObj.verticesIdx.empty(); }), data.subObjects.end());
+
+	if (firstLineKeyword && logging)
+	{
+		ParseContext ctx{ filename, inputFile.begin(), inputFile.end(), firstLineKeyword };
+		cout << parseError(ctx, "ObjFileReader::Warning line vertex is not supported, thus ignored").what();
+	}
+
+	return data;
+}
 
-	int lineCount = 0;
-	int objectCount = 0;
+void ObjFileReader::stream(const char* filename, ObjStreamSink& sink, size_t batchSize)
+{
+	MappedFile inputFile;
+	if (!inputFile.open(filename)) throw invalid_argument("ObjFileReader::file doesn't exist");
+
+	// walk the file in windows of whole lines, pages behind the cursor are dropped so the
+	// resident size stays around one window plus the batches
+	ObjStreamState state;
+	const char* cur = inputFile.begin();
+	while (cur < inputFile.end())
+	{
+		const char* windowEnd = cur + min<size_t>(MIN_CHUNK_BYTES, inputFile.end() - cur);
+		const char* eol = (const char*)memchr(windowEnd - 1, '\n', inputFile.end() - (windowEnd - 1));
+		windowEnd = eol ? eol + 1 : inputFile.end();
+
+		streamObjRange(filename, inputFile.begin(), inputFile.end(), TextCursor{ cur, windowEnd },
+			sink, max<size_t>(1, batchSize), state);
+		inputFile.release(cur, windowEnd);
+		cur = windowEnd;
+	}
 
-	while (getline(inputFile, line))
+	if (state.firstLineKeyword && logging)
 	{
-		stringstream inputString(line);
+		ParseContext ctx{ filename, inputFile.begin(), inputFile.end(), state.firstLineKeyword };
+		cout << parseError(ctx, "ObjFileReader::Warning line vertex is not supported, thus ignored").what();
+	}
+}
 
-		string subStr = "";		// sub string delimited with delim
-		string fsubStr = "";	// sub string delimited with faceDelim
+void ObjFileReader::streamObjRange(const char* filename, const char* fileBegin, const char* fileEnd, TextCursor range,
+	ObjStreamSink& sink, size_t batchSize, ObjStreamState& state)
+{
+	// fixed size batches, this is all the memory the parser holds on to
+	vector<Vector3> vertices, normals;
+	vector<Vector2> texCoords;
+	vector<ObjFaceCorner> corners;
+	vertices.reserve(batchSize);
+	normals.reserve(batchSize);
+	texCoords.reserve(batchSize);
+	corners.reserve(batchSize * 3);
+
+	// vertex data is always handed over before the faces that might reference it
+	auto flush = [&]() {
+		if (!vertices.empty()) sink.onVertices(vertices.data(), vertices.size());
+		if (!texCoords.empty()) sink.onTexCoords(texCoords.data(), texCoords.size());
+		if (!normals.empty()) sink.onNormals(normals.data(), normals.size());
+		if (!corners.empty()) sink.onFaces(corners.data(), corners.size() / 3, state.faceType);
+		vertices.clear();
+		texCoords.clear();
+		normals.clear();
+		corners.clear();
+	};
 
-		// first element of the line
-		getline(inputString, subStr, delim);
-		ObjKeywords key = objValMap[(const string)subStr];
+	// intermediate data
+	TextCursor inputLine;
+	ParseContext ctx{ filename, fileBegin, fileEnd, nullptr };
+
+	string_view subStr;
+	FaceType detectedFaceType = FaceType::NO_TYPE;
+	unsigned int tempUI[3];
+
+	while (nextLine(range, inputLine))
+	{
+		ctx.lineStart = inputLine.cur;
+
+		// first element of the line, blank lines are skipped
+		if (!parse1s(inputLine, subStr)) continue;
+		ObjKeywords key = classifyObjKeyword(subStr);
 
 		switch (key)
 		{
 		case NULL_KEYWORD:
-			throw invalid_argument(
-				errString("ObjFileReader::Not Supported Keyword line",
-					filename, line, lineCount));
+			throw parseError(ctx, "ObjFileReader::Not Supported Keyword line");
 			break;
 		case LINE_INDEX:
-			if (!detectedLineKeyword)
-			{
-				cout << errString("ObjFileReader::Warning line vertex is not supported, thus ignored",
-					filename, line, lineCount);
-			}
-			detectedLineKeyword = true;
+			if (!state.firstLineKeyword) state.firstLineKeyword = ctx.lineStart; // warned once by the caller
 			break;
 		case COMMENT: // do nothing
 			break;
 
 		case MATERIAL_FILE:
-			parse1s(inputString, delim, subStr);
-			data.mtlFilename = replaceBasename(data.objFilename, subStr);
-			parseEOL(inputString, delim,
-				errString("ObjFileReader::Too many paths for a single material file",
-					filename, line, lineCount));
+			parse1s(inputLine, subStr);
+			parseEOL(inputLine, ctx, "ObjFileReader::Too many paths for a single material file");
+			flush();
+			sink.onMaterialFile(replaceBasename(filename, string(subStr)));
 			break;
 
 		case OBJECT:
-			data.subObjects.push_back(SubObj());
-			parse1s(inputString, delim, subStr);
-			data.subObjects.back().modelObjectName = subStr;
-			parseEOL(inputString, delim,
-				errString("ObjFileReader::Too many names for a single object",
-					filename, line, lineCount));
-			faceType = FaceType::NO_TYPE; // reset face type for parsing new object face later on
+			parse1s(inputLine, subStr);
+			parseEOL(inputLine, ctx, "ObjFileReader::Too many names for a single object");
+			flush();
+			sink.onObject(subStr);
+			state.seenObject = true;
+			state.faceType = FaceType::NO_TYPE; // reset face type for parsing new object face later on
 			break;
 
 		case GROUP:
-			throw invalid_argument(
-				errString("ObjFileReader::Object grouping is not supported",
-					filename, line, lineCount));
+			// faces can belong to several groups, only the first name is kept
+			parse1s(inputLine, subStr);
+			flush();
+			sink.onGroup(subStr);
+			state.seenObject = true;
+			state.faceType = FaceType::NO_TYPE;
 			break;
 
 		case VERTEX:
-			tempT = parse3f(
-				inputString, delim,
-				errString("ObjFileReader::Length of vertex coordinate is not 3",
-					filename, line, lineCount));
-			data.vertices.push_back(tempT);
-			parseEOL(
-				inputString, delim,
-				errString("ObjFileReader::More than 3 points in a vertex",
-					filename, line, lineCount));
+			vertices.push_back(parse3f(inputLine, ctx, "ObjFileReader::Length of vertex coordinate is not 3"));
+			parseEOL(inputLine, ctx, "ObjFileReader::More than 3 points in a vertex");
+			if (vertices.size() == batchSize) flush();
 			break;
 
 		case TEXTURE_MAP:
-			tempP = parse2f(
-				inputString, delim,
-				errString("ObjFileReader::Length of texture coordinate is not 2",
-					filename, line, lineCount));
-			data.texCoords.push_back(tempP);
-			parseEOL(
-				inputString, delim,
-				errString("ObjFileReader::More than 2 points in texture coordinate",
-					filename, line, lineCount));
+			texCoords.push_back(parse2f(inputLine, ctx, "ObjFileReader::Length of texture coordinate is not 2"));
+			parseEOL(inputLine, ctx, "ObjFileReader::More than 2 points in texture coordinate");
+			if (texCoords.size() == batchSize) flush();
 			break;
 
 		case NORMAL:
-			tempT = parse3f(
-				inputString, delim,
-				errString("ObjFileReader::Length of normals is not 3",
-					filename, line, lineCount));
-			data.normals.push_back(tempT);
-			parseEOL(
-				inputString, delim,
-				errString("ObjFileReader::More than 3 values in a normals",
-					filename, line, lineCount));
+			normals.push_back(parse3f(inputLine, ctx, "ObjFileReader::Length of normals is not 3"));
+			parseEOL(inputLine, ctx, "ObjFileReader::More than 3 values in a normals");
+			if (normals.size() == batchSize) flush();
 			break;
 
 		case USE_MATERIAL:
-			parse1s(inputString, delim, subStr);
-			data.subObjects.back().useMaterial = subStr;
-			parseEOL(
-				inputString, delim,
-				errString("ObjFileReader::Use too many materials",
-					filename, line, lineCount));
+			parse1s(inputLine, subStr);
+			parseEOL(inputLine, ctx, "ObjFileReader::Use too many materials");
+			flush();
+			sink.onMaterial(subStr);
 			break;
 
 		case SMOOTH_SHADDING:
-			parse1s(inputString, delim, subStr);
-			data.subObjects.back().smoothShadding = subStr;
-			parseEOL(
-				inputString, delim,
-				errString("ObjFileReader::Too many arguments in smooth shadding",
-					filename, line, lineCount));
+			parse1s(inputLine, subStr);
+			parseEOL(inputLine, ctx, "ObjFileReader::Too many arguments in smooth shadding");
+			flush();
+			sink.onSmoothShading(subStr);
 			break;
 
 		case FACE_INDEX:
+		{
+			if (!state.seenObject && !state.firstFaceLine) state.firstFaceLine = ctx.lineStart;
+
 			for (int i = 0; i < 3; i++)
 			{
-				parse1s(inputString, delim, subStr);
-				stringstream subFaceStr(subStr);
-				detectedFaceType = parseSubFace(subFaceStr, faceDelim, tempUI,
-					errString("ObjFileReader::Invalid Face Indices Type",
-						filename, line, lineCount));
+				detectedFaceType = parseSubFace(inputLine, ctx, tempUI, "ObjFileReader::Invalid Face Indices Type");
 
-				if (faceType == FaceType::NO_TYPE)
+				// face type is fixed by the first face of every object
+				if (state.faceType == FaceType::NO_TYPE)
 				{
-					faceType = detectedFaceType;
+					state.faceType = detectedFaceType;
 				}
 				else
 				{
-					if (detectedFaceType != faceType)
+					if (detectedFaceType != state.faceType)
 					{
-						throw invalid_argument(
-							errString("ObjFileReader::Inconsistent Face Indices Type",
-								filename, line, lineCount));
+						throw parseError(ctx, "ObjFileReader::Inconsistent Face Indices Type");
 					}
 				}
 
-				data.subObjects.back().verticesIdx.push_back(tempUI[0]);
-				switch (faceType)
+				corners.push_back(ObjFaceCorner{ tempUI[0], tempUI[1], tempUI[2] });
+			}
+			parseEOL(inputLine, ctx, "ObjFileReader::More than 3 sets of indices, please triangulate object");
+			if (corners.size() == batchSize * 3) flush();
+			break;
+		}
+		}
+	}
+
+	flush();
+}
+
+void ObjFileReader::completeAttributes(ObjectFileData& data, pmr::memory_resource* scratch)
+{
+	size_t threadCount = parseThreads ? parseThreads : max(1u, thread::hardware_concurrency());
+
+	// position index -> index among the positions of the current sub object, reset after each one
+	pmr::vector<unsigned int> localIdx(data.vertices.size(), UINT_MAX, scratch);
+
+	// per sub object temporaries, reused so they only grow to the largest sub object
+	pmr::vector<unsigned int> positions(scratch), cornerLocal(scratch);
+	pmr::vector<float> faceX(scratch), faceY(scratch), faceZ(scratch);
+	pmr::vector<float> normalX(scratch), normalY(scratch), normalZ(scratch);
+	pmr::vector<unsigned int> firstTriangle(scratch), adjacentTriangles(scratch), cursor(scratch);
+
+	for (SubObj& subObj : data.subObjects)
+	{
+		bool hasTexCoords = subObj.faceType == FaceType::V_VT_VN || subObj.faceType == FaceType::V_VT;
+		bool hasNormals = subObj.faceType == FaceType::V_VT_VN || subObj.faceType == FaceType::V_VN;
+		if (subObj.verticesIdx.empty() || (hasTexCoords && hasNormals)) continue;
+
+		const vector<unsigned int>& vId = subObj.verticesIdx;
+		size_t cornerCount = vId.size();
+		size_t triangleCount = cornerCount / 3;
+
+		// compact the positions used by this sub object, generated attributes are per position
+		positions.clear();
+		cornerLocal.resize(cornerCount);
+		for (size_t j = 0; j < cornerCount; j++)
+		{
+			if (vId[j] == 0 || vId[j] > data.vertices.size()) throw invalid_argument("ObjFileReader::Vertex index out of range");
+			unsigned int& local = localIdx[vId[j] - 1];
+			if (local == UINT_MAX)
+			{
+				local = (unsigned int)positions.size();
+				positions.push_back(vId[j] - 1);
+			}
+			cornerLocal[j] = local;
+		}
+		for (unsigned int position : positions) localIdx[position] = UINT_MAX;
+		size_t localCount = positions.size();
+
+		if (!hasNormals)
+		{
+			// area weighted face normals, the cross product length is twice the triangle area
+			faceX.resize(triangleCount);
+			faceY.resize(triangleCount);
+			faceZ.resize(triangleCount);
+			parallelFor(triangleCount, threadCount, [&](size_t begin, size_t end) {
+				for (size_t t = begin; t < end; t++)
+				{
+					const Vector3& p0 = data.vertices[vId[t * 3] - 1];
+					const Vector3& p1 = data.vertices[vId[t * 3 + 1] - 1];
+					const Vector3& p2 = data.vertices[vId[t * 3 + 2] - 1];
+					float e1x = p1.x - p0.x, e1y = p1.y - p0.y, e1z = p1.z - p0.z;
+					float e2x = p2.x - p0.x, e2y = p2.y - p0.y, e2z = p2.z - p0.z;
+					faceX[t] = e1y * e2z - e1z * e2y;
+					faceY[t] = e1z * e2x - e1x * e2z;
+					faceZ[t] = e1x * e2y - e1y * e2x;
+				}
+				});
+
+			// "s off" keeps faces flat, otherwise every position averages its adjacent faces
+			bool flat = subObj.smoothShadding == "off" || subObj.smoothShadding == "0";
+			size_t normalCount = flat ? triangleCount : localCount;
+			pmr::vector<float>& nx = flat ? faceX : normalX;
+			pmr::vector<float>& ny = flat ? faceY : normalY;
+			pmr::vector<float>& nz = flat ? faceZ : normalZ;
+			if (!flat)
+			{
+				// position -> adjacent triangles (counting sort), so the sums are gathered without atomics
+				firstTriangle.assign(localCount + 1, 0);
+				for (size_t j = 0; j < cornerCount; j++) firstTriangle[cornerLocal[j] + 1]++;
+				for (size_t l = 0; l < localCount; l++) firstTriangle[l + 1] += firstTriangle[l];
+				adjacentTriangles.resize(cornerCount);
+				cursor.assign(firstTriangle.begin(), firstTriangle.end() - 1);
+				for (size_t j = 0; j < cornerCount; j++) adjacentTriangles[cursor[cornerLocal[j]]++] = (unsigned int)(j / 3);
+
+				normalX.resize(localCount);
+				normalY.resize(localCount);
+				normalZ.resize(localCount);
+				parallelFor(localCount, threadCount, [&](size_t begin, size_t end) {
+					for (size_t l = begin; l < end; l++)
+					{
+						float x = 0.f, y = 0.f, z = 0.f;
+						for (unsigned int k = firstTriangle[l]; k < firstTriangle[l + 1]; k++)
+						{
+							unsigned int t = adjacentTriangles[k];
+							x += faceX[t];
+							y += faceY[t];
+							z += faceZ[t];
+						}
+						normalX[l] = x;
+						normalY[l] = y;
+						normalZ[l] = z;
+					}
+					});
+			}
+
+			// branch free so it vectorizes, degenerate neighbourhoods point up
+			parallelFor(normalCount, threadCount, [&](size_t begin, size_t end) {
+				for (size_t n = begin; n < end; n++)
 				{
-				case FaceType::V_VT_VN:
-					data.subObjects.back().textureMapIdx.push_back(tempUI[1]);
-					data.subObjects.back().normalsIdx.push_back(tempUI[2]);
-					break;
-				case FaceType::V_VN:
-					data.subObjects.back().normalsIdx.push_back(tempUI[1]);
-					break;
-				case FaceType::V_VT:
-					data.subObjects.back().textureMapIdx.push_back(tempUI[1]);
-					break;
+					float lengthSq = nx[n] * nx[n] + ny[n] * ny[n] + nz[n] * nz[n];
+					bool valid = lengthSq > 0.f;
+					float inverse = valid ? 1.f / sqrtf(lengthSq) : 0.f;
+					nx[n] *= inverse;
+					ny[n] = valid ? ny[n] * inverse : 1.f;
+					nz[n] *= inverse;
 				}
+				});
+
+			size_t base = data.normals.size();
+			data.normals.resize(base + normalCount);
+			for (size_t n = 0; n < normalCount; n++) data.normals[base + n] = Vector3{ nx[n], ny[n], nz[n] };
 
+			subObj.normalsIdx.resize(cornerCount);
+			for (size_t j = 0; j < cornerCount; j++)
+			{
+				subObj.normalsIdx[j] = (unsigned int)(base + (flat ? j / 3 : cornerLocal[j]) + 1);
 			}
-			parseEOL(inputString, delim,
-				errString("ObjFileReader::More than 3 sets of indices, please triangulate object",
-					filename, line, lineCount));
-			break;
 		}
 
-		line = "";
-		lineCount++;
-	}
-	inputFile.close();
+		if (!hasTexCoords)
+		{
+			size_t base = data.texCoords.size();
+			subObj.textureMapIdx.resize(cornerCount);
+			if (!generateSphericalUVs)
+			{
+				data.texCoords.push_back(Vector2{ 0.f, 0.f });
+				fill(subObj.textureMapIdx.begin(), subObj.textureMapIdx.end(), (unsigned int)(base + 1));
+				continue;
+			}
 
-	return data;
+			// project onto a sphere around the bounding box center, same mapping as the generated planet spheres
+			Vector3 low = data.vertices[positions[0]], high = low;
+			for (unsigned int position : positions)
+			{
+				const Vector3& p = data.vertices[position];
+				low = Vector3{ min(low.x, p.x), min(low.y, p.y), min(low.z, p.z) };
+				high = Vector3{ max(high.x, p.x), max(high.y, p.y), max(high.z, p.z) };
+			}
+			Vector3 center{ (low.x + high.x) * 0.5f, (low.y + high.y) * 0.5f, (low.z + high.z) * 0.5f };
+
+			// two coordinates per position, the second one shifted by a full turn for triangles across the seam
+			data.texCoords.resize(base + localCount * 2);
+			parallelFor(localCount, threadCount, [&](size_t begin, size_t end) {
+				for (size_t l = begin; l < end; l++)
+				{
+					const Vector3& p = data.vertices[positions[l]];
+					float x = p.x - center.x, y = p.y - center.y, z = p.z - center.z;
+					float length = sqrtf(x * x + y * y + z * z);
+					float u = atan2f(-x, -z) / (2.f * ATTRIBUTE_PI);
+					if (u < 0.f) u += 1.f;
+					float v = length > 0.f ? asinf(max(-1.f, min(1.f, y / length))) / ATTRIBUTE_PI + 0.5f : 0.5f;
+					data.texCoords[base + l * 2] = Vector2{ u, v };
+					data.texCoords[base + l * 2 + 1] = Vector2{ u + 1.f, v };
+				}
+				});
+
+			parallelFor(triangleCount, threadCount, [&](size_t begin, size_t end) {
+				for (size_t t = begin; t < end; t++)
+				{
+					float u[3];
+					for (int k = 0; k < 3; k++) u[k] = data.texCoords[base + cornerLocal[t * 3 + k] * 2].x;
+					bool wraps = max(u[0], max(u[1], u[2])) - min(u[0], min(u[1], u[2])) > 0.5f;
+					for (int k = 0; k < 3; k++)
+					{
+						size_t wrapped = wraps && u[k] < 0.5f ? 1 : 0;
+						subObj.textureMapIdx[t * 3 + k] = (unsigned int)(base + cornerLocal[t * 3 + k] * 2 + wrapped + 1);
+					}
+				}
+				});
+		}
+	}
 }
 
 void ObjFileReader::expandVertices(ObjectFileData& data)
@@ -321,49 +897,133 @@ void ObjFileReader::expandVertices(ObjectFileData& data)
 		vector<unsigned int>& tId = subObjI.textureMapIdx;
 		vector<unsigned int>& nId = subObjI.normalsIdx;
 
+		// one vertex per corner, sized once
 		vector<float>& exVer = subObjI.expandedVertices;
+		exVer.resize(vId.size() * INDEXED_VERTEX_STRIDE);
+		float* out = exVer.data();
 
-		for (int j = 0; j < vId.size(); j++)
+		for (int j = 0; j < vId.size(); j++, out += INDEXED_VERTEX_STRIDE)
 		{
 			// sequentially index index of vertex and use it to index vertex
-			exVer.push_back(ver[vId[j] - 1].x);
-			exVer.push_back(ver[vId[j] - 1].y);
-			exVer.push_back(ver[vId[j] - 1].z);
+			out[0] = ver[vId[j] - 1].x;
+			out[1] = ver[vId[j] - 1].y;
+			out[2] = ver[vId[j] - 1].z;
 
 			// sequentially index index of texCoord and use it to index textureCoord
-			exVer.push_back(tex[tId[j] - 1].x);
-			exVer.push_back(tex[tId[j] - 1].y);
+			out[3] = tex[tId[j] - 1].x;
+			out[4] = tex[tId[j] - 1].y;
 
 			// sequentially index index of normals and use it to index normals
-			exVer.push_back(nor[nId[j] - 1].x);
-			exVer.push_back(nor[nId[j] - 1].y);
-			exVer.push_back(nor[nId[j] - 1].z);
+			out[5] = nor[nId[j] - 1].x;
+			out[6] = nor[nId[j] - 1].y;
+			out[7] = nor[nId[j] - 1].z;
 		}
 	}
 };
 
-void ObjFileReader::readMtl(ObjectFileData& objFd)
+void ObjFileReader::indexVertices(ObjectFileData& data, pmr::memory_resource* scratch)
 {
-	ifstream inputFile(objFd.mtlFilename.c_str());
-	if (!inputFile.good()) throw invalid_argument("ObjFileReader::mtl file not found");
+	// open addressing table of indices into uniqueKeys, kept across sub objects
+	pmr::vector<unsigned int> slots(scratch);
+	pmr::vector<VertexKey> uniqueKeys(scratch);
+	VertexKeyHash hash;
+
+	for (size_t i = 0; i < data.subObjects.size(); i++)
+	{
+		SubObj& subObjI = data.subObjects[i];
+
+		vector<Vector3>& ver = data.vertices;
+		vector<Vector2>& tex = data.texCoords;
+		vector<Vector3>& nor = data.normals;
+
+		vector<unsigned int>& vId = subObjI.verticesIdx;
+		vector<unsigned int>& tId = subObjI.textureMapIdx;
+		vector<unsigned int>& nId = subObjI.normalsIdx;
+
+		vector<float>& idxVer = subObjI.indexedVertices;
+		vector<unsigned int>& indices = subObjI.indices;
+
+		// every distinct (v, vt, vn) triple becomes one vertex, shared corners reuse its index
+		size_t slotCount = 1;
+		while (slotCount < vId.size() * HASH_SLOTS_PER_KEY) slotCount <<= 1;
+		slots.assign(slotCount, EMPTY_SLOT);
+		uniqueKeys.clear();
+		indices.resize(vId.size());
+
+		for (size_t j = 0; j < vId.size(); j++)
+		{
+			VertexKey key{ vId[j], tId[j], nId[j] };
+			size_t slot = hash(key) & (slotCount - 1);
+			while (slots[slot] != EMPTY_SLOT && !(uniqueKeys[slots[slot]] == key)) slot = (slot + 1) & (slotCount - 1);
+
+			if (slots[slot] == EMPTY_SLOT)
+			{
+				slots[slot] = (unsigned int)uniqueKeys.size();
+				uniqueKeys.push_back(key);
+			}
+			indices[j] = slots[slot];
+		}
+
+		// vertices in first use order, sized once
+		idxVer.resize(uniqueKeys.size() * INDEXED_VERTEX_STRIDE);
+		float* out = idxVer.data();
+		for (const VertexKey& key : uniqueKeys)
+		{
+			out[0] = ver[key.v - 1].x;
+			out[1] = ver[key.v - 1].y;
+			out[2] = ver[key.v - 1].z;
+
+			out[3] = tex[key.vt - 1].x;
+			out[4] = tex[key.vt - 1].y;
+
+			out[5] = nor[key.vn - 1].x;
+			out[6] = nor[key.vn - 1].y;
+			out[7] = nor[key.vn - 1].z;
+			out += INDEXED_VERTEX_STRIDE;
+		}
+	}
+}
+
+void ObjFileReader::readMtl(ObjectFileData& objFd, pmr::memory_resource* scratch)
+{
+	MappedFile inputFile;
+	if (!inputFile.open(objFd.mtlFilename.c_str())) throw invalid_argument("ObjFileReader::mtl file not found");
 
 	MaterialFileData& data = objFd.mtlFileData;
 
+	// size pre-pass, materials and texture paths are reserved up front
+	size_t materialCount = 0, textureCount = 0;
+	forEachLineKeyword(inputFile.begin(), inputFile.end(), [&](string_view keyword) {
+		MtlKeywords key = classifyMtlKeyword(keyword);
+		if (key == MtlKeywords::MATERIAL) materialCount++;
+		if (key == MtlKeywords::MAP_DIFFUSE) textureCount++;
+		});
+	data.materials.reserve(data.materials.size() + materialCount);
+	data.textureFilenames.reserve(data.textureFilenames.size() + textureCount);
+
+	TextCursor file{ inputFile.begin(), inputFile.end() };
+	TextCursor inputLine;
+	ParseContext ctx{ objFd.mtlFilename.c_str(), inputFile.begin(), inputFile.end(), nullptr };
+
+	string_view subStr;
 	Vector3 tempV3;
-	float tempF;
 
-	char delim = ' ';
-	string line = "";
-	int lineCount = 0;
-	while (getline(inputFile, line))
+	// resolved texture path -> index into textureFilenames
+	pmr::map<pmr::string, int> textureIdx(scratch);
+
+	// material fields before any "newmtl" line are an error, not a crash
+	auto material = [&]() -> SubMtl& {
+		if (data.materials.empty()) throw parseError(ctx, "ObjFileReader::material field before newmtl");
+		return data.materials.back();
+	};
+
+	while (nextLine(file, inputLine))
 	{
-		string subStr = "";
-		stringstream inputLine(line);
-		getline(inputLine, subStr, delim);
+		ctx.lineStart = inputLine.cur;
 
-		if (subStr.size())
+		if (parse1s(inputLine, subStr))
 		{
-			switch (mtlKeyVal[(const string)subStr])
+			switch (classifyMtlKeyword(subStr))
 			{
 				// not supported
 			case MtlKeywords::NULL_KEYWORD:
@@ -376,233 +1036,260 @@ void ObjFileReader::readMtl(ObjectFileData& objFd)
 			case MtlKeywords::MAP_AMBIENT:
 			case MtlKeywords::MAP_SPECULAR:
 			case MtlKeywords::MAP_ALPHA:
-				cout << errString("ObjFileReader::Warning unsupported material config, ignored line",
-					objFd.mtlFilename.c_str(), line, lineCount);
+				if (logging) cout << parseError(ctx, "ObjFileReader::Warning unsupported material config, ignored line").what();
 				break;
 				// ignored
 			case MtlKeywords::COMMENT:
 				break;
 			case MtlKeywords::MATERIAL:
-				parse1s(inputLine, delim, subStr);
+				parse1s(inputLine, subStr);
+				data.materialNames[string(subStr)] = (int)data.materials.size();
 				data.materials.push_back(SubMtl());
-				data.materialNames.emplace(subStr, data.materialNames.size() + 1);
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::too many material names",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				parseEOL(inputLine, ctx, "ObjFileReader::too many material names");
 				break;
 			case MtlKeywords::K_AMBIENT:
-				tempV3 = parse3f(inputLine, delim, subStr);
-				data.materials.back().ambientColor.x = tempV3.x;
-				data.materials.back().ambientColor.y = tempV3.y;
-				data.materials.back().ambientColor.z = tempV3.z;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::ambient color field more than 3 values",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				tempV3 = parse3f(inputLine, ctx, "ObjFileReader::ambient color field less than 3 values");
+				material().ambientColor = tempV3;
+				parseEOL(inputLine, ctx, "ObjFileReader::ambient color field more than 3 values");
 				break;
 			case MtlKeywords::K_DIFFUSE:
-				tempV3 = parse3f(inputLine, delim, subStr);
-				data.materials.back().diffuseColor.x = tempV3.x;
-				data.materials.back().diffuseColor.y = tempV3.y;
-				data.materials.back().diffuseColor.z = tempV3.z;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::diffuse color field more than 3 values",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				tempV3 = parse3f(inputLine, ctx, "ObjFileReader::diffuse color field less than 3 values");
+				material().diffuseColor = tempV3;
+				parseEOL(inputLine, ctx, "ObjFileReader::diffuse color field more than 3 values");
 				break;
 			case MtlKeywords::K_SPECULAR:
-				tempV3 = parse3f(inputLine, delim, subStr);
-				data.materials.back().specularColor.x = tempV3.x;
-				data.materials.back().specularColor.y = tempV3.y;
-				data.materials.back().specularColor.z = tempV3.z;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::specular color field more than 3 values",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				tempV3 = parse3f(inputLine, ctx, "ObjFileReader::specular color field less than 3 values");
+				material().specularColor = tempV3;
+				parseEOL(inputLine, ctx, "ObjFileReader::specular color field more than 3 values");
 				break;
 			case MtlKeywords::N_SHININESS:
-				tempF = parse1f(inputLine, delim, subStr);
-				data.materials.back().shininess = tempF;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::shiniess field more than 1 value",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				material().shininess = parse1f(inputLine, ctx, "ObjFileReader::shininess field is empty");
+				parseEOL(inputLine, ctx, "ObjFileReader::shiniess field more than 1 value");
 				break;
 			case MtlKeywords::OPACITY:
-				tempF = parse1f(inputLine, delim, subStr);
-				data.materials.back().opacity = tempF;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::opacity field more than 1 value",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				material().opacity = parse1f(inputLine, ctx, "ObjFileReader::opacity field is empty");
+				parseEOL(inputLine, ctx, "ObjFileReader::opacity field more than 1 value");
 				break;
 			case MtlKeywords::N_OPTICAL_DENSITY:
-				tempF = parse1f(inputLine, delim, subStr);
-				data.materials.back().opticalDensity = tempF;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::optical density field more than 1 value",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				material().opticalDensity = parse1f(inputLine, ctx, "ObjFileReader::optical density field is empty");
+				parseEOL(inputLine, ctx, "ObjFileReader::optical density field more than 1 value");
 				break;
 			case MtlKeywords::TRANSPARENCY:
-				tempF = parse1f(inputLine, delim, subStr);
-				data.materials.back().opacity = 1 - tempF;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::transparency field more than 1 value",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				material().opacity = 1 - parse1f(inputLine, ctx, "ObjFileReader::transparency field is empty");
+				parseEOL(inputLine, ctx, "ObjFileReader::transparency field more than 1 value");
 				break;
 			case MtlKeywords::ILLUMINATION_MODEL:
-				tempF = parse1f(inputLine, delim, subStr);
-				data.materials.back().illuminationModel = (int)tempF;
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::illumination model field more than 1 value",
-						objFd.mtlFilename.c_str(), line, lineCount));
+				material().illuminationModel = (int)parse1f(inputLine, ctx, "ObjFileReader::illumination model field is empty");
+				parseEOL(inputLine, ctx, "ObjFileReader::illumination model field more than 1 value");
 				break;
 			case MtlKeywords::MAP_DIFFUSE:
-				parse1s(inputLine, delim, subStr);
-				parseEOL(inputLine, delim,
-					errString("ObjFileReader::texture map option is not supported",
-						objFd.mtlFilename.c_str(), line, lineCount));
-				if (!data.textureFilenames[subStr])
-				{
-					int idx = data.textureFilenames.size();
-					data.textureFilenames.emplace(subStr, idx + 1);
-					data.materials.back().diffuseColorTextureIdx = idx;
-				}
-				else
-				{
-					data.materials.back().diffuseColorTextureIdx = data.textureFilenames[subStr] - 1;
-				}
+			{
+				parse1s(inputLine, subStr);
+				parseEOL(inputLine, ctx, "ObjFileReader::texture map option is not supported");
+				string textureFilename(subStr);
+				if (!filesystem::path(textureFilename).is_absolute()) textureFilename = replaceBasename(objFd.mtlFilename, textureFilename);
+				auto found = textureIdx.emplace(string_view(textureFilename), (int)data.textureFilenames.size());
+				if (found.second) data.textureFilenames.push_back(textureFilename);
+				material().diffuseColorTextureIdx = found.first->second;
 				break;
 			}
+			}
 
 		}
-
-		line = "";
-		lineCount++;
 	}
-
-	inputFile.close();
 }
 
 
 // ========== Auxilliary Functions =============
 
+// == zero-copy parser ==
+
+static inline bool isBlank(char c)
+{
+	return c == ' ' || c == '\t';
+}
+
+static inline void skipBlanks(TextCursor& tc)
+{
+	while (tc.cur < tc.end && isBlank(*tc.cur)) tc.cur++;
+}
+
+bool ObjFileReader::nextLine(TextCursor& file, TextCursor& outLine)
+{
+	if (file.cur >= file.end) return false;
+
+	const char* eol = (const char*)memchr(file.cur, '\n', file.end - file.cur);
+	if (!eol) eol = file.end;
+
+	outLine.cur = file.cur;
+	outLine.end = eol;
+	if (outLine.end > outLine.cur && outLine.end[-1] == '\r') outLine.end--; // windows line ending
+
+	file.cur = (eol == file.end) ? eol : eol + 1;
+	return true;
+}
+
 // == string parser ==
 
-bool ObjFileReader::parse1s(stringstream& ss, char delim, string& outputString)
+bool ObjFileReader::parse1s(TextCursor& tc, string_view& outStr)
 {
-	return (bool)getline(ss, outputString, delim);
+	skipBlanks(tc);
+	const char* first = tc.cur;
+	while (tc.cur < tc.end && !isBlank(*tc.cur)) tc.cur++;
+	outStr = string_view(first, tc.cur - first);
+	return tc.cur != first;
 }
 
 // == float parser ==
 
-float ObjFileReader::parse1f(stringstream& ss, char delim, string errStr)
+float ObjFileReader::parse1f(TextCursor& tc, const ParseContext& ctx, const char* errMsg)
 {
-	string out = "";
-	getline(ss, out, delim);
-	if (out.size() == 0) throw invalid_argument(errStr);
-	return stof(out.c_str());
+	skipBlanks(tc);
+
+	float out;
+	const char* next = parseFloat(tc.cur, tc.end, out);
+	if (!next || (next != tc.end && !isBlank(*next))) throw parseError(ctx, errMsg, tc.cur);
+
+	tc.cur = next;
+	return out;
 }
 
-Vector2 ObjFileReader::parse2f(stringstream& ss, char delim, string errStr)
+Vector2 ObjFileReader::parse2f(TextCursor& tc, const ParseContext& ctx, const char* errMsg)
 {
 	Vector2 p;
-	p.x = parse1f(ss, delim, errStr);
-	p.y = parse1f(ss, delim, errStr);
+	p.x = parse1f(tc, ctx, errMsg);
+	p.y = parse1f(tc, ctx, errMsg);
 	return p;
 }
 
-Vector3 ObjFileReader::parse3f(stringstream& ss, char delim, string errStr)
+Vector3 ObjFileReader::parse3f(TextCursor& tc, const ParseContext& ctx, const char* errMsg)
 {
 	Vector3 t;
-	t.x = parse1f(ss, delim, errStr);
-	t.y = parse1f(ss, delim, errStr);
-	t.z = parse1f(ss, delim, errStr);
+	t.x = parse1f(tc, ctx, errMsg);
+	t.y = parse1f(tc, ctx, errMsg);
+	t.z = parse1f(tc, ctx, errMsg);
 	return t;
 }
 
 // == int parser ==
 
-bool ObjFileReader::parse1ui(stringstream& ss, char delim, unsigned int& outInt, string errStr)
+bool ObjFileReader::parse1ui(TextCursor& tc, unsigned int& outInt)
 {
-	string out = "";
-	getline(ss, out, delim);
-	if (out.size() == 0)
-	{
-		outInt = 0u;
-		return false;
-	}
-	else
-	{
-		outInt = (unsigned int)stoi(out.c_str());
-		return true;
-	}
+	const char* next = parseUInt(tc.cur, tc.end, outInt);
+	if (!next) return false;
+	tc.cur = next;
+	return true;
 }
 
 // == special parser ==
 
-bool ObjFileReader::checkEOL(stringstream& ss, char delim)
+bool ObjFileReader::checkEOL(TextCursor& tc)
 {
-	string str = "";
-	streampos save = ss.tellg();
-	bool isEOL = !(bool)getline(ss, str, delim);
-	ss.seekg(save);
-	return isEOL;
+	skipBlanks(tc);
+	return tc.cur == tc.end;
 }
 
-//bool ObjFileReader::parseIfMatch(stringstream& ss, char delim, string compared)
-//{
-//	string str = "";
-//	streampos save = ss.tellg();
-//	getline(ss, str, delim);
-//	if (!str.compare(compared))
-//	{
-//		ss.seekg(save);
-//		return false;
-//	}
-//	return true;
-//}
-
-void ObjFileReader::parseEOL(stringstream& ss, char delim, string errStr)
+void ObjFileReader::parseEOL(TextCursor& tc, const ParseContext& ctx, const char* errMsg)
 {
-	if (!checkEOL(ss, delim)) throw invalid_argument(errStr);
+	if (!checkEOL(tc)) throw parseError(ctx, errMsg, tc.cur);
 }
 
-FaceType ObjFileReader::parseSubFace(stringstream& ss, char delim, vector<unsigned int>& outVec, string errStr)
+FaceType ObjFileReader::parseSubFace(TextCursor& tc, const ParseContext& ctx, unsigned int outIdx[3], const char* errMsg)
 {
+	// single "v", "v/vt", "v//vn" or "v/vt/vn" token
+	string_view token;
+	skipBlanks(tc);
+	const char* tokenStart = tc.cur;
+	if (!parse1s(tc, token)) throw parseError(ctx, errMsg, tokenStart);
+	TextCursor sub{ token.data(), token.data() + token.size() };
+
+	outIdx[0] = outIdx[1] = outIdx[2] = 0u;
 	FaceType newType = FaceType::V;
-	outVec.clear();
 
 	// parse V
-	unsigned int id = 0u;
-	parse1ui(ss, delim, id, errStr);
-	outVec.push_back(id);
-	if (checkEOL(ss, delim)) return newType; // if ended then it contains only V
+	if (!parse1ui(sub, outIdx[0])) throw parseError(ctx, errMsg, tokenStart);
+	if (sub.cur == sub.end) return newType; // if ended then it contains only V
+	if (*sub.cur++ != '/') throw parseError(ctx, errMsg, tokenStart);
 
 	// parse VT or Nothing
-	if (parse1ui(ss, delim, id, errStr))
+	if (parse1ui(sub, outIdx[1]))
 	{
-		outVec.push_back(id);
 		newType = FaceType::V_VT;
-		if (checkEOL(ss, delim)) return newType;
+		if (sub.cur == sub.end) return newType;
 	}
+	if (sub.cur == sub.end || *sub.cur++ != '/') throw parseError(ctx, errMsg, tokenStart);
+
+	// parse VN
+	if (!parse1ui(sub, outIdx[2]) || sub.cur != sub.end) throw parseError(ctx, errMsg, tokenStart);
+	return (newType == FaceType::V_VT) ? FaceType::V_VT_VN : FaceType::V_VN;
+}
 
-	// parse VN or Nothing
-	if (parse1ui(ss, delim, id, errStr))
+vector<TextCursor> ObjFileReader::splitLines(const char* begin, const char* end, size_t chunkCount)
+{
+	vector<TextCursor> ranges;
+	const char* cur = begin;
+	for (size_t i = 1; i < chunkCount && cur < end; i++)
 	{
-		outVec.push_back(id);
-		if (newType == FaceType::V) newType = FaceType::V_VN;
-		else if (newType == FaceType::V_VT) newType = FaceType::V_VT_VN;
+		// move the ideal split point forward to the start of the next line
+		const char* split = begin + (end - begin) * i / chunkCount;
+		if (split < cur) continue;
+		const char* eol = (const char*)memchr(split, '\n', end - split);
+		if (!eol) break;
+		ranges.push_back(TextCursor{ cur, eol + 1 });
+		cur = eol + 1;
 	}
-	parseEOL(ss, delim, errStr);
-
-	return newType;
+	ranges.push_back(TextCursor{ cur, end });
+	return ranges;
 }
 
 // general methods
 
-string ObjFileReader::errString(string msg, const char* filename, string line, int lineCount)
+ObjParseError ObjFileReader::parseError(const ParseContext& ctx, const char* msg, const char* position)
+{
+	// line number is recovered from the byte position, only paid when a check fails
+	if (!position) position = ctx.lineStart;
+	size_t lineCount = (size_t)count(ctx.fileBegin, ctx.lineStart, '\n');
+	TextCursor file{ ctx.lineStart, ctx.fileEnd };
+	TextCursor line{ ctx.lineStart, ctx.lineStart };
+	nextLine(file, line);
+	return ObjParseError(msg, ctx.filename, string(ctx.lineStart, line.end), lineCount, (size_t)(position - ctx.fileBegin));
+}
+
+string ObjFileReader::errString(string msg, const char* filename, string line, size_t lineCount, size_t byteOffset)
 {
 	stringstream erss;
-	erss << msg << ": " << line << "\nFile: " << filename << "\nLine: " << lineCount << "\n";
+	erss << msg << ": " << line << "\nFile: " << filename << "\nLine: " << lineCount << "\nOffset: " << byteOffset << "\n";
 	return erss.str();
 }
 
+// == parse error ==
+
+ObjParseError::ObjParseError(const string& msg, const string& filename, const string& lineText, size_t line, size_t byteOffset)
+	: invalid_argument(ObjFileReader::errString(msg, filename.c_str(), lineText, line, byteOffset)),
+	filename(filename), lineText(lineText), line(line), byteOffset(byteOffset)
+{
+}
+
+const string& ObjParseError::getFilename() const
+{
+	return filename;
+}
+
+const string& ObjParseError::getLineText() const
+{
+	return lineText;
+}
+
+size_t ObjParseError::getLine() const
+{
+	return line;
+}
+
+size_t ObjParseError::getByteOffset() const
+{
+	return byteOffset;
+}
+
 string ObjFileReader::replaceBasename(string filename, string basename)
 {
 	string filenameBase = filename.substr((filename.find_last_of("/\\") + 1));
@@ -613,56 +1300,41 @@ string ObjFileReader::replaceBasename(string filename, string basename)
 
 // ============== load custom csv vertices and indices ====================
 
-vector<float> readVerticesCSV(const char* filename)
+// values separated by commas and/or line breaks, a missing file reads as empty (like before)
+template<typename T, typename Parse>
+static vector<T> readCSV(const char* filename, Parse parse, const char* errMsg)
 {
-	ifstream inputFile;
-	inputFile.open(filename);
-
-	string line = "";
-	vector<float> vertices;
-	while (getline(inputFile, line))
+	vector<T> values;
+	MappedFile inputFile;
+	if (!inputFile.open(filename)) return values;
+
+	const char* cur = inputFile.begin();
+	const char* end = inputFile.end();
+	values.reserve(inputFile.size() / 4);
+	while (cur < end)
 	{
-		stringstream inputString(line);
-
-		string tempString = "";
-		while (getline(inputString, tempString, ','))
-		{
-			float value = stof(tempString.c_str());
-			vertices.push_back(value);
-			tempString = "";
-		}
-
-		line = "";
-
+		// blanks and empty lines between values
+		while (cur < end && (isBlank(*cur) || *cur == '\r' || *cur == '\n')) cur++;
+		if (cur == end) break;
+
+		T value;
+		cur = parse(cur, end, value);
+		if (!cur) throw invalid_argument(errMsg);
+		values.push_back(value);
+
+		while (cur < end && (isBlank(*cur) || *cur == '\r')) cur++;
+		if (cur < end && *cur != ',' && *cur != '\n') throw invalid_argument(errMsg);
+		if (cur < end) cur++;
 	}
+	return values;
+}
 
-	inputFile.close();
-	return vertices;
+vector<float> readVerticesCSV(const char* filename)
+{
+	return readCSV<float>(filename, parseFloat, "readVerticesCSV::Invalid value");
 }
 
 vector<unsigned int> readIndicesCSV(const char* filename)
 {
-	ifstream inputFile;
-	inputFile.open(filename);
-
-	string line = "";
-	vector<unsigned int> indices;
-	while (getline(inputFile, line))
-	{
-		stringstream inputString(line);
-
-		string tempString = "";
-		while (getline(inputString, tempString, ','))
-		{
-			unsigned int value = stoi(tempString.c_str());
-			indices.push_back(value);
-			tempString = "";
-		}
-
-		line = "";
-
-	}
-
-	inputFile.close();
-	return indices;
-}
\ No newline at end of file
+	return readCSV<unsigned int>(filename, parseUInt, "readIndicesCSV::Invalid value");
+}
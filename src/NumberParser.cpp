@@ -0,0 +1,205 @@
+
+#include "NumberParser.h"
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define NUMBER_PARSER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+static const uint64_t POW10_INT[20] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+	10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+	1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+// powers of ten that are exact in a double (5^22 < 2^53)
+static const double POW10_DOUBLE[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const size_t MAX_FAST_FRACTION_DIGITS = 22;
+static const uint64_t MAX_FAST_MANTISSA = 1ull << 53;
+
+// double mantissa bits below float precision when the double sits exactly between two floats
+static const uint64_t FLOAT_MIDPOINT_BITS = 1ull << 28;
+static const uint64_t FLOAT_DROPPED_BITS_MASK = (1ull << 29) - 1;
+
+static inline unsigned int lowestBit(unsigned int mask)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return index;
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+// 8 ascii digits (first digit in the lowest byte) to their value
+static inline uint64_t convert8Digits(const char* digits)
+{
+	uint64_t chunk;
+	memcpy(&chunk, digits, 8);
+	chunk = ((chunk & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+	chunk = ((chunk & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+	return ((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32;
+}
+
+// value of a run of at most 19 digits
+static inline uint64_t convertDigits(const char* digits, size_t count)
+{
+	uint64_t value = 0;
+	for (; count >= 8; count -= 8, digits += 8) value = value * 100000000ull + convert8Digits(digits);
+	for (; count > 0; count--, digits++) value = value * 10 + (uint64_t)(*digits - '0');
+	return value;
+}
+
+size_t countDigits(const char* cur, const char* end)
+{
+	const char* start = cur;
+#ifdef NUMBER_PARSER_SSE2
+	// byte - '0' < 10 unsigned, done as a signed compare with the range moved to the bottom
+	const __m128i bias = _mm_set1_epi8((char)(128 - '0'));
+	const __m128i limit = _mm_set1_epi8((char)(-128 + 10));
+	while (end - cur >= 16)
+	{
+		__m128i bytes = _mm_loadu_si128((const __m128i*)cur);
+		__m128i isDigit = _mm_cmplt_epi8(_mm_add_epi8(bytes, bias), limit);
+		unsigned int notDigit = ~(unsigned int)_mm_movemask_epi8(isDigit) & 0xFFFFu;
+		if (notDigit) return (size_t)(cur - start) + lowestBit(notDigit);
+		cur += 16;
+	}
+#endif
+	while (cur < end && (unsigned char)(*cur - '0') < 10) cur++;
+	return (size_t)(cur - start);
+}
+
+const char* parseFloat(const char* cur, const char* end, float& out)
+{
+	const char* p = cur;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	size_t intDigits = countDigits(p, end);
+	const char* fraction = p + intDigits;
+	size_t fractionDigits = 0;
+	bool dot = fraction < end && *fraction == '.';
+	if (dot) fractionDigits = countDigits(fraction + 1, end);
+	const char* stop = dot ? fraction + 1 + fractionDigits : fraction;
+
+	bool exponent = stop < end && (*stop == 'e' || *stop == 'E');
+	size_t digits = intDigits + fractionDigits;
+	if (!exponent && digits > 0 && digits <= 19 && fractionDigits <= MAX_FAST_FRACTION_DIGITS)
+	{
+		uint64_t mantissa = convertDigits(p, intDigits) * POW10_INT[fractionDigits] + convertDigits(fraction + 1, fractionDigits);
+		if (mantissa <= MAX_FAST_MANTISSA)
+		{
+			// both operands are exact, so the quotient is the correctly rounded double. rounding that to
+			// float again only differs from strtof when it landed exactly on a float midpoint
+			double quotient = (double)mantissa / POW10_DOUBLE[fractionDigits];
+			uint64_t bits;
+			memcpy(&bits, &quotient, sizeof(bits));
+			if ((bits & FLOAT_DROPPED_BITS_MASK) != FLOAT_MIDPOINT_BITS)
+			{
+				float value = (float)quotient;
+				out = negative ? -value : value;
+				return stop;
+			}
+		}
+	}
+
+	// from_chars doesn't accept an explicit plus sign
+	const char* first = (cur < end && *cur == '+') ? cur + 1 : cur;
+	if (first < end && *first == '-' && first != cur) return nullptr;
+	from_chars_result res = from_chars(first, end, out);
+	if (res.ec != errc()) return nullptr;
+	return res.ptr;
+}
+
+const char* parseUInt(const char* cur, const char* end, unsigned int& out)
+{
+	size_t digits = countDigits(cur, end);
+	if (digits == 0) return nullptr;
+	if (digits <= 9)
+	{
+		out = (unsigned int)convertDigits(cur, digits);
+		return cur + digits;
+	}
+
+	// long runs may overflow
+	from_chars_result res = from_chars(cur, end, out);
+	if (res.ec != errc()) return nullptr;
+	return res.ptr;
+}
+
+NumberParserBenchmark benchmarkNumberParser(size_t valueCount)
+{
+	// "v" style coordinates: mostly fixed 6 decimals, some long mantissas and exponents
+	mt19937 rng(7);
+	uniform_real_distribution<float> coordinate(-100.f, 100.f);
+	string text;
+	vector<size_t> starts;
+	char buffer[64];
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		float value = coordinate(rng);
+		int length;
+		if (i % 16 == 0) length = snprintf(buffer, sizeof(buffer), "%.9e", value);
+		else if (i % 16 == 1) length = snprintf(buffer, sizeof(buffer), "%.12f", value);
+		else length = snprintf(buffer, sizeof(buffer), "%.6f", value);
+		starts.push_back(text.size());
+		text.append(buffer, length);
+		text.push_back(' ');
+	}
+
+	NumberParserBenchmark result;
+	result.values = valueCount;
+	const char* begin = text.data();
+	const char* end = begin + text.size();
+	double megaBytes = (double)text.size() / (1024.0 * 1024.0);
+
+	auto timeParse = [&](bool fast) -> double {
+		auto startTime = chrono::steady_clock::now();
+		float sum = 0.f;
+		for (const char* cur = begin; cur < end; cur++)
+		{
+			float value = 0.f;
+			const char* next = fast ? parseFloat(cur, end, value) : from_chars(cur, end, value).ptr;
+			if (!next) break;
+			sum += value;
+			cur = next;
+		}
+		chrono::duration<double> time = chrono::steady_clock::now() - startTime;
+		if (sum == 1.f) printf(" "); // keeps the loop from being optimized away
+		return megaBytes / time.count();
+	};
+	result.fromCharsMBps = timeParse(false);
+	result.fastMBps = timeParse(true);
+
+	for (size_t i = 0; i < valueCount; i++)
+	{
+		float value, expected;
+		parseFloat(begin + starts[i], end, value);
+		expected = strtof(begin + starts[i], nullptr);
+		if (memcmp(&value, &expected, sizeof(float)) != 0) result.mismatches++;
+	}
+	return result;
+}
@@ -0,0 +1,855 @@
+
+#include "ObjBenchmark.h"
+#include "ObjKeywords.h"
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// every operator new of the program is counted, the array and nothrow forms forward to it
+static atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t size)
+{
+	allocationCount.fetch_add(1, memory_order_relaxed);
+	if (void* p = malloc(size ? size : 1)) return p;
+	throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+static const size_t WRITE_BLOCK_SIZE = 1 << 20;
+static const float GRID_EXTENT = 100.f;		// the grid spans [-GRID_EXTENT, GRID_EXTENT] on x and z
+static const float GRID_FREQUENCY = 0.05f;
+static const float GRID_AMPLITUDE = 10.f;
+
+// block buffered text file that counts what it wrote
+class AssetWriter
+{
+public:
+	AssetWriter(const string& filename) : file(filename, ios::binary)
+	{
+		if (!file) throw invalid_argument("ObjBenchmark::can't create " + filename);
+		buffer.reserve(WRITE_BLOCK_SIZE + 256);
+	}
+
+	~AssetWriter()
+	{
+		flush();
+	}
+
+	string& line()
+	{
+		lines++;
+		return buffer;
+	}
+
+	// after every line
+	void endLine()
+	{
+		buffer += '\n';
+		if (buffer.size() >= WRITE_BLOCK_SIZE) flush();
+	}
+
+	void flush()
+	{
+		file.write(buffer.data(), buffer.size());
+		bytes += buffer.size();
+		buffer.clear();
+	}
+
+	size_t bytes = 0;
+	size_t lines = 0;
+
+private:
+	ofstream file;
+	string buffer;
+};
+
+static void appendUInt(string& out, size_t value)
+{
+	char digits[24];
+	to_chars_result res = to_chars(digits, digits + sizeof(digits), value);
+	out.append(digits, res.ptr);
+}
+
+// %.6f without the printf overhead
+static void appendFixed6(string& out, float value)
+{
+	long long micro = llround((double)value * 1e6);
+	if (micro < 0)
+	{
+		out += '-';
+		micro = -micro;
+	}
+	appendUInt(out, (size_t)(micro / 1000000));
+	out += '.';
+	char fraction[7];
+	long long rest = micro % 1000000;
+	for (int i = 5; i >= 0; i--, rest /= 10) fraction[i] = (char)('0' + rest % 10);
+	out.append(fraction, 6);
+}
+
+static void appendCorner(string& out, size_t index, FaceType faceType)
+{
+	appendUInt(out, index);
+	switch (faceType)
+	{
+	case FaceType::V_VT: out += '/'; appendUInt(out, index); break;
+	case FaceType::V_VN: out += "//"; appendUInt(out, index); break;
+	case FaceType::V_VT_VN: out += '/'; appendUInt(out, index); out += '/'; appendUInt(out, index); break;
+	default: break;
+	}
+}
+
+FaceType faceTypeFromName(const string& name)
+{
+	if (name == "v") return FaceType::V;
+	if (name == "vt") return FaceType::V_VT;
+	if (name == "vn") return FaceType::V_VN;
+	if (name == "vtvn") return FaceType::V_VT_VN;
+	return FaceType::NO_TYPE;
+}
+
+const char* faceTypeName(FaceType faceType)
+{
+	switch (faceType)
+	{
+	case FaceType::V: return "v";
+	case FaceType::V_VT: return "vt";
+	case FaceType::V_VN: return "vn";
+	case FaceType::V_VT_VN: return "vtvn";
+	default: return "none";
+	}
+}
+
+SyntheticObjAsset generateSyntheticObj(const ObjBenchmarkConfig& config)
+{
+	if (faceTypeName(config.faceType) == string("none")) throw invalid_argument("ObjBenchmark::invalid face type");
+	bool hasTexCoords = config.faceType == FaceType::V_VT || config.faceType == FaceType::V_VT_VN;
+	bool hasNormals = config.faceType == FaceType::V_VN || config.faceType == FaceType::V_VT_VN;
+	int materialCount = max(config.materialCount, 1);
+
+	// grid size from the line lengths written below (7 digit indices)
+	double indexBytes = hasTexCoords && hasNormals ? 23.0 : hasTexCoords || hasNormals ? 16.0 : 8.0;
+	double bytesPerVertex = 35.0 + (hasTexCoords ? 21.0 : 0.0) + (hasNormals ? 33.0 : 0.0) + 2.0 * (2.0 + 3.0 * indexBytes);
+	size_t gridSize = max((size_t)sqrt(config.megaBytes * 1024.0 * 1024.0 / bytesPerVertex), (size_t)2);
+	size_t cellRows = gridSize - 1;
+	size_t objectCount = min((size_t)max(config.objectCount, 1), cellRows);
+
+	SyntheticObjAsset asset;
+	ostringstream basename;
+	basename << "synthetic_" << faceTypeName(config.faceType) << "_" << config.megaBytes << "mb";
+	asset.objFilename = (filesystem::path(config.directory) / (basename.str() + ".obj")).generic_string();
+	asset.mtlFilename = (filesystem::path(config.directory) / (basename.str() + ".mtl")).generic_string();
+
+	{
+		AssetWriter mtl(asset.mtlFilename);
+		for (int i = 0; i < materialCount; i++)
+		{
+			float shade = (float)(i + 1) / (float)materialCount;
+			string& name = mtl.line();
+			name += "newmtl material"; appendUInt(name, i); mtl.endLine();
+			mtl.line() += "Ns 96.078431"; mtl.endLine();
+			mtl.line() += "Ka 1.000000 1.000000 1.000000"; mtl.endLine();
+			string& kd = mtl.line();
+			kd += "Kd "; appendFixed6(kd, shade); kd += ' '; appendFixed6(kd, 1.f - shade); kd += " 0.500000"; mtl.endLine();
+			mtl.line() += "Ks 0.500000 0.500000 0.500000"; mtl.endLine();
+			mtl.line() += "d 1.000000"; mtl.endLine();
+			mtl.line() += "illum 2"; mtl.endLine();
+			string& map = mtl.line();
+			map += "map_Kd textures/material"; appendUInt(map, i); map += ".png"; mtl.endLine();
+			mtl.line(); mtl.endLine();
+		}
+		mtl.flush();
+		asset.mtlBytes = mtl.bytes;
+		asset.mtlLines = mtl.lines;
+	}
+
+	AssetWriter obj(asset.objFilename);
+	obj.line() += "# synthetic obj benchmark asset"; obj.endLine();
+	string& mtllib = obj.line();
+	mtllib += "mtllib "; mtllib += basename.str() + ".mtl"; obj.endLine();
+
+	// displaced grid, one vertex per grid point shared by all attributes
+	float step = 2.f * GRID_EXTENT / (float)(gridSize - 1);
+	for (size_t row = 0; row < gridSize; row++)
+	{
+		for (size_t column = 0; column < gridSize; column++)
+		{
+			float x = -GRID_EXTENT + step * column, z = -GRID_EXTENT + step * row;
+			float y = GRID_AMPLITUDE * sinf(x * GRID_FREQUENCY) * cosf(z * GRID_FREQUENCY);
+
+			string& v = obj.line();
+			v += "v "; appendFixed6(v, x); v += ' '; appendFixed6(v, y); v += ' '; appendFixed6(v, z); obj.endLine();
+			if (hasTexCoords)
+			{
+				string& vt = obj.line();
+				vt += "vt "; appendFixed6(vt, (float)column / (gridSize - 1)); vt += ' '; appendFixed6(vt, (float)row / (gridSize - 1)); obj.endLine();
+			}
+			if (hasNormals)
+			{
+				float dx = GRID_AMPLITUDE * GRID_FREQUENCY * cosf(x * GRID_FREQUENCY) * cosf(z * GRID_FREQUENCY);
+				float dz = -GRID_AMPLITUDE * GRID_FREQUENCY * sinf(x * GRID_FREQUENCY) * sinf(z * GRID_FREQUENCY);
+				float length = sqrtf(dx * dx + 1.f + dz * dz);
+				string& vn = obj.line();
+				vn += "vn "; appendFixed6(vn, -dx / length); vn += ' '; appendFixed6(vn, 1.f / length); vn += ' '; appendFixed6(vn, -dz / length); obj.endLine();
+			}
+		}
+	}
+	asset.vertices = gridSize * gridSize;
+
+	// bands of rows, one object and material each
+	for (size_t object = 0; object < objectCount; object++)
+	{
+		string& o = obj.line();
+		o += "o object"; appendUInt(o, object); obj.endLine();
+		string& usemtl = obj.line();
+		usemtl += "usemtl material"; appendUInt(usemtl, object % materialCount); obj.endLine();
+
+		for (size_t row = object * cellRows / objectCount; row < (object + 1) * cellRows / objectCount; row++)
+		{
+			for (size_t column = 0; column < gridSize - 1; column++)
+			{
+				size_t corner = row * gridSize + column + 1; // 1 based
+				size_t quad[4] = { corner, corner + 1, corner + gridSize + 1, corner + gridSize };
+				for (int triangle = 0; triangle < 2; triangle++)
+				{
+					string& f = obj.line();
+					f += "f ";
+					appendCorner(f, quad[0], config.faceType); f += ' ';
+					appendCorner(f, quad[triangle + 1], config.faceType); f += ' ';
+					appendCorner(f, quad[triangle + 2], config.faceType);
+					obj.endLine();
+				}
+				asset.faces += 2;
+			}
+		}
+	}
+	obj.flush();
+	asset.objBytes = obj.bytes;
+	asset.objLines = obj.lines;
+	return asset;
+}
+
+static ObjStageThroughput throughput(double seconds, size_t bytes, size_t lines)
+{
+	ObjStageThroughput stage;
+	stage.seconds = seconds;
+	if (seconds > 0.0)
+	{
+		stage.megaBytesPerSecond = (double)bytes / (1024.0 * 1024.0) / seconds;
+		stage.linesPerSecond = (double)lines / seconds;
+	}
+	return stage;
+}
+
+ObjBenchmarkResult benchmarkObjReader(const ObjBenchmarkConfig& config)
+{
+	ObjBenchmarkResult result;
+	result.config = config;
+
+	auto startTime = chrono::steady_clock::now();
+	result.asset = generateSyntheticObj(config);
+	result.generateSeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	ObjFileReader reader;
+	reader.setUseMeshCache(false);
+	reader.setOptimizeMeshes(false);
+	reader.setGenerateLods(false);
+	reader.setLogging(false);
+	reader.setParseThreads(config.threads);
+
+	for (int run = 0; run < max(config.runs, 1); run++)
+	{
+		size_t allocationsBefore = heapAllocationCount();
+		reader.read(result.asset.objFilename.c_str());
+		result.allocations = heapAllocationCount() - allocationsBefore;
+		const ObjReadTimings& timings = reader.getLastTimings();
+		if (run == 0)
+		{
+			result.best = timings;
+			continue;
+		}
+		ObjReadTimings& best = result.best;
+		best.readObj = min(best.readObj, timings.readObj);
+		best.completeAttributes = min(best.completeAttributes, timings.completeAttributes);
+		best.expandVertices = min(best.expandVertices, timings.expandVertices);
+		best.indexVertices = min(best.indexVertices, timings.indexVertices);
+		best.readMtl = min(best.readMtl, timings.readMtl);
+		best.total = min(best.total, timings.total);
+	}
+
+	const SyntheticObjAsset& asset = result.asset;
+	result.readObj = throughput(result.best.readObj, asset.objBytes, asset.objLines);
+	result.expandVertices = throughput(result.best.expandVertices, asset.objBytes, asset.objLines);
+	result.readMtl = throughput(result.best.readMtl, asset.mtlBytes, asset.mtlLines);
+	result.total = throughput(result.best.total, asset.objBytes + asset.mtlBytes, asset.objLines + asset.mtlLines);
+	result.peakResidentBytes = peakResidentBytes();
+
+	if (!config.keepAssets)
+	{
+		error_code error;
+		filesystem::remove(asset.objFilename, error);
+		filesystem::remove(asset.mtlFilename, error);
+	}
+	return result;
+}
+
+ObjAllocationCheck checkParseAllocations(const ObjBenchmarkConfig& config)
+{
+	ObjBenchmarkConfig largeConfig = config;
+	largeConfig.megaBytes = config.megaBytes * 4.0;
+	SyntheticObjAsset small = generateSyntheticObj(config);
+	SyntheticObjAsset large = generateSyntheticObj(largeConfig);
+
+	ObjFileReader reader;
+	reader.setUseMeshCache(false);
+	reader.setOptimizeMeshes(false);
+	reader.setGenerateLods(false);
+	reader.setLogging(false);
+	reader.setParseThreads(1);	// the chunk count doesn't depend on the file size then
+
+	ObjStreamSink ignore;
+	auto allocations = [&](const SyntheticObjAsset& asset, bool stream) {
+		size_t allocationsBefore = heapAllocationCount();
+		if (stream) reader.stream(asset.objFilename.c_str(), ignore);
+		else reader.read(asset.objFilename.c_str());
+		return heapAllocationCount() - allocationsBefore;
+	};
+
+	ObjAllocationCheck check;
+	check.smallLines = small.objLines + small.mtlLines;
+	check.largeLines = large.objLines + large.mtlLines;
+	check.streamSmall = allocations(small, true);
+	check.streamLarge = allocations(large, true);
+	check.readSmall = allocations(small, false);
+	check.readLarge = allocations(large, false);
+
+	size_t addedLines = check.largeLines - check.smallLines;
+	auto grows = [&](size_t smallCount, size_t largeCount) { return largeCount > smallCount && (largeCount - smallCount) * 1000 >= addedLines; };
+	check.passed = !grows(check.streamSmall, check.streamLarge) && !grows(check.readSmall, check.readLarge);
+
+	if (!config.keepAssets)
+	{
+		error_code error;
+		for (const SyntheticObjAsset* asset : { &small, &large })
+		{
+			filesystem::remove(asset->objFilename, error);
+			filesystem::remove(asset->mtlFilename, error);
+		}
+	}
+	return check;
+}
+
+
+// ========== legacy parser =============
+// readObj as it was before the memory mapped parser: a stringstream per line and per face corner,
+// numbers through stof/stoi and the error messages built for every record. kept as the baseline of
+// compareObjParsers only
+
+enum LegacyObjKeyword
+{
+	LEGACY_NULL_KEYWORD,
+	LEGACY_COMMENT,
+	LEGACY_MATERIAL_FILE,
+	LEGACY_OBJECT,
+	LEGACY_GROUP,
+	LEGACY_VERTEX,
+	LEGACY_TEXTURE_MAP,
+	LEGACY_NORMAL,
+	LEGACY_USE_MATERIAL,
+	LEGACY_SMOOTH_SHADDING,
+	LEGACY_FACE_INDEX,
+	LEGACY_LINE_INDEX,
+};
+
+static bool legacyParse1s(stringstream& ss, char delim, string& outputString)
+{
+	return (bool)getline(ss, outputString, delim);
+}
+
+static float legacyParse1f(stringstream& ss, char delim, string errStr)
+{
+	string out = "";
+	getline(ss, out, delim);
+	if (out.size() == 0) throw invalid_argument(errStr);
+	return stof(out.c_str());
+}
+
+static Vector2 legacyParse2f(stringstream& ss, char delim, string errStr)
+{
+	Vector2 p;
+	p.x = legacyParse1f(ss, delim, errStr);
+	p.y = legacyParse1f(ss, delim, errStr);
+	return p;
+}
+
+static Vector3 legacyParse3f(stringstream& ss, char delim, string errStr)
+{
+	Vector3 t;
+	t.x = legacyParse1f(ss, delim, errStr);
+	t.y = legacyParse1f(ss, delim, errStr);
+	t.z = legacyParse1f(ss, delim, errStr);
+	return t;
+}
+
+static bool legacyParse1ui(stringstream& ss, char delim, unsigned int& outInt)
+{
+	string out = "";
+	getline(ss, out, delim);
+	if (out.size() == 0)
+	{
+		outInt = 0u;
+		return false;
+	}
+	outInt = (unsigned int)stoi(out.c_str());
+	return true;
+}
+
+static bool legacyCheckEOL(stringstream& ss, char delim)
+{
+	string str = "";
+	streampos save = ss.tellg();
+	bool isEOL = !(bool)getline(ss, str, delim);
+	ss.seekg(save);
+	return isEOL;
+}
+
+static void legacyParseEOL(stringstream& ss, char delim, string errStr)
+{
+	if (!legacyCheckEOL(ss, delim)) throw invalid_argument(errStr);
+}
+
+static FaceType legacyParseSubFace(stringstream& ss, char delim, vector<unsigned int>& outVec, string errStr)
+{
+	FaceType newType = FaceType::V;
+	outVec.clear();
+
+	unsigned int id = 0u;
+	legacyParse1ui(ss, delim, id);
+	outVec.push_back(id);
+	if (legacyCheckEOL(ss, delim)) return newType;
+
+	if (legacyParse1ui(ss, delim, id))
+	{
+		outVec.push_back(id);
+		newType = FaceType::V_VT;
+		if (legacyCheckEOL(ss, delim)) return newType;
+	}
+
+	if (legacyParse1ui(ss, delim, id))
+	{
+		outVec.push_back(id);
+		if (newType == FaceType::V) newType = FaceType::V_VN;
+		else if (newType == FaceType::V_VT) newType = FaceType::V_VT_VN;
+	}
+	legacyParseEOL(ss, delim, errStr);
+	return newType;
+}
+
+static string legacyErrString(string msg, const char* filename, string line, int lineCount)
+{
+	stringstream erss;
+	erss << msg << ": " << line << "\nFile: " << filename << "\nLine: " << lineCount << "\n";
+	return erss.str();
+}
+
+static ObjectFileData legacyReadObj(const char* filename)
+{
+	static map<const string, LegacyObjKeyword> keywords = {
+		{ "#", LEGACY_COMMENT }, { "mtllib", LEGACY_MATERIAL_FILE }, { "o", LEGACY_OBJECT }, { "g", LEGACY_GROUP },
+		{ "v", LEGACY_VERTEX }, { "vt", LEGACY_TEXTURE_MAP }, { "vn", LEGACY_NORMAL }, { "usemtl", LEGACY_USE_MATERIAL },
+		{ "s", LEGACY_SMOOTH_SHADDING }, { "f", LEGACY_FACE_INDEX }, { "l", LEGACY_LINE_INDEX } };
+
+	ifstream inputFile(filename);
+	if (!inputFile.good()) throw invalid_argument("ObjBenchmark::file doesn't exist");
+	ObjectFileData data;
+	data.objFilename = filename;
+
+	char delim = ' ';
+	char faceDelim = '/';
+	string line = "";
+	FaceType faceType = FaceType::NO_TYPE;
+	FaceType detectedFaceType = FaceType::NO_TYPE;
+	vector<unsigned int> tempUI;
+	int lineCount = 0;
+
+	while (getline(inputFile, line))
+	{
+		stringstream inputString(line);
+		string subStr = "";
+		getline(inputString, subStr, delim);
+
+		switch (keywords[(const string)subStr])
+		{
+		case LEGACY_NULL_KEYWORD:
+			throw invalid_argument(legacyErrString("ObjBenchmark::Not Supported Keyword line", filename, line, lineCount));
+		case LEGACY_GROUP:
+			throw invalid_argument(legacyErrString("ObjBenchmark::Object grouping is not supported", filename, line, lineCount));
+		case LEGACY_COMMENT:
+		case LEGACY_LINE_INDEX:
+			break;
+
+		case LEGACY_MATERIAL_FILE:
+			legacyParse1s(inputString, delim, subStr);
+			data.mtlFilename = subStr;
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::Too many paths for a single material file", filename, line, lineCount));
+			break;
+
+		case LEGACY_OBJECT:
+			data.subObjects.push_back(SubObj());
+			legacyParse1s(inputString, delim, subStr);
+			data.subObjects.back().modelObjectName = subStr;
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::Too many names for a single object", filename, line, lineCount));
+			faceType = FaceType::NO_TYPE;
+			break;
+
+		case LEGACY_VERTEX:
+			data.vertices.push_back(legacyParse3f(inputString, delim,
+				legacyErrString("ObjBenchmark::Length of vertex coordinate is not 3", filename, line, lineCount)));
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::More than 3 points in a vertex", filename, line, lineCount));
+			break;
+
+		case LEGACY_TEXTURE_MAP:
+			data.texCoords.push_back(legacyParse2f(inputString, delim,
+				legacyErrString("ObjBenchmark::Length of texture coordinate is not 2", filename, line, lineCount)));
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::More than 2 points in texture coordinate", filename, line, lineCount));
+			break;
+
+		case LEGACY_NORMAL:
+			data.normals.push_back(legacyParse3f(inputString, delim,
+				legacyErrString("ObjBenchmark::Length of normals is not 3", filename, line, lineCount)));
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::More than 3 values in a normals", filename, line, lineCount));
+			break;
+
+		case LEGACY_USE_MATERIAL:
+			legacyParse1s(inputString, delim, subStr);
+			if (data.subObjects.empty()) throw invalid_argument(legacyErrString("ObjBenchmark::Material outside an object", filename, line, lineCount));
+			data.subObjects.back().useMaterial = subStr;
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::Use too many materials", filename, line, lineCount));
+			break;
+
+		case LEGACY_SMOOTH_SHADDING:
+			legacyParse1s(inputString, delim, subStr);
+			if (data.subObjects.empty()) throw invalid_argument(legacyErrString("ObjBenchmark::Smooth shading outside an object", filename, line, lineCount));
+			data.subObjects.back().smoothShadding = subStr;
+			legacyParseEOL(inputString, delim, legacyErrString("ObjBenchmark::Too many arguments in smooth shadding", filename, line, lineCount));
+			break;
+
+		case LEGACY_FACE_INDEX:
+			if (data.subObjects.empty()) throw invalid_argument(legacyErrString("ObjBenchmark::Face outside an object", filename, line, lineCount));
+			for (int i = 0; i < 3; i++)
+			{
+				legacyParse1s(inputString, delim, subStr);
+				stringstream subFaceStr(subStr);
+				detectedFaceType = legacyParseSubFace(subFaceStr, faceDelim, tempUI,
+					legacyErrString("ObjBenchmark::Invalid Face Indices Type", filename, line, lineCount));
+				if (faceType == FaceType::NO_TYPE) faceType = detectedFaceType;
+				else if (detectedFaceType != faceType)
+				{
+					throw invalid_argument(legacyErrString("ObjBenchmark::Inconsistent Face Indices Type", filename, line, lineCount));
+				}
+
+				SubObj& subObj = data.subObjects.back();
+				subObj.verticesIdx.push_back(tempUI[0]);
+				if (faceType == FaceType::V_VT_VN || faceType == FaceType::V_VT) subObj.textureMapIdx.push_back(tempUI[1]);
+				if (faceType == FaceType::V_VT_VN) subObj.normalsIdx.push_back(tempUI[2]);
+				if (faceType == FaceType::V_VN) subObj.normalsIdx.push_back(tempUI[1]);
+			}
+			legacyParseEOL(inputString, delim,
+				legacyErrString("ObjBenchmark::More than 3 sets of indices, please triangulate object", filename, line, lineCount));
+			break;
+		}
+
+		line = "";
+		lineCount++;
+	}
+	return data;
+}
+
+// position indices of every sub object in file order, the current reader splits objects on material changes
+static vector<unsigned int> positionIndices(const ObjectFileData& data)
+{
+	vector<unsigned int> indices;
+	for (const SubObj& subObj : data.subObjects) indices.insert(indices.end(), subObj.verticesIdx.begin(), subObj.verticesIdx.end());
+	return indices;
+}
+
+static bool sameVectors(const vector<Vector3>& a, const vector<Vector3>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(Vector3)) == 0);
+}
+
+static bool sameVectors(const vector<Vector2>& a, const vector<Vector2>& b)
+{
+	return a.size() == b.size() && (a.empty() || memcmp(a.data(), b.data(), a.size() * sizeof(Vector2)) == 0);
+}
+
+ObjParserComparison compareObjParsers(const string& objFilename, int runs)
+{
+	ObjParserComparison comparison;
+	comparison.filename = objFilename;
+	comparison.bytes = (size_t)filesystem::file_size(objFilename);
+
+	// the readObj stage alone, like benchmarkObjReader
+	ObjFileReader reader;
+	reader.setUseMeshCache(false);
+	reader.setOptimizeMeshes(false);
+	reader.setGenerateLods(false);
+	reader.setLogging(false);
+
+	const size_t MIN_BYTES_PER_RUN = 16 << 20;
+	size_t repeats = max<size_t>(1, MIN_BYTES_PER_RUN / max<size_t>(comparison.bytes, 1));
+	ObjectFileData legacy, current;
+	for (int run = 0; run < max(runs, 1); run++)
+	{
+		auto startTime = chrono::steady_clock::now();
+		for (size_t i = 0; i < repeats; i++) legacy = legacyReadObj(objFilename.c_str());
+		double legacySeconds = chrono::duration<double>(chrono::steady_clock::now() - startTime).count() / repeats;
+
+		double currentSeconds = 0.0;
+		for (size_t i = 0; i < repeats; i++)
+		{
+			current = reader.read(objFilename.c_str(), false);
+			currentSeconds += reader.getLastTimings().readObj;
+		}
+		currentSeconds /= repeats;
+
+		if (run == 0 || legacySeconds < comparison.legacySeconds) comparison.legacySeconds = legacySeconds;
+		if (run == 0 || currentSeconds < comparison.currentSeconds) comparison.currentSeconds = currentSeconds;
+	}
+
+	double megaBytes = (double)comparison.bytes / (1024.0 * 1024.0);
+	if (comparison.legacySeconds > 0.0) comparison.legacyMBps = megaBytes / comparison.legacySeconds;
+	if (comparison.currentSeconds > 0.0) comparison.currentMBps = megaBytes / comparison.currentSeconds;
+
+	// the current reader may complete missing attributes after parsing, positions are never touched
+	comparison.sameData = sameVectors(legacy.vertices, current.vertices) && (legacy.texCoords.empty() || sameVectors(legacy.texCoords, current.texCoords)) &&
+		positionIndices(legacy) == positionIndices(current);
+	return comparison;
+}
+
+// one face per "usemtl A" section, the same material every time. the comment line at the top shifts the
+// middle of the file so splitting it in two chunks starts the second one on a usemtl line
+static string writeSectionSeamObj(const string& directory, size_t sectionCount)
+{
+	const size_t headerBytes = 24, sectionBytes = 17, usemtlBytes = 9;	// the lines written below
+
+	// splitLines moves the middle to the start of the line after it, which is a usemtl when the middle
+	// is on the face line of a section
+	size_t padding = 1;
+	for (; padding < 1 + 2 * sectionBytes; padding++)
+	{
+		size_t middle = (headerBytes + padding + 1 + sectionCount * sectionBytes) / 2;
+		size_t inSection = (middle - headerBytes - padding - 1) % sectionBytes;
+		if (inSection >= usemtlBytes) break;
+	}
+
+	string filename = (filesystem::path(directory) / "synthetic_section_seam.obj").generic_string();
+	AssetWriter obj(filename);
+	obj.line().append(padding, '#'); obj.endLine();
+	for (const char* position : { "v 0 0 0", "v 1 0 0", "v 0 1 0" })
+	{
+		obj.line() += position; obj.endLine();
+	}
+	for (size_t i = 0; i < sectionCount; i++)
+	{
+		obj.line() += "usemtl A"; obj.endLine();
+		obj.line() += "f 1 2 3"; obj.endLine();
+	}
+	return filename;
+}
+
+static bool sameSubObjects(const ObjectFileData& a, const ObjectFileData& b)
+{
+	if (a.subObjects.size() != b.subObjects.size()) return false;
+	for (size_t i = 0; i < a.subObjects.size(); i++)
+	{
+		const SubObj& x = a.subObjects[i];
+		const SubObj& y = b.subObjects[i];
+		if (x.modelObjectName != y.modelObjectName || x.groupName != y.groupName || x.useMaterial != y.useMaterial ||
+			x.smoothShadding != y.smoothShadding || x.faceType != y.faceType || x.verticesIdx != y.verticesIdx ||
+			x.textureMapIdx != y.textureMapIdx || x.normalsIdx != y.normalsIdx) return false;
+	}
+	return true;
+}
+
+vector<ObjThreadCheck> checkParseThreads(const ObjBenchmarkConfig& config)
+{
+	SyntheticObjAsset asset = generateSyntheticObj(config);
+	string seamFilename = writeSectionSeamObj(config.directory, 700000);
+
+	// the parse stage only, with the reader's default attribute completion
+	ObjFileReader reader;
+	reader.setUseMeshCache(false);
+	reader.setOptimizeMeshes(false);
+	reader.setGenerateLods(false);
+	reader.setLogging(false);
+
+	vector<ObjThreadCheck> checks;
+	for (const string& filename : { asset.objFilename, seamFilename })
+	{
+		ObjThreadCheck check;
+		check.filename = filename;
+		check.threads = config.threads ? config.threads : 2;
+
+		reader.setParseThreads(1);
+		ObjectFileData serial = reader.read(filename.c_str(), false);
+		reader.setParseThreads(check.threads);
+		ObjectFileData parallel = reader.read(filename.c_str(), false);
+
+		check.serialSubObjects = serial.subObjects.size();
+		check.parallelSubObjects = parallel.subObjects.size();
+		check.same = sameVectors(serial.vertices, parallel.vertices) && sameVectors(serial.texCoords, parallel.texCoords) &&
+			sameVectors(serial.normals, parallel.normals) && sameSubObjects(serial, parallel);
+		checks.push_back(check);
+	}
+
+	if (!config.keepAssets)
+	{
+		error_code error;
+		filesystem::remove(asset.objFilename, error);
+		filesystem::remove(asset.mtlFilename, error);
+		filesystem::remove(seamFilename, error);
+	}
+	return checks;
+}
+
+// classifications of the last timed loop, stored so the loop can't be dropped
+static volatile size_t keywordSink = 0;
+
+KeywordBenchmark benchmarkKeywordClassifier(size_t tokenCount)
+{
+	// line keywords laid out like an exported mesh: runs of v/vt/vn/f lines, single state changes,
+	// comments and keywords the reader doesn't know in between
+	static const char* const KEYWORDS[] = { "v", "vt", "vn", "f", "f", "s", "o", "g", "usemtl", "mtllib", "#", "l", "vp", "curv" };
+	const size_t RUN_KEYWORDS = 5;	// the first ones come in runs
+	mt19937 rng(7);
+	uniform_int_distribution<size_t> pick(0, sizeof(KEYWORDS) / sizeof(KEYWORDS[0]) - 1);
+	uniform_int_distribution<size_t> runLength(1, 64);
+	vector<string_view> tokens;
+	tokens.reserve(tokenCount);
+	while (tokens.size() < tokenCount)
+	{
+		size_t keyword = pick(rng);
+		size_t count = min(keyword < RUN_KEYWORDS ? runLength(rng) : 1, tokenCount - tokens.size());
+		tokens.insert(tokens.end(), count, KEYWORDS[keyword]);
+	}
+
+	// the table and lookup readObj used before, operator[] inserts the unknown keys
+	map<const string, ObjKeywords> keywordMap = {
+		{ "#", COMMENT }, { "mtllib", MATERIAL_FILE }, { "o", OBJECT }, { "g", GROUP }, { "v", VERTEX },
+		{ "vt", TEXTURE_MAP }, { "vn", NORMAL }, { "usemtl", USE_MATERIAL }, { "s", SMOOTH_SHADDING },
+		{ "f", FACE_INDEX }, { "l", LINE_INDEX } };
+
+	KeywordBenchmark result;
+	result.tokens = tokenCount;
+
+	auto timeClassify = [&](bool withSwitch) -> double {
+		auto startTime = chrono::steady_clock::now();
+		size_t sum = 0;
+		for (string_view token : tokens)
+		{
+			sum += withSwitch ? classifyObjKeyword(token) : keywordMap[(const string)token];
+		}
+		chrono::duration<double> time = chrono::steady_clock::now() - startTime;
+		keywordSink = sum;	// keeps the loop from being optimized away
+		return (double)tokenCount / 1e6 / time.count();
+	};
+	result.mapMtokps = timeClassify(false);
+	result.switchMtokps = timeClassify(true);
+
+	for (string_view token : tokens)
+	{
+		if (classifyObjKeyword(token) != keywordMap[(const string)token]) result.mismatches++;
+	}
+	return result;
+}
+
+static void jsonStage(ostringstream& out, const char* name, const ObjStageThroughput& stage)
+{
+	out << "    \"" << name << "\": { \"seconds\": " << stage.seconds << ", \"MBps\": " << stage.megaBytesPerSecond
+		<< ", \"linesPerSecond\": " << stage.linesPerSecond << " }";
+}
+
+string objBenchmarkJson(const ObjBenchmarkResult& result)
+{
+	const ObjBenchmarkConfig& config = result.config;
+	const SyntheticObjAsset& asset = result.asset;
+
+	ostringstream out;
+	out.precision(9);
+	out << "{\n";
+	out << "  \"benchmark\": \"obj_reader\",\n";
+	out << "  \"schema\": 1,\n";
+	out << "  \"config\": { \"megabytes\": " << config.megaBytes << ", \"faceType\": \"" << faceTypeName(config.faceType)
+		<< "\", \"objects\": " << config.objectCount << ", \"materials\": " << config.materialCount << ", \"runs\": " << config.runs
+		<< ", \"threads\": " << config.threads << ", \"hardwareThreads\": " << thread::hardware_concurrency() << " },\n";
+	out << "  \"asset\": { \"objBytes\": " << asset.objBytes << ", \"objLines\": " << asset.objLines << ", \"mtlBytes\": " << asset.mtlBytes
+		<< ", \"mtlLines\": " << asset.mtlLines << ", \"vertices\": " << asset.vertices << ", \"faces\": " << asset.faces
+		<< ", \"generateSeconds\": " << result.generateSeconds << " },\n";
+	out << "  \"stages\": {\n";
+	jsonStage(out, "readObj", result.readObj); out << ",\n";
+	out << "    \"completeAttributes\": { \"seconds\": " << result.best.completeAttributes << " },\n";
+	jsonStage(out, "expandVertices", result.expandVertices); out << ",\n";
+	out << "    \"indexVertices\": { \"seconds\": " << result.best.indexVertices << " },\n";
+	jsonStage(out, "readMtl", result.readMtl); out << ",\n";
+	jsonStage(out, "total", result.total); out << "\n";
+	out << "  },\n";
+	out << "  \"allocationsPerRead\": " << result.allocations << ",\n";
+	out << "  \"peakRssBytes\": " << result.peakResidentBytes << "\n";
+	out << "}\n";
+	return out.str();
+}
+
+size_t peakResidentBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (size_t)usage.ru_maxrss;			// bytes
+#else
+	return (size_t)usage.ru_maxrss * 1024;	// kilobytes
+#endif
+#endif
+}
+
+size_t heapAllocationCount()
+{
+	return allocationCount.load(memory_order_relaxed);
+}
@@ -0,0 +1,48 @@
+#include "SourceIdentity.h"
+#include "MappedFile.h"
+#include <filesystem>
+
+using namespace std;
+
+uint64_t hashBytes(const char* bytes, size_t size)
+{
+	// FNV-1a 64, four independent lanes so it isn't bound by multiply latency
+	uint64_t lanes[4] = { 0xcbf29ce484222325ull, 0x84222325cbf29ce4ull, 0x9ce484222325cbf2ull, 0x2325cbf29ce48422ull };
+	size_t i = 0;
+	for (; i + 4 <= size; i += 4)
+	{
+		for (int l = 0; l < 4; l++) lanes[l] = (lanes[l] ^ (unsigned char)bytes[i + l]) * 0x100000001b3ull;
+	}
+	for (; i < size; i++) lanes[0] = (lanes[0] ^ (unsigned char)bytes[i]) * 0x100000001b3ull;
+
+	uint64_t h = lanes[0];
+	for (int l = 1; l < 4; l++) h = (h ^ lanes[l]) * 0x100000001b3ull;
+	return h;
+}
+
+bool sourceIdentity(const char* filename, uint64_t& outSize, int64_t& outMtime)
+{
+	error_code ec;
+	filesystem::path path(filename);
+	uintmax_t size = filesystem::file_size(path, ec);
+	if (ec) return false;
+	filesystem::file_time_type mtime = filesystem::last_write_time(path, ec);
+	if (ec) return false;
+
+	outSize = (uint64_t)size;
+	outMtime = (int64_t)mtime.time_since_epoch().count();
+	return true;
+}
+
+bool sourceUnchanged(const char* filename, uint64_t size, int64_t mtime, uint64_t hash)
+{
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	if (!sourceIdentity(filename, sourceSize, sourceMtime)) return false;
+	if (sourceSize != size) return false;
+	if (sourceMtime == mtime) return true;
+
+	MappedFile sourceFile;
+	if (!sourceFile.open(filename)) return false;
+	return hashBytes(sourceFile.begin(), sourceFile.size()) == hash;
+}
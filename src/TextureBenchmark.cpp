@@ -0,0 +1,259 @@
+#include "TextureBenchmark.h"
+#include "DecodedTextureCache.h"
+#include <glad/glad.h>
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+static const size_t READ_CHUNK_SIZE = 1 << 20;
+
+struct BenchmarkImage
+{
+	string path;
+	bool mipmaps;
+};
+
+static bool isImage(const filesystem::path& path)
+{
+	string extension = path.extension().string();
+	transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return extension == ".jpg" || extension == ".jpeg" || extension == ".png";
+}
+
+static void collectImages(const string& directory, bool recursive, bool mipmaps, vector<BenchmarkImage>& images)
+{
+	vector<string> paths;
+	error_code ec;
+	if (recursive)
+	{
+		for (filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+			if (it->is_regular_file() && isImage(it->path())) paths.push_back(it->path().generic_string());
+	}
+	else
+	{
+		for (filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+			if (it->is_regular_file() && isImage(it->path())) paths.push_back(it->path().generic_string());
+	}
+	sort(paths.begin(), paths.end());
+	for (const string& path : paths) images.push_back(BenchmarkImage{ path, mipmaps });
+}
+
+// copies the texels out in chunks like a transfer into an unpack buffer, so mapped pages are read too
+static void readThrough(const unsigned char* bytes, size_t size, vector<unsigned char>& scratch)
+{
+	scratch.resize(READ_CHUNK_SIZE);
+	for (size_t offset = 0; offset < size; offset += READ_CHUNK_SIZE)
+	{
+		memcpy(scratch.data(), bytes + offset, min(READ_CHUNK_SIZE, size - offset));
+	}
+}
+
+static double secondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+TextureBenchmarkResult benchmarkTextureCache(const TextureBenchmarkConfig& config)
+{
+	TextureBenchmarkResult result;
+	result.config = config;
+
+	vector<BenchmarkImage> images;
+	collectImages(config.textureDirectory, false, true, images);
+	collectImages(config.cubemapDirectory, true, false, images);
+	result.images = images.size();
+	for (const BenchmarkImage& image : images)
+	{
+		error_code ec;
+		result.sourceBytes += (unsigned long long)filesystem::file_size(image.path, ec);
+	}
+
+	vector<unsigned char> scratch;
+
+	// stb only, the sources end up in the os file cache for the cache runs as well
+	auto startTime = chrono::steady_clock::now();
+	for (const BenchmarkImage& image : images)
+	{
+		int width, height, nrComponents;
+		stbi_set_flip_vertically_on_load_thread(true);
+		unsigned char* pixels = stbi_load(image.path.c_str(), &width, &height, &nrComponents, 0);
+		if (pixels) readThrough(pixels, (size_t)width * height * nrComponents, scratch);
+		else result.failed++;
+		stbi_image_free(pixels);
+	}
+	result.decodeSeconds = secondsSince(startTime);
+
+	// no cap, an evicted entry would turn the warm runs into cold ones
+	DecodedTextureCache cache(config.cacheDirectory, UINT64_MAX);
+	cache.clear();
+
+	startTime = chrono::steady_clock::now();
+	for (const BenchmarkImage& image : images)
+	{
+		DecodedTexture texture;
+		if (cache.acquire(image.path.c_str(), image.mipmaps, texture)) readThrough(texture.data(), texture.byteSize(), scratch);
+	}
+	result.coldSeconds = secondsSince(startTime);
+	result.cacheBytes = cache.size();
+
+	for (int run = 0; run < max(config.warmRuns, 1); run++)
+	{
+		startTime = chrono::steady_clock::now();
+		for (const BenchmarkImage& image : images)
+		{
+			DecodedTexture texture;
+			if (cache.load(image.path.c_str(), image.mipmaps, texture)) readThrough(texture.data(), texture.byteSize(), scratch);
+		}
+		double seconds = secondsSince(startTime);
+		result.warmSeconds = run == 0 ? seconds : min(result.warmSeconds, seconds);
+	}
+
+	error_code ec;
+	filesystem::remove_all(config.cacheDirectory, ec);
+	return result;
+}
+
+string textureBenchmarkJson(const TextureBenchmarkResult& result)
+{
+	const TextureBenchmarkConfig& config = result.config;
+
+	ostringstream out;
+	out.precision(9);
+	out << "{\n";
+	out << "  \"benchmark\": \"texture_cache\",\n";
+	out << "  \"schema\": 1,\n";
+	out << "  \"config\": { \"textureDirectory\": \"" << config.textureDirectory << "\", \"cubemapDirectory\": \"" << config.cubemapDirectory
+		<< "\", \"warmRuns\": " << config.warmRuns << ", \"hardwareThreads\": " << thread::hardware_concurrency() << " },\n";
+	out << "  \"images\": " << result.images << ",\n";
+	out << "  \"failed\": " << result.failed << ",\n";
+	out << "  \"sourceBytes\": " << result.sourceBytes << ",\n";
+	out << "  \"cacheBytes\": " << result.cacheBytes << ",\n";
+	out << "  \"seconds\": { \"decode\": " << result.decodeSeconds << ", \"cold\": " << result.coldSeconds << ", \"warm\": " << result.warmSeconds << " }\n";
+	out << "}\n";
+	return out.str();
+}
+
+MipBenchmarkResult benchmarkMipChain(const MipBenchmarkConfig& config, bool withGl)
+{
+	MipBenchmarkResult result;
+	result.config = config;
+
+	int width, height, nrComponents;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* pixels = stbi_load(config.image.c_str(), &width, &height, &nrComponents, 0);
+	if (!pixels) return result;
+	vector<unsigned char> rgba;
+	expandToRgba(pixels, width, height, nrComponents, rgba);
+	stbi_image_free(pixels);
+	result.width = width;
+	result.height = height;
+
+	// the levels of the last build, uploaded for the gl timing
+	vector<vector<unsigned char>> levels;
+	vector<pair<int, int>> levelSizes;
+	vector<unsigned int> threadCounts = { 1 };
+	if (thread::hardware_concurrency() > 1) threadCounts.push_back(thread::hardware_concurrency());
+	for (MipFilter filter : { MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos })
+	{
+		for (bool srgb : { false, true })
+		{
+			for (unsigned int threads : threadCounts)
+			{
+				MipOptions options;
+				options.filter = filter;
+				options.srgb = srgb;
+				MipFilterTiming timing{ filter, srgb, threads, 0.0 };
+				for (int run = 0; run < max(config.runs, 1); run++)
+				{
+					levels.clear();
+					levelSizes.clear();
+					auto startTime = chrono::steady_clock::now();
+					buildMipChain(rgba.data(), width, height, 4, options, threads, [&](int, const unsigned char* texels, int levelWidth, int levelHeight) {
+						levels.emplace_back(texels, texels + (size_t)levelWidth * levelHeight * 4);
+						levelSizes.push_back({ levelWidth, levelHeight });
+					});
+					double seconds = secondsSince(startTime);
+					timing.seconds = run == 0 ? seconds : min(timing.seconds, seconds);
+				}
+				result.cpu.push_back(timing);
+			}
+		}
+	}
+
+	if (!withGl) return result;
+	result.gl = true;
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (int run = 0; run < max(config.runs, 1); run++)
+	{
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+		glFinish();
+		auto startTime = chrono::steady_clock::now();
+		glGenerateMipmap(GL_TEXTURE_2D);
+		glFinish();
+		double generateSeconds = secondsSince(startTime);
+
+		startTime = chrono::steady_clock::now();
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			glTexImage2D(GL_TEXTURE_2D, (GLint)i + 1, GL_RGBA8, levelSizes[i].first, levelSizes[i].second, 0, GL_RGBA, GL_UNSIGNED_BYTE, levels[i].data());
+		}
+		glFinish();
+		double uploadSeconds = secondsSince(startTime);
+
+		result.generateMipmapSeconds = run == 0 ? generateSeconds : min(result.generateMipmapSeconds, generateSeconds);
+		result.uploadLevelsSeconds = run == 0 ? uploadSeconds : min(result.uploadLevelsSeconds, uploadSeconds);
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glDeleteTextures(1, &texture);
+	return result;
+}
+
+string mipBenchmarkJson(const MipBenchmarkResult& result)
+{
+	const MipBenchmarkConfig& config = result.config;
+
+	ostringstream out;
+	out.precision(9);
+	out << "{\n";
+	out << "  \"benchmark\": \"mip_chain\",\n";
+	out << "  \"schema\": 1,\n";
+	out << "  \"config\": { \"image\": \"" << config.image << "\", \"runs\": " << config.runs
+		<< ", \"hardwareThreads\": " << thread::hardware_concurrency() << " },\n";
+	out << "  \"width\": " << result.width << ",\n";
+	out << "  \"height\": " << result.height << ",\n";
+	out << "  \"cpu\": [\n";
+	for (size_t i = 0; i < result.cpu.size(); i++)
+	{
+		const MipFilterTiming& timing = result.cpu[i];
+		out << "    { \"filter\": \"" << mipFilterName(timing.filter) << "\", \"srgb\": " << (timing.srgb ? "true" : "false")
+			<< ", \"threads\": " << timing.threads << ", \"seconds\": " << timing.seconds << " }" << (i + 1 < result.cpu.size() ? ",\n" : "\n");
+	}
+	out << "  ]";
+	if (result.gl)
+	{
+		out << ",\n  \"gl\": { \"generateMipmapSeconds\": " << result.generateMipmapSeconds << ", \"uploadLevelsSeconds\": " << result.uploadLevelsSeconds << " }";
+	}
+	out << "\n}\n";
+	return out.str();
+}
+
+const char* mipFilterName(MipFilter filter)
+{
+	switch (filter)
+	{
+	case MipFilter::Box: return "box";
+	case MipFilter::Kaiser: return "kaiser";
+	default: return "lanczos";
+	}
+}
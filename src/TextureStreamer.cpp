@@ -0,0 +1,187 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+static const size_t UNPACK_BUFFER_COUNT = 3;
+static const unsigned int MAX_WORKERS = 4;	// more only adds decoded images waiting for the queue
+static const unsigned char DEFAULT_PLACEHOLDER[4] = { 128, 128, 128, 255 };
+
+TextureStreamer::TextureStreamer(DecodedTextureCache* cache, unsigned int workerCount, size_t queueCapacity) : queueCapacity(max<size_t>(1, queueCapacity)), cache(cache)
+{
+	unpackBuffers.resize(UNPACK_BUFFER_COUNT);
+	glGenBuffers((GLsizei)unpackBuffers.size(), unpackBuffers.data());
+	compressBlocks = compressedFormatSupported(BlockFormat::BC1) && compressedFormatSupported(BlockFormat::BC3);
+
+	unsigned int hardwareThreads = thread::hardware_concurrency();
+	if (workerCount == 0) workerCount = min(MAX_WORKERS, hardwareThreads > 1 ? hardwareThreads - 1 : 1);
+	for (unsigned int i = 0; i < workerCount; i++) workers.emplace_back(&TextureStreamer::work, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	requestReady.notify_all();
+	queueSpace.notify_all();
+	for (thread& worker : workers) worker.join();
+}
+
+GLuint TextureStreamer::request(const string& path, const unsigned char placeholder[4], const MipOptions& mips)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder ? placeholder : DEFAULT_PLACEHOLDER);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);	// no mipmaps yet
+
+	{
+		lock_guard<std::mutex> lock(mutex);
+		requests.push_back(Request{ path, texture, mips });
+		outstanding.insert(texture);
+	}
+	requestReady.notify_one();
+	return texture;
+}
+
+int TextureStreamer::update(size_t byteBudget)
+{
+	int uploaded = 0;
+	size_t spent = 0;
+	while (spent < byteBudget)
+	{
+		Image image;
+		{
+			lock_guard<std::mutex> lock(mutex);
+			if (decoded.empty()) break;
+			image = move(decoded.front());
+			decoded.pop_front();
+		}
+		queueSpace.notify_one();
+
+		if (image.loaded)
+		{
+			spent += image.isCompressed ? image.compressed.byteSize() : image.uncompressed.byteSize();
+			upload(image);
+			uploaded++;
+		}
+		else
+		{
+			cout << "Texture failed to load at path: " << image.path << endl;
+		}
+
+		lock_guard<std::mutex> lock(mutex);
+		outstanding.erase(image.texture);
+	}
+	return uploaded;
+}
+
+bool TextureStreamer::idle() const
+{
+	lock_guard<std::mutex> lock(mutex);
+	return outstanding.empty();
+}
+
+bool TextureStreamer::resident(GLuint texture) const
+{
+	lock_guard<std::mutex> lock(mutex);
+	return outstanding.count(texture) == 0;
+}
+
+void TextureStreamer::work()
+{
+	while (true)
+	{
+		Request request;
+		{
+			unique_lock<std::mutex> lock(mutex);
+			requestReady.wait(lock, [&]() { return !running || !requests.empty(); });
+			if (!running) return;
+			request = requests.front();
+			requests.pop_front();
+		}
+
+		Image image;
+		image.path = request.path;
+		image.texture = request.texture;
+		auto loadStart = chrono::steady_clock::now();
+		if (compressBlocks)
+		{
+			try
+			{
+				image.isCompressed = acquireCompressedTexture(request.path.c_str(), image.compressed, request.mips);
+			}
+			catch (const exception& e)
+			{
+				cout << "Fail compressing texture: " << e.what() << endl;
+			}
+		}
+		if (image.isCompressed)
+		{
+			image.loaded = true;
+		}
+		else
+		{
+			try
+			{
+				if (cache) image.loaded = cache->acquire(request.path.c_str(), true, image.uncompressed, request.mips);
+				else image.loaded = decodeTexture(request.path.c_str(), true, image.uncompressed, request.mips);
+			}
+			catch (const exception& e)
+			{
+				cout << "Fail decoding texture: " << e.what() << endl;
+			}
+		}
+		image.loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - loadStart).count();
+
+		unique_lock<std::mutex> lock(mutex);
+		queueSpace.wait(lock, [&]() { return !running || decoded.size() < queueCapacity; });
+		if (!running) return;
+		decoded.push_back(move(image));
+	}
+}
+
+// releases the image's levels
+void TextureStreamer::upload(Image& image)
+{
+	const unsigned char* pixels = image.isCompressed ? image.compressed.data() : image.uncompressed.data();
+	size_t size = image.isCompressed ? image.compressed.byteSize() : image.uncompressed.byteSize();
+
+	// orphaned every time, a transfer still reading the buffer keeps its old storage
+	GLuint buffer = unpackBuffers[nextUnpackBuffer];
+	nextUnpackBuffer = (nextUnpackBuffer + 1) % unpackBuffers.size();
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+	void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+	if (mapped) memcpy(mapped, pixels, size);
+	bool staged = mapped && glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+
+	// a buffer that couldn't be mapped (or got corrupted) falls back to client memory
+	if (!staged) glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_2D, image.texture);
+	if (image.isCompressed) uploadCompressedLevels(image.compressed, staged ? nullptr : pixels);
+	else uploadDecodedLevels(GL_TEXTURE_2D, image.uncompressed, staged ? nullptr : pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	cout << "Texture Loaded: " << image.path << " (" << image.loadSeconds * 1000.0 << " ms";
+	if (image.isCompressed)
+	{
+		const CompressedTexture& compressed = image.compressed;
+		cout << ", " << (compressed.format == BlockFormat::BC1 ? "BC1 " : "BC3 ") << compressed.byteSize() / 1024 << " KB instead of "
+			<< uncompressedTextureBytes(compressed.width, compressed.height) / 1024 << " KB";
+	}
+	cout << ")" << endl;
+
+	image.compressed = CompressedTexture();
+	image.uncompressed = DecodedTexture();
+}
@@ -0,0 +1,334 @@
+#include "TilePyramid.h"
+#include "CompressedTexture.h"
+#include "MipChain.h"
+#include "SourceIdentity.h"
+#include <stb/stb_image.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+using namespace std;
+
+static const char TILE_PYRAMID_MAGIC[8] = { 'S', 'S', 'T', 'I', 'L', 'E', 'S', 0 };
+
+struct TilePyramidHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t format;		// BlockFormat
+
+	// source identity
+	uint64_t sourceSize;
+	int64_t sourceMtime;
+	uint64_t sourceHash;
+
+	uint32_t width;
+	uint32_t height;
+	uint32_t tileSize;
+	uint32_t tileBorder;
+	uint32_t levelCount;
+	uint32_t mipOptions;	// MipOptions::key of the levels below level 1
+	uint64_t tileBytes;
+};
+
+struct TilePyramidLevel
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t tilesX;
+	uint32_t tilesY;
+	uint64_t firstTile;
+};
+
+
+// ================= helpers ====================
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment)
+{
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+// halving like gl's down to the first level of a single tile
+static vector<TileLevel> pyramidLevels(int width, int height)
+{
+	vector<TileLevel> levels;
+	size_t firstTile = 0;
+	for (int w = width, h = height;; w = max(1, w / 2), h = max(1, h / 2))
+	{
+		TileLevel level;
+		level.width = w;
+		level.height = h;
+		level.tilesX = (w + TILE_SIZE - 1) / TILE_SIZE;
+		level.tilesY = (h + TILE_SIZE - 1) / TILE_SIZE;
+		level.firstTile = firstTile;
+		levels.push_back(level);
+		firstTile += (size_t)level.tilesX * level.tilesY;
+		if (level.tilesX == 1 && level.tilesY == 1) break;
+	}
+	return levels;
+}
+
+static size_t pyramidTileBytes()
+{
+	return compressedLevelSize(BlockFormat::BC1, TILE_SLOT_SIZE, TILE_SLOT_SIZE);
+}
+
+// one tile with its border as rgba8, texels outside the level wrap around horizontally and clamp vertically.
+// channels is 1 to 4, gray spreads to rgb and alpha is dropped
+static void cutTile(const unsigned char* texels, int width, int height, int channels, int tileX, int tileY, unsigned char* outSlot)
+{
+	for (int sy = 0; sy < TILE_SLOT_SIZE; sy++)
+	{
+		int y = min(max(tileY * TILE_SIZE - TILE_BORDER + sy, 0), height - 1);
+		const unsigned char* row = texels + (size_t)y * width * channels;
+		unsigned char* dst = outSlot + (size_t)sy * TILE_SLOT_SIZE * 4;
+		for (int sx = 0; sx < TILE_SLOT_SIZE; sx++)
+		{
+			int x = ((tileX * TILE_SIZE - TILE_BORDER + sx) % width + width) % width;
+			const unsigned char* src = row + (size_t)x * channels;
+			bool gray = channels < 3;
+			dst[sx * 4 + 0] = src[0];
+			dst[sx * 4 + 1] = gray ? src[0] : src[1];
+			dst[sx * 4 + 2] = gray ? src[0] : src[2];
+			dst[sx * 4 + 3] = 255;
+		}
+	}
+}
+
+// cuts, encodes and writes every tile of a level, the tiles of a row are spread over threads
+static void writeLevelTiles(ofstream& out, const unsigned char* texels, int channels, const TileLevel& level, size_t tileBytes, unsigned int threads)
+{
+	vector<unsigned char> row((size_t)level.tilesX * tileBytes);
+	int rangeCount = (int)min<unsigned int>(threads, (unsigned int)level.tilesX);
+	int step = (level.tilesX + rangeCount - 1) / rangeCount;
+	for (int tileY = 0; tileY < level.tilesY; tileY++)
+	{
+		auto encodeTiles = [&](int firstTile, int lastTile) {
+			vector<unsigned char> slot((size_t)TILE_SLOT_SIZE * TILE_SLOT_SIZE * 4);
+			for (int tileX = firstTile; tileX < lastTile; tileX++)
+			{
+				cutTile(texels, level.width, level.height, channels, tileX, tileY, slot.data());
+				encodeBlocks(slot.data(), TILE_SLOT_SIZE, TILE_SLOT_SIZE, BlockFormat::BC1, row.data() + tileX * tileBytes);
+			}
+		};
+
+		if (rangeCount <= 1)
+		{
+			encodeTiles(0, level.tilesX);
+		}
+		else
+		{
+			vector<future<void>> futures;
+			for (int first = 0; first < level.tilesX; first += step)
+			{
+				futures.push_back(async(launch::async, encodeTiles, first, min(level.tilesX, first + step)));
+			}
+			for (future<void>& f : futures) f.get();
+		}
+		out.write((const char*)row.data(), (streamsize)row.size());
+	}
+}
+
+// 2x2 average of the decoded source as rgba8, so level 0 itself is never expanded. averaged in linear
+// light like the levels buildMipChain makes from it, the sRGB average would darken fine detail
+static vector<unsigned char> boxFromSource(const unsigned char* pixels, int width, int height, int nrComponents, int outWidth, int outHeight)
+{
+	vector<unsigned char> rgba((size_t)outWidth * outHeight * 4);
+	bool gray = nrComponents < 3;
+	for (int y = 0; y < outHeight; y++)
+	{
+		const unsigned char* row0 = pixels + (size_t)min(2 * y, height - 1) * width * nrComponents;
+		const unsigned char* row1 = pixels + (size_t)min(2 * y + 1, height - 1) * width * nrComponents;
+		for (int x = 0; x < outWidth; x++)
+		{
+			size_t x0 = (size_t)min(2 * x, width - 1) * nrComponents, x1 = (size_t)min(2 * x + 1, width - 1) * nrComponents;
+			unsigned char* dst = &rgba[((size_t)y * outWidth + x) * 4];
+			for (int c = 0; c < 3; c++)
+			{
+				int channel = gray ? 0 : c;
+				float sum = srgbToLinear(row0[x0 + channel]) + srgbToLinear(row0[x1 + channel]) + srgbToLinear(row1[x0 + channel]) + srgbToLinear(row1[x1 + channel]);
+				dst[c] = linearToSrgb(0.25f * sum);
+			}
+			dst[3] = 255;
+		}
+	}
+	return rgba;
+}
+
+
+// ================= TilePyramid ====================
+
+size_t TilePyramid::tileCount() const
+{
+	return levels.empty() ? 0 : levels.back().firstTile + (size_t)levels.back().tilesX * levels.back().tilesY;
+}
+
+const unsigned char* TilePyramid::tile(int level, int x, int y) const
+{
+	const TileLevel& l = levels[level];
+	return (const unsigned char*)file.begin() + dataOffset + (l.firstTile + (size_t)y * l.tilesX + x) * tileBytes;
+}
+
+string tilePyramidPath(const char* imageFilename)
+{
+	return string(imageFilename) + ".tiles";
+}
+
+bool loadTilePyramid(const char* imageFilename, TilePyramid& outPyramid)
+{
+	MappedFile pyramidFile;
+	if (!pyramidFile.open(tilePyramidPath(imageFilename).c_str())) return false;
+	if (pyramidFile.size() < sizeof(TilePyramidHeader)) return false;
+
+	TilePyramidHeader header;
+	memcpy(&header, pyramidFile.begin(), sizeof(header));
+
+	// format checks, the level table has to be the one the image size gives
+	if (memcmp(header.magic, TILE_PYRAMID_MAGIC, sizeof(TILE_PYRAMID_MAGIC)) != 0) return false;
+	if (header.version != TILE_PYRAMID_VERSION) return false;
+	if (header.format != (uint32_t)BlockFormat::BC1 || header.tileBytes != pyramidTileBytes()) return false;
+	if (header.tileSize != TILE_SIZE || header.tileBorder != TILE_BORDER) return false;
+	if (header.mipOptions != MipOptions().key()) return false;
+	if (header.width == 0 || header.height == 0 || header.width > TILE_SIZE * MAX_LEVEL_TILES || header.height > TILE_SIZE * MAX_LEVEL_TILES) return false;
+
+	TilePyramid pyramid;
+	pyramid.width = (int)header.width;
+	pyramid.height = (int)header.height;
+	pyramid.levels = pyramidLevels(pyramid.width, pyramid.height);
+	pyramid.tileBytes = (size_t)header.tileBytes;
+	if (header.levelCount != pyramid.levels.size()) return false;
+	if (sizeof(TilePyramidHeader) + (size_t)header.levelCount * sizeof(TilePyramidLevel) > pyramidFile.size()) return false;
+	for (uint32_t i = 0; i < header.levelCount; i++)
+	{
+		TilePyramidLevel record;
+		memcpy(&record, pyramidFile.begin() + sizeof(TilePyramidHeader) + i * sizeof(TilePyramidLevel), sizeof(record));
+		const TileLevel& level = pyramid.levels[i];
+		if (record.width != (uint32_t)level.width || record.height != (uint32_t)level.height || record.tilesX != (uint32_t)level.tilesX ||
+			record.tilesY != (uint32_t)level.tilesY || record.firstTile != level.firstTile) return false;
+	}
+	pyramid.dataOffset = (size_t)alignUp(sizeof(TilePyramidHeader) + header.levelCount * sizeof(TilePyramidLevel), 16);
+	if (pyramid.dataOffset > pyramidFile.size() || pyramid.tileCount() > (pyramidFile.size() - pyramid.dataOffset) / pyramid.tileBytes) return false;
+
+	// source checks, the content hash is only computed when the size matches but the mtime moved
+	if (!sourceUnchanged(imageFilename, header.sourceSize, header.sourceMtime, header.sourceHash)) return false;
+
+	pyramid.file = move(pyramidFile);
+	outPyramid = move(pyramid);
+	return true;
+}
+
+void buildTilePyramid(const char* imageFilename, unsigned int threads)
+{
+	if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+
+	TilePyramidHeader header{};
+	memcpy(header.magic, TILE_PYRAMID_MAGIC, sizeof(TILE_PYRAMID_MAGIC));
+	header.version = TILE_PYRAMID_VERSION;
+	header.format = (uint32_t)BlockFormat::BC1;
+	header.tileSize = TILE_SIZE;
+	header.tileBorder = TILE_BORDER;
+	header.mipOptions = MipOptions().key();
+	header.tileBytes = pyramidTileBytes();
+
+	if (!sourceIdentity(imageFilename, header.sourceSize, header.sourceMtime))
+		throw invalid_argument("TilePyramid::source file doesn't exist");
+	{
+		MappedFile sourceFile;
+		if (!sourceFile.open(imageFilename)) throw invalid_argument("TilePyramid::source file can't be read");
+		header.sourceHash = hashBytes(sourceFile.begin(), sourceFile.size());
+	}
+
+	int width, height, nrComponents;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* pixels = stbi_load(imageFilename, &width, &height, &nrComponents, 0);
+	if (!pixels) throw invalid_argument("TilePyramid::can't decode source image");
+
+	vector<TileLevel> levels = pyramidLevels(width, height);
+	if (levels[0].tilesX > MAX_LEVEL_TILES || levels[0].tilesY > MAX_LEVEL_TILES)
+	{
+		stbi_image_free(pixels);
+		throw invalid_argument("TilePyramid::source image larger than 32768 texels");
+	}
+	header.width = (uint32_t)width;
+	header.height = (uint32_t)height;
+	header.levelCount = (uint32_t)levels.size();
+
+	vector<TilePyramidLevel> records;
+	for (const TileLevel& level : levels)
+	{
+		records.push_back(TilePyramidLevel{ (uint32_t)level.width, (uint32_t)level.height, (uint32_t)level.tilesX, (uint32_t)level.tilesY, level.firstTile });
+	}
+	uint64_t dataOffset = alignUp(sizeof(TilePyramidHeader) + records.size() * sizeof(TilePyramidLevel), 16);
+
+	// write to a temporary file first so a crash never leaves a half written pyramid behind
+	string pyramidFilename = tilePyramidPath(imageFilename);
+	string tempFilename = pyramidFilename + ".tmp";
+	try
+	{
+		ofstream out(tempFilename, ios::binary | ios::trunc);
+		if (!out.good()) throw invalid_argument("TilePyramid::can't create pyramid file");
+
+		static const char zeros[16] = {};
+		out.write((const char*)&header, sizeof(header));
+		out.write((const char*)records.data(), records.size() * sizeof(TilePyramidLevel));
+		out.write(zeros, (streamsize)(dataOffset - (uint64_t)out.tellp()));
+
+		size_t tileBytes = (size_t)header.tileBytes;
+		writeLevelTiles(out, pixels, nrComponents, levels[0], tileBytes, threads);
+		if (levels.size() > 1)
+		{
+			vector<unsigned char> level1 = boxFromSource(pixels, width, height, nrComponents, levels[1].width, levels[1].height);
+			stbi_image_free(pixels);
+			pixels = nullptr;
+
+			writeLevelTiles(out, level1.data(), 4, levels[1], tileBytes, threads);
+			if (levels.size() > 2)
+			{
+				// the chain runs down to 1x1, levels past the single tile one aren't stored
+				buildMipChain(level1.data(), levels[1].width, levels[1].height, 4, MipOptions(), threads,
+					[&](int level, const unsigned char* texels, int, int) {
+						if (level + 1 < (int)levels.size()) writeLevelTiles(out, texels, 4, levels[level + 1], tileBytes, threads);
+					});
+			}
+		}
+
+		if (!out.good()) throw invalid_argument("TilePyramid::fail writing pyramid file");
+	}
+	catch (...)
+	{
+		stbi_image_free(pixels);
+		error_code ec;
+		filesystem::remove(tempFilename, ec);
+		throw;
+	}
+	stbi_image_free(pixels);
+
+	error_code ec;
+	filesystem::rename(tempFilename, pyramidFilename, ec);
+	if (ec)
+	{
+		filesystem::remove(tempFilename, ec);
+		throw invalid_argument("TilePyramid::can't replace pyramid file");
+	}
+}
+
+bool acquireTilePyramid(const char* imageFilename, TilePyramid& outPyramid)
+{
+	if (loadTilePyramid(imageFilename, outPyramid)) return true;
+
+	try
+	{
+		buildTilePyramid(imageFilename);
+	}
+	catch (const std::exception& e)
+	{
+		cout << "Fail building tile pyramid: " << e.what() << endl;
+		return false;
+	}
+	return loadTilePyramid(imageFilename, outPyramid);
+}
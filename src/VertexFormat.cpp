@@ -0,0 +1,162 @@
+#include "VertexFormat.h"
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+// ================= layout ====================
+
+int vertexAttribSize(const VertexAttrib& attrib)
+{
+	switch (attrib.type)
+	{
+	case GL_FLOAT: return attrib.count * 4;
+	case GL_HALF_FLOAT:
+	case GL_UNSIGNED_SHORT:
+	case GL_SHORT: return attrib.count * 2;
+	case GL_UNSIGNED_BYTE:
+	case GL_BYTE: return attrib.count;
+	}
+	throw invalid_argument("vertexAttribSize : unsupported attribute type");
+}
+
+int vertexStride(const vector<VertexAttrib>& layout)
+{
+	int stride = 0;
+	for (const VertexAttrib& attrib : layout) stride += vertexAttribSize(attrib);
+	return stride;
+}
+
+
+// ================= conversion ====================
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	uint32_t mantissa = bits & 0x7fffff;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+
+	if ((bits & 0x7fffffff) >= 0x7f800000) return sign | 0x7c00 | (mantissa ? 0x200 : 0); // inf, nan
+	if (exponent >= 31) return sign | 0x7c00;
+
+	if (exponent <= 0)
+	{
+		// subnormal half
+		if (exponent < -10) return sign;
+		mantissa |= 0x800000;
+		int shift = 14 - exponent;
+		uint32_t half = mantissa >> shift;
+		uint32_t rest = mantissa & ((1u << shift) - 1);
+		uint32_t halfway = 1u << (shift - 1);
+		if (rest > halfway || (rest == halfway && (half & 1))) half++;
+		return sign | (uint16_t)half;
+	}
+
+	// a rounding carry into the exponent is still the correct result (up to infinity)
+	uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+	uint32_t rest = mantissa & 0x1fff;
+	if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++;
+	return sign | (uint16_t)half;
+}
+
+static int16_t toSnorm16(float value)
+{
+	value = value < -1.f ? -1.f : (value > 1.f ? 1.f : value);
+	return (int16_t)lroundf(value * 32767.f);
+}
+
+static uint16_t toUnorm16(float value)
+{
+	value = value < 0.f ? 0.f : (value > 1.f ? 1.f : value);
+	return (uint16_t)lroundf(value * 65535.f);
+}
+
+void octEncode(float x, float y, float z, int16_t out[2])
+{
+	// project on the octahedron |x| + |y| + |z| = 1, the lower half is folded over the diagonals
+	float l1 = fabsf(x) + fabsf(y) + fabsf(z);
+	if (l1 == 0.f)
+	{
+		out[0] = out[1] = 0;
+		return;
+	}
+
+	float px = x / l1;
+	float py = y / l1;
+	if (z < 0.f)
+	{
+		float fx = (1.f - fabsf(py)) * (px >= 0.f ? 1.f : -1.f);
+		float fy = (1.f - fabsf(px)) * (py >= 0.f ? 1.f : -1.f);
+		px = fx;
+		py = fy;
+	}
+	out[0] = toSnorm16(px);
+	out[1] = toSnorm16(py);
+}
+
+
+// ================= packing ====================
+
+PackedVertices packVertices(const vector<float>& vertices, bool floatPositions)
+{
+	const int floatStride = 8;
+	PackedVertices packed;
+	packed.vertexCount = vertices.size() / floatStride;
+
+	// uvs within a texel (of an 8k texture) outside [0, 1] are just export noise, they are clamped
+	const float uvTolerance = 1.f / 8192.f;
+	bool unormUV = true;
+	for (size_t i = 0; i < packed.vertexCount; i++)
+	{
+		float u = vertices[i * floatStride + 3];
+		float v = vertices[i * floatStride + 4];
+		if (u < -uvTolerance || u > 1.f + uvTolerance || v < -uvTolerance || v > 1.f + uvTolerance) unormUV = false;
+	}
+
+	packed.layout = {
+		floatPositions ? VertexAttrib{ 3, GL_FLOAT, false } : VertexAttrib{ 4, GL_HALF_FLOAT, false },
+		unormUV ? VertexAttrib{ 2, GL_UNSIGNED_SHORT, true } : VertexAttrib{ 2, GL_FLOAT, false },
+		VertexAttrib{ 2, GL_SHORT, true },
+	};
+	int stride = vertexStride(packed.layout);
+	packed.data.resize(packed.vertexCount * stride);
+
+	for (size_t i = 0; i < packed.vertexCount; i++)
+	{
+		const float* src = &vertices[i * floatStride];
+		uint8_t* dst = &packed.data[i * stride];
+
+		if (floatPositions)
+		{
+			memcpy(dst, src, 3 * sizeof(float));
+			dst += 3 * sizeof(float);
+		}
+		else
+		{
+			uint16_t position[4] = { floatToHalf(src[0]), floatToHalf(src[1]), floatToHalf(src[2]), floatToHalf(1.f) };
+			memcpy(dst, position, sizeof(position));
+			dst += sizeof(position);
+		}
+
+		if (unormUV)
+		{
+			uint16_t uv[2] = { toUnorm16(src[3]), toUnorm16(src[4]) };
+			memcpy(dst, uv, sizeof(uv));
+			dst += sizeof(uv);
+		}
+		else
+		{
+			memcpy(dst, &src[3], 2 * sizeof(float));
+			dst += 2 * sizeof(float);
+		}
+
+		int16_t normal[2];
+		octEncode(src[5], src[6], src[7], normal);
+		memcpy(dst, normal, sizeof(normal));
+	}
+	return packed;
+}
@@ -0,0 +1,464 @@
+#include "VirtualTexture.h"
+#include "CompressedTexture.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+
+static const size_t MAX_QUEUED_TILES = 64;	// read ahead of the uploads
+
+VirtualTextureSystem::VirtualTextureSystem(int viewportWidth, int viewportHeight, size_t budgetBytes, int feedbackDivisor)
+	: feedbackDivisor(max(1, feedbackDivisor))
+{
+	feedbackWidth = max(1, viewportWidth / this->feedbackDivisor);
+	feedbackHeight = max(1, viewportHeight / this->feedbackDivisor);
+	supported = compressedFormatSupported(BlockFormat::BC1);
+	if (!supported) return;
+
+	// a square grid of slots within the budget and the texture size limit
+	size_t tileBytes = compressedLevelSize(BlockFormat::BC1, TILE_SLOT_SIZE, TILE_SLOT_SIZE);
+	GLint maxTextureSize = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+	int maxSlotsPerSide = max(1, maxTextureSize / TILE_SLOT_SIZE);
+	size_t budgetSlots = max<size_t>(1, budgetBytes / tileBytes);
+	slotsPerRow = min(maxSlotsPerSide, max(1, (int)sqrt((double)budgetSlots)));
+	int slotRows = min(maxSlotsPerSide, max(1, (int)(budgetSlots / slotsPerRow)));
+	slots.resize((size_t)slotsPerRow * slotRows);
+	for (int i = (int)slots.size() - 1; i >= 0; i--) freeSlots.push_back(i);
+
+	int atlasWidth = slotsPerRow * TILE_SLOT_SIZE, atlasHeight = slotRows * TILE_SLOT_SIZE;
+	glGenTextures(1, &atlas);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glCompressedTexImage2D(GL_TEXTURE_2D, 0, compressedInternalFormat(BlockFormat::BC1), atlasWidth, atlasHeight, 0,
+		(GLsizei)compressedLevelSize(BlockFormat::BC1, atlasWidth, atlasHeight), nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	// feedback target, cleared to alpha 0 where nothing virtual textured is drawn
+	glGenFramebuffers(1, &feedbackFramebuffer);
+	glGenRenderbuffers(1, &feedbackColor);
+	glGenRenderbuffers(1, &feedbackDepth);
+	glBindRenderbuffer(GL_RENDERBUFFER, feedbackColor);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, feedbackWidth, feedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, feedbackWidth, feedbackHeight);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackColor);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		cout << "Virtual texture feedback framebuffer incomplete" << endl;
+		supported = false;
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	glGenBuffers(2, packBuffers);
+	for (GLuint buffer : packBuffers)
+	{
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+		glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)feedbackWidth * feedbackHeight * 4, nullptr, GL_STREAM_READ);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	worker = thread(&VirtualTextureSystem::work, this);
+}
+
+VirtualTextureSystem::~VirtualTextureSystem()
+{
+	{
+		lock_guard<std::mutex> lock(mutex);
+		running = false;
+	}
+	requestReady.notify_all();
+	if (worker.joinable()) worker.join();
+	for (unique_ptr<VirtualTexture>& texture : textures)
+	{
+		if (texture->opening.valid()) texture->opening.wait();
+	}
+}
+
+int VirtualTextureSystem::add(const string& imageFilename)
+{
+	error_code ec;
+	if (!supported || textures.size() >= MAX_VIRTUAL_TEXTURES || !filesystem::is_regular_file(imageFilename, ec)) return -1;
+
+	unique_ptr<VirtualTexture> texture = make_unique<VirtualTexture>();
+	VirtualTexture* opening = texture.get();
+	opening->path = imageFilename;
+	opening->opening = async(launch::async, [opening]() { return acquireTilePyramid(opening->path.c_str(), opening->pyramid); });
+	textures.push_back(move(texture));
+	return (int)textures.size() - 1;
+}
+
+bool VirtualTextureSystem::ready(int id) const
+{
+	return id >= 0 && id < (int)textures.size() && textures[id]->ready;
+}
+
+// level sizes, page table rows and atlas layout, for the virtual textured and the feedback shaders
+static void setLevelUniforms(GLuint program, const TilePyramid& pyramid, const vector<int>& pageRows, int slotsPerRow)
+{
+	GLfloat levels[MAX_TILE_LEVELS * 4] = {};
+	for (size_t i = 0; i < pyramid.levels.size(); i++)
+	{
+		levels[i * 4 + 0] = (GLfloat)pyramid.levels[i].width;
+		levels[i * 4 + 1] = (GLfloat)pyramid.levels[i].height;
+		levels[i * 4 + 2] = (GLfloat)pageRows[i];
+	}
+	glUniform4fv(glGetUniformLocation(program, "virtualLevels"), MAX_TILE_LEVELS, levels);
+	glUniform1i(glGetUniformLocation(program, "virtualLevelCount"), (GLint)pyramid.levels.size());
+	glUniform4f(glGetUniformLocation(program, "virtualLayout"), (GLfloat)TILE_SIZE, (GLfloat)TILE_BORDER, (GLfloat)slotsPerRow, 0.f);
+}
+
+void VirtualTextureSystem::bind(GLuint program, int id, int atlasUnit, int pageTableUnit) const
+{
+	const VirtualTexture& texture = *textures[id];
+	glActiveTexture(GL_TEXTURE0 + atlasUnit);
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glActiveTexture(GL_TEXTURE0 + pageTableUnit);
+	glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+	glActiveTexture(GL_TEXTURE0);
+
+	glUniform1i(glGetUniformLocation(program, "virtualTextured"), 1);
+	glUniform1i(glGetUniformLocation(program, "virtualAtlas"), atlasUnit);
+	glUniform1i(glGetUniformLocation(program, "virtualPageTable"), pageTableUnit);
+	setLevelUniforms(program, texture.pyramid, texture.pageRows, slotsPerRow);
+}
+
+void VirtualTextureSystem::beginFeedback()
+{
+	glGetIntegerv(GL_VIEWPORT, previousViewport);
+	glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+	glViewport(0, 0, feedbackWidth, feedbackHeight);
+	glClearColor(0.f, 0.f, 0.f, 0.f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+}
+
+void VirtualTextureSystem::setFeedbackUniforms(GLuint program, int id) const
+{
+	const VirtualTexture& texture = *textures[id];
+	setLevelUniforms(program, texture.pyramid, texture.pageRows, slotsPerRow);
+	glUniform1i(glGetUniformLocation(program, "virtualTextureId"), id);
+	// derivatives are feedbackDivisor times larger than on screen
+	glUniform1f(glGetUniformLocation(program, "virtualLodBias"), -log2f((float)feedbackDivisor));
+}
+
+void VirtualTextureSystem::endFeedback()
+{
+	// into the older pack buffer, whatever it held was parsed or is dropped
+	int index = nextPackBuffer;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[index]);
+	glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	if (packFences[index]) glDeleteSync(packFences[index]);
+	packFences[index] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	nextPackBuffer = 1 - index;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+}
+
+int VirtualTextureSystem::update(int uploadBudget)
+{
+	if (!supported) return 0;
+
+	for (size_t id = 0; id < textures.size(); id++)
+	{
+		VirtualTexture& texture = *textures[id];
+		if (!texture.opened && texture.opening.wait_for(chrono::seconds(0)) == future_status::ready) open((int)id);
+
+		// the coarsest tile, again if it found no free slot
+		if (texture.opened && !texture.ready && !texture.slots.empty() && !texture.pending.back()[0]) request((int)id, (int)texture.slots.size() - 1, 0, 0);
+	}
+
+	readFeedback();
+
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	int uploaded = 0;
+	while (uploaded < uploadBudget)
+	{
+		LoadedTile tile;
+		{
+			lock_guard<std::mutex> lock(mutex);
+			if (loaded.empty()) break;
+			tile = move(loaded.front());
+			loaded.pop_front();
+			outstanding--;
+		}
+		if (upload(tile)) uploaded++;
+	}
+
+	for (unique_ptr<VirtualTexture>& texture : textures)
+	{
+		if (texture->ready && texture->dirty) updatePageTable(*texture);
+	}
+	return uploaded;
+}
+
+size_t VirtualTextureSystem::residentTiles() const
+{
+	return resident;
+}
+
+size_t VirtualTextureSystem::slotCount() const
+{
+	return slots.size();
+}
+
+void VirtualTextureSystem::work()
+{
+	while (true)
+	{
+		TileRequest request;
+		{
+			unique_lock<std::mutex> lock(mutex);
+			requestReady.wait(lock, [&]() { return !running || !requests.empty(); });
+			if (!running) return;
+			request = requests.front();
+			requests.pop_front();
+		}
+
+		// the copy faults the mapped pages in here instead of on the render thread
+		LoadedTile tile{ request.texture, request.level, request.x, request.y, {} };
+		const unsigned char* blocks = request.pyramid->tile(request.level, request.x, request.y);
+		tile.blocks.assign(blocks, blocks + request.pyramid->tileBytes);
+
+		lock_guard<std::mutex> lock(mutex);
+		loaded.push_back(move(tile));
+	}
+}
+
+// sets up the residency and page table of a pyramid that finished opening
+void VirtualTextureSystem::open(int id)
+{
+	VirtualTexture& texture = *textures[id];
+	texture.opened = true;
+	if (!texture.opening.get())
+	{
+		cout << "Virtual texture failed to load at path: " << texture.path << endl;
+		return;
+	}
+
+	const TilePyramid& pyramid = texture.pyramid;
+	int pageRows = 0;
+	for (const TileLevel& level : pyramid.levels)
+	{
+		texture.pageRows.push_back(pageRows);
+		pageRows += level.tilesY;
+		texture.slots.emplace_back((size_t)level.tilesX * level.tilesY, -1);
+		texture.pending.emplace_back((size_t)level.tilesX * level.tilesY, 0);
+	}
+
+	glGenTextures(1, &texture.pageTable);
+	glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16UI, pyramid.levels[0].tilesX, pageRows, 0, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, nullptr);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	cout << "Virtual Texture: " << texture.path << " (" << pyramid.width << "x" << pyramid.height << ", "
+		<< pyramid.tileCount() << " tiles in " << pyramid.levels.size() << " levels)" << endl;
+}
+
+// feedback of two frames ago, if the gpu is done with it
+void VirtualTextureSystem::readFeedback()
+{
+	int index = nextPackBuffer;
+	if (!packFences[index]) return;
+	GLenum status = glClientWaitSync(packFences[index], 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return;
+	glDeleteSync(packFences[index]);
+	packFences[index] = nullptr;
+
+	// r: tile x, g: tile y, b: texture id * 16 + level, a: 0 where nothing was drawn
+	vector<uint32_t> keys;
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, packBuffers[index]);
+	size_t size = (size_t)feedbackWidth * feedbackHeight * 4;
+	const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)size, GL_MAP_READ_BIT);
+	if (pixels)
+	{
+		for (size_t i = 0; i < size; i += 4)
+		{
+			if (pixels[i + 3] == 0) continue;
+			keys.push_back((uint32_t)pixels[i + 2] << 16 | (uint32_t)pixels[i + 1] << 8 | pixels[i]);
+		}
+		glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+	}
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	sort(keys.begin(), keys.end());
+	keys.erase(unique(keys.begin(), keys.end()), keys.end());
+	feedbackFrame++;
+
+	// needed tiles and every ancestor are touched, missing ones collected once
+	struct Missing { int texture, level, x, y; };
+	vector<Missing> missing;
+	for (uint32_t key : keys)
+	{
+		int id = (int)(key >> 20), level = (int)(key >> 16) & 15, x = (int)(key & 255), y = (int)(key >> 8) & 255;
+		if (!ready(id)) continue;
+		VirtualTexture& texture = *textures[id];
+		const vector<TileLevel>& levels = texture.pyramid.levels;
+		if (level >= (int)levels.size() || x >= levels[level].tilesX || y >= levels[level].tilesY) continue;
+
+		for (; level < (int)levels.size(); level++)
+		{
+			size_t index = (size_t)y * levels[level].tilesX + x;
+			int slot = texture.slots[level][index];
+			if (slot >= 0)
+			{
+				if (slots[slot].lastUsed == feedbackFrame) break;	// ancestors are touched already
+				slots[slot].lastUsed = feedbackFrame;
+			}
+			else if (!texture.pending[level][index])
+			{
+				texture.pending[level][index] = 1;
+				missing.push_back(Missing{ id, level, x, y });
+			}
+
+			if (level + 1 < (int)levels.size())
+			{
+				x = min(x / 2, levels[level + 1].tilesX - 1);
+				y = min(y / 2, levels[level + 1].tilesY - 1);
+			}
+		}
+	}
+
+	// coarsest first, a tile never waits behind the finer ones it stands in for
+	stable_sort(missing.begin(), missing.end(), [](const Missing& a, const Missing& b) { return a.level > b.level; });
+	size_t queued;
+	{
+		lock_guard<std::mutex> lock(mutex);
+		queued = outstanding;
+	}
+	for (const Missing& tile : missing)
+	{
+		if (queued < MAX_QUEUED_TILES)
+		{
+			request(tile.texture, tile.level, tile.x, tile.y);
+			queued++;
+		}
+		else
+		{
+			// asked for again by a later feedback
+			VirtualTexture& texture = *textures[tile.texture];
+			texture.pending[tile.level][(size_t)tile.y * texture.pyramid.levels[tile.level].tilesX + tile.x] = 0;
+		}
+	}
+}
+
+void VirtualTextureSystem::request(int id, int level, int x, int y)
+{
+	VirtualTexture& texture = *textures[id];
+	texture.pending[level][(size_t)y * texture.pyramid.levels[level].tilesX + x] = 1;
+	{
+		lock_guard<std::mutex> lock(mutex);
+		requests.push_back(TileRequest{ id, level, x, y, &texture.pyramid });
+		outstanding++;
+	}
+	requestReady.notify_one();
+}
+
+// false if every slot holds a tile the last feedback asked for
+bool VirtualTextureSystem::upload(LoadedTile& tile)
+{
+	VirtualTexture& texture = *textures[tile.texture];
+	const vector<TileLevel>& levels = texture.pyramid.levels;
+	size_t index = (size_t)tile.y * levels[tile.level].tilesX + tile.x;
+	texture.pending[tile.level][index] = 0;
+
+	int slot = allocateSlot();
+	if (slot < 0) return false;
+
+	Slot& target = slots[slot];
+	if (target.texture >= 0)
+	{
+		VirtualTexture& evicted = *textures[target.texture];
+		evicted.slots[target.level][(size_t)target.y * evicted.pyramid.levels[target.level].tilesX + target.x] = -1;
+		evicted.dirty = true;
+		resident--;
+	}
+	target.texture = tile.texture;
+	target.level = tile.level;
+	target.x = tile.x;
+	target.y = tile.y;
+	target.lastUsed = feedbackFrame;
+	target.pinned = tile.level == (int)levels.size() - 1;
+	texture.slots[tile.level][index] = slot;
+	texture.dirty = true;
+	resident++;
+	if (target.pinned) texture.ready = true;
+
+	glBindTexture(GL_TEXTURE_2D, atlas);
+	glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, (slot % slotsPerRow) * TILE_SLOT_SIZE, (slot / slotsPerRow) * TILE_SLOT_SIZE, TILE_SLOT_SIZE, TILE_SLOT_SIZE,
+		compressedInternalFormat(BlockFormat::BC1), (GLsizei)tile.blocks.size(), tile.blocks.data());
+	return true;
+}
+
+// a free slot, or the least recently used one the last feedback didn't ask for, -1 if there is none
+int VirtualTextureSystem::allocateSlot()
+{
+	if (!freeSlots.empty())
+	{
+		int slot = freeSlots.back();
+		freeSlots.pop_back();
+		return slot;
+	}
+
+	int victim = -1;
+	uint64_t oldest = feedbackFrame;
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		if (!slots[i].pinned && slots[i].lastUsed < oldest)
+		{
+			oldest = slots[i].lastUsed;
+			victim = (int)i;
+		}
+	}
+	return victim;
+}
+
+// every tile points at its own slot or at the one its parent points at, coarsest level first
+void VirtualTextureSystem::updatePageTable(VirtualTexture& texture)
+{
+	const vector<TileLevel>& levels = texture.pyramid.levels;
+	int width = levels[0].tilesX;
+	int rows = texture.pageRows.back() + levels.back().tilesY;
+	vector<uint16_t> entries((size_t)width * rows * 4, 0);
+
+	for (int level = (int)levels.size() - 1; level >= 0; level--)
+	{
+		const TileLevel& l = levels[level];
+		for (int y = 0; y < l.tilesY; y++)
+		{
+			for (int x = 0; x < l.tilesX; x++)
+			{
+				uint16_t* entry = &entries[((size_t)(texture.pageRows[level] + y) * width + x) * 4];
+				int slot = texture.slots[level][(size_t)y * l.tilesX + x];
+				if (slot >= 0)
+				{
+					entry[0] = (uint16_t)slot;
+					entry[1] = (uint16_t)level;
+					entry[2] = (uint16_t)x;
+					entry[3] = (uint16_t)y;
+				}
+				else if (level + 1 < (int)levels.size())
+				{
+					const TileLevel& parent = levels[level + 1];
+					int parentX = min(x / 2, parent.tilesX - 1), parentY = min(y / 2, parent.tilesY - 1);
+					memcpy(entry, &entries[((size_t)(texture.pageRows[level + 1] + parentY) * width + parentX) * 4], 4 * sizeof(uint16_t));
+				}
+			}
+		}
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture.pageTable);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, rows, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT, entries.data());
+	texture.dirty = false;
+}
@@ -7,12 +7,31 @@
 #include <iostream>
 #include <sstream>
 #include <future>
+#include <functional>
+#include <memory>
+#include <algorithm>
 #include <vector>
 #include <map>
+#include <filesystem>
+#include <cfloat>
 #include <stdlib.h>
 #include "shader.h"
 #include "window.h"
 #include "ModelReader.h"
+#include "ModelBuffer.h"
+#include "MaterialLibrary.h"
+#include "GlbReader.h"
+#include "HotReloader.h"
+#include "CompressedTexture.h"
+#include "DecodedTextureCache.h"
+#include "TextureStreamer.h"
+#include "VirtualTexture.h"
+#include "NumberParser.h"
+#include "ObjBenchmark.h"
+#include "TextureBenchmark.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "VertexFormat.h"
 #include "shapes.h"
 #include "OrbitAnimator.h"
 #include "SceneState.h"
@@ -23,21 +42,86 @@
 
 using namespace std;
 
+// index range of one lod inside a mesh's element buffer
+struct LodRange
+{
+	int indexCount;
+	size_t firstIndex;
+	float error;	// relative to the mesh radius
+};
+
+// gpu side of an obj file, every sub object packed into one vertex/index buffer (see ModelBuffer.h)
+struct ObjModel
+{
+	unsigned int VAO = 0, VBO = 0, EBO = 0;
+	GLenum indexType = GL_UNSIGNED_INT;
+	vector<DrawRange> materialRanges;	// one draw per material
+	vector<int> materialIds;			// ModelBuffer material -> materialLibrary id
+	glm::vec3 center{ 0.f };			// of the bounding box
+	float radius = 0.f;					// half its diagonal
+};
+
+// gpu side of a glb file (see GlbReader.h), the binary chunk is one buffer shared by every primitive
+struct GlbModel
+{
+	unsigned int buffer = 0;
+	vector<vector<unsigned int>> primitiveVAOs;	// per mesh, per primitive
+	vector<int> materialIds;					// gltf material -> materialLibrary id
+	glm::vec3 center{ 0.f };					// of the default scene's bounding box
+	float radius = 0.f;
+};
+
+// virtual textured body drawn this frame, drawn again into the feedback pass (see VirtualTexture.h)
+struct VirtualDraw
+{
+	glm::mat4 model;
+	unsigned int VAO;
+	GLenum indexType;
+	LodRange lod;
+	int id;
+};
+
 // ======================= prototype =======================
 
 // load function
 unsigned int loadCubemap(vector<string> filename);
 unsigned int loadTexture(const char* filename);
+unsigned int loadTextureFromMemory(const unsigned char* bytes, size_t size);
+unsigned int uploadTexture(const DecodedTexture& texture, const char* path, unsigned int textureID = 0);
+unsigned int uploadCompressedTexture(const CompressedTexture& texture, const char* path, unsigned int textureID = 0);
+bool blockCompressionSupported();
+void uploadCubemap(unsigned int textureID, vector<DecodedTexture>& faceTextures, const vector<string>& faces);
+
+// hot reload, the gl objects keep their names so nothing referencing them has to change
+void watchTexture(HotReloader& reloader, const TextureStreamer& streamer, GLuint texture, const string& path, const MipOptions& mips = MipOptions());
+void watchCubemap(HotReloader& reloader, GLuint texture, const vector<string>& faces);
+void watchShader(HotReloader& reloader, unsigned int& shaderProgram, const string& vertexShaderFile, const string& fragmentShaderFile, const string& fragmentLibraryFile = "");
+void watchMesh(HotReloader& reloader, ObjModel& model, MaterialLibrary& materialLibrary, const string& path);
+void watchMesh(HotReloader& reloader, GlbModel& model, GlbFileData& data, MaterialLibrary& materialLibrary, const string& path);
 
 // opengl helper
 void glSetupVertexObject(unsigned int& VAO, unsigned int& VBO, vector<float>& data, vector<int> attribLayout);
+void glSetupVertexObject(unsigned int& VAO, unsigned int& VBO, const void* data, size_t dataSize, const vector<VertexAttrib>& attribLayout);
+GLenum glSetupVertexObject(unsigned int& VAO, unsigned int& VBO, unsigned int& EBO, PackedVertices& vertices, vector<unsigned int>& indices);
 void glDrawVertexTriangles(unsigned int VAO, GLuint texture, int numberOfVertex);
+void glDrawIndexedTriangles(unsigned int VAO, GLuint texture, int numberOfIndices, GLenum indexType, size_t firstIndex);
+void glSetupObjModel(ObjModel& model, const ObjectFileData& data, MaterialLibrary& materialLibrary);
+void glDrawModel(const ObjModel& model, const MaterialLibrary& materialLibrary, unsigned int shaderProgram);
+void glSetupGlbModel(GlbModel& model, const GlbFileData& data, MaterialLibrary& materialLibrary);
+void glDrawGlbModel(const GlbModel& model, const GlbFileData& data, const MaterialLibrary& materialLibrary, glm::mat4 transform, unsigned int shaderProgram);
 void glSetModelViewProjection(unsigned int shaderProgram, glm::mat4 model, glm::mat4 view, glm::mat4 projection);
 void glSetLightingConfig(unsigned int shaderProgram, glm::vec3 lightPos, Camera camPos, int torch, Gui& gui);
+void glSetLightingConfig(unsigned int shaderProgram, glm::vec3 lightPos, Camera camPos, int torch, glm::vec3 lightColor, float ambientStrength);
 
 // helper
 glm::vec3 vecToVec3(vector<float> vec);
 vector<float> vec3ToVec(glm::vec3 vec3);
+void printPackedVertexStats(const char* name, vector<float>& vertices, vector<unsigned int>& indices, PackedVertices& packed);
+vector<LodRange> appendShapeLevels(vector<float>& vertices, vector<unsigned int>& indices, int levelCount, function<const ShapeMesh& (int)> getLevel);
+int selectLod(const vector<LodRange>& lods, float radius, glm::vec3 center, glm::mat4 view, float fov, int viewportHeight);
+
+// obj/glb model viewer (--view-model), returns the exit code
+int viewModel(const string& path);
 
 // opengl code dump
 void displayLoadingScreen(GLFWwindow* window);
@@ -50,12 +134,18 @@ void displaySkyBox(unsigned int& VAO, GLuint texture, unsigned int shaderProgram
 int WINDOW_WIDTH = 1280;
 int WINDOW_HEIGHT = 800;
 const char* WINDOW_TITLE = "3D Solar System";
+float LOD_PIXEL_ERROR = 1.f;	// largest on screen geometric error of the chosen lod
+const char* VIRTUAL_TEXTURE_SHADER = "src/shaders/virtual_texture.frag";	// shared by the textured body and feedback fragment shaders
 
 
 // scene 
 int sunIdx = 0;		// THIS MUST BE CHANGED WHENEVER THE CONFIGURATION MATRIX IS CHANGED
 int earthIdx = 3;   // THIS MUST BE CHANGED WHENEVER THE CONFIGURATION MATRIX IS CHANGED
 float earthOrbitDelay = 3600;
+float SPHERE_OBJECT_RADIUS = 2;		// 3d vertex sphere radius (do not change)
+float SATURN_RING_RADII[2] = { 3.05f, 4.29f };	// inner/outer ring radius in sphere units (do not change)
+float URANUS_RING_RADII[2] = { 3.77f, 3.89f };
+float RING_THICKNESS = 0.06f;
 glm::vec3 lightPos = glm::vec3(0.0f, 0.0f, 0.0f);
 PlanetMath planetMath;
 vector<RenderedBody> renderedBodies;
@@ -65,11 +155,199 @@ vector<OrbitAnimator> animators;
 
 SceneState sceneState;
 Camera camera(WINDOW_WIDTH, WINDOW_HEIGHT);
+DecodedTextureCache textureCache;	// decoded texels of textures and cubemap faces, see DecodedTextureCache.h
 
 // ==================== main =======================
 
 int main(int argc, char** argv)
 {
+	// number parsing microbenchmark, no window
+	if (argc > 1 && string(argv[1]) == "--bench-parse")
+	{
+		NumberParserBenchmark bench = benchmarkNumberParser(4000000);
+		cout << "Parsed " << bench.values << " values: " << bench.fastMBps << " MB/s (from_chars "
+			<< bench.fromCharsMBps << " MB/s), " << bench.mismatches << " mismatches against strtof" << endl;
+		return bench.mismatches == 0 ? 0 : 1;
+	}
+
+	// readObj before/after the memory mapped parser on the shipped models and a generated one, no window
+	// --bench-parsers [megabytes]
+	if (argc > 1 && string(argv[1]) == "--bench-parsers")
+	{
+		ObjBenchmarkConfig config;
+		config.megaBytes = argc > 2 ? atof(argv[2]) : 100.0;
+		if (config.megaBytes <= 0.0)
+		{
+			cout << "usage: --bench-parsers [megabytes]" << endl;
+			return 1;
+		}
+
+		SyntheticObjAsset synthetic = generateSyntheticObj(config);
+		vector<string> files = { "assets/sphere/sphere.obj", "assets/saturn_ring/ring_huge.obj", "assets/uranus_ring/ring_small.obj",
+			synthetic.objFilename };
+		vector<ObjParserComparison> comparisons;
+		for (const string& file : files) comparisons.push_back(compareObjParsers(file));
+		remove(synthetic.objFilename.c_str());
+		remove(synthetic.mtlFilename.c_str());
+
+		bool sameData = true;
+		cout << endl;
+		for (const ObjParserComparison& comparison : comparisons)
+		{
+			cout << comparison.filename << " (" << comparison.bytes / 1024 << " KB): " << comparison.legacyMBps << " MB/s -> "
+				<< comparison.currentMBps << " MB/s (x" << comparison.legacySeconds / comparison.currentSeconds << ")"
+				<< (comparison.sameData ? "" : ", DIFFERENT DATA") << endl;
+			sameData = sameData && comparison.sameData;
+		}
+		return sameData ? 0 : 1;
+	}
+
+	// obj line keyword classification microbenchmark, no window
+	// --bench-keywords [tokens]
+	if (argc > 1 && string(argv[1]) == "--bench-keywords")
+	{
+		size_t tokens = argc > 2 ? (size_t)atof(argv[2]) : 10000000;
+		KeywordBenchmark bench = benchmarkKeywordClassifier(tokens);
+		cout << "Classified " << bench.tokens << " keywords: " << bench.switchMtokps << " Mtok/s (std::map "
+			<< bench.mapMtokps << " Mtok/s), " << bench.mismatches << " mismatches" << endl;
+		return bench.mismatches == 0 ? 0 : 1;
+	}
+
+	// obj reader throughput on a generated asset, no window
+	// --bench-obj [megabytes] [v|vt|vn|vtvn] [json output]
+	if (argc > 1 && string(argv[1]) == "--bench-obj")
+	{
+		ObjBenchmarkConfig config;
+		if (argc > 2) config.megaBytes = atof(argv[2]);
+		if (argc > 3) config.faceType = faceTypeFromName(argv[3]);
+		string jsonFilename = argc > 4 ? argv[4] : "obj_benchmark.json";
+		if (config.megaBytes <= 0.0 || config.faceType == FaceType::NO_TYPE)
+		{
+			cout << "usage: --bench-obj [megabytes] [v|vt|vn|vtvn] [json output]" << endl;
+			return 1;
+		}
+
+		ObjBenchmarkResult bench = benchmarkObjReader(config);
+		cout << "\nreadObj: " << bench.readObj.megaBytesPerSecond << " MB/s, " << bench.readObj.linesPerSecond << " lines/s" << endl;
+		cout << "expandVertices: " << bench.expandVertices.seconds * 1000.0 << " ms" << endl;
+		cout << "readMtl: " << bench.readMtl.megaBytesPerSecond << " MB/s, " << bench.readMtl.linesPerSecond << " lines/s" << endl;
+		cout << "allocations per read: " << bench.allocations << endl;
+		cout << "peak RSS: " << bench.peakResidentBytes / (1024 * 1024) << " MB" << endl;
+
+		ofstream json(jsonFilename);
+		json << objBenchmarkJson(bench);
+		cout << "results written to " << jsonFilename << endl;
+		return json ? 0 : 1;
+	}
+
+	// parsing a well formed obj must not allocate per line, no window
+	// --check-allocs [megabytes]
+	if (argc > 1 && string(argv[1]) == "--check-allocs")
+	{
+		ObjBenchmarkConfig config;
+		config.megaBytes = argc > 2 ? atof(argv[2]) : 4.0;
+		if (config.megaBytes <= 0.0)
+		{
+			cout << "usage: --check-allocs [megabytes]" << endl;
+			return 1;
+		}
+
+		ObjAllocationCheck check = checkParseAllocations(config);
+		cout << "stream: " << check.streamSmall << " allocations for " << check.smallLines << " lines, "
+			<< check.streamLarge << " for " << check.largeLines << endl;
+		cout << "read: " << check.readSmall << " allocations for " << check.smallLines << " lines, "
+			<< check.readLarge << " for " << check.largeLines << endl;
+		cout << (check.passed ? "no per line allocations" : "FAILED: allocations grow with the line count") << endl;
+		return check.passed ? 0 : 1;
+	}
+
+	// parsing with several threads must give what one thread gives, no window
+	// --check-threads [megabytes] [threads]
+	if (argc > 1 && string(argv[1]) == "--check-threads")
+	{
+		ObjBenchmarkConfig config;
+		config.megaBytes = argc > 2 ? atof(argv[2]) : 16.0;
+		config.threads = argc > 3 ? (unsigned int)atoi(argv[3]) : 0;
+		if (config.megaBytes <= 0.0)
+		{
+			cout << "usage: --check-threads [megabytes] [threads]" << endl;
+			return 1;
+		}
+
+		bool passed = true;
+		for (const ObjThreadCheck& check : checkParseThreads(config))
+		{
+			cout << check.filename << ": " << check.serialSubObjects << " sub objects with 1 thread, " << check.parallelSubObjects
+				<< " with " << check.threads << (check.same ? ", same data" : ", FAILED: different data") << endl;
+			passed = passed && check.same;
+		}
+		return passed ? 0 : 1;
+	}
+
+	// startup cost of the scene's images, decode only against a cold and a warm texture cache, no window
+	// --bench-textures [json output]
+	if (argc > 1 && string(argv[1]) == "--bench-textures")
+	{
+		string jsonFilename = argc > 2 ? argv[2] : "texture_benchmark.json";
+		TextureBenchmarkResult bench = benchmarkTextureCache(TextureBenchmarkConfig());
+		cout << bench.images << " images, " << bench.sourceBytes / (1024 * 1024) << " MB of jpg/png, "
+			<< bench.cacheBytes / (1024 * 1024) << " MB of cache entries" << endl;
+		cout << "decode only: " << bench.decodeSeconds << " s" << endl;
+		cout << "cold cache: " << bench.coldSeconds << " s" << endl;
+		cout << "warm cache: " << bench.warmSeconds << " s" << endl;
+
+		ofstream json(jsonFilename);
+		json << textureBenchmarkJson(bench);
+		cout << "results written to " << jsonFilename << endl;
+		return json && bench.failed == 0 ? 0 : 1;
+	}
+
+	// cpu mip chains of one image with every filter against glGenerateMipmap, the gl part needs a window
+	// --bench-mips [image] [json output]
+	if (argc > 1 && string(argv[1]) == "--bench-mips")
+	{
+		MipBenchmarkConfig config;
+		if (argc > 2) config.image = argv[2];
+		string jsonFilename = argc > 3 ? argv[3] : "mip_benchmark.json";
+		GLFWwindow* window = createWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE);
+		bool withGl = window && gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+		MipBenchmarkResult bench = benchmarkMipChain(config, withGl);
+		glfwTerminate();
+		if (bench.width == 0)
+		{
+			cout << "can't decode " << config.image << endl;
+			return 1;
+		}
+
+		cout << config.image << " " << bench.width << "x" << bench.height << endl;
+		for (const MipFilterTiming& timing : bench.cpu)
+		{
+			cout << mipFilterName(timing.filter) << (timing.srgb ? " srgb" : " linear") << ", " << timing.threads
+				<< (timing.threads == 1 ? " thread: " : " threads: ") << timing.seconds << " s" << endl;
+		}
+		if (bench.gl)
+		{
+			cout << "glGenerateMipmap: " << bench.generateMipmapSeconds << " s" << endl;
+			cout << "upload of the cpu levels: " << bench.uploadLevelsSeconds << " s" << endl;
+		}
+
+		ofstream json(jsonFilename);
+		json << mipBenchmarkJson(bench);
+		cout << "results written to " << jsonFilename << endl;
+		return json ? 0 : 1;
+	}
+
+	// one model lit like the planets on a turntable, for artists checking their exports
+	// --view-model <model.obj|model.glb>
+	if (argc > 1 && string(argv[1]) == "--view-model")
+	{
+		if (argc < 3)
+		{
+			cout << "usage: --view-model <model.obj|model.glb>" << endl;
+			return 1;
+		}
+		return viewModel(argv[2]);
+	}
 
 	// ======================= SETUP ======================	
 
@@ -89,37 +367,40 @@ int main(int argc, char** argv)
 
 	// ========= load objects =========
 
-	ObjFileReader ofr;
-	ObjectFileData sphereObj, ufoObj, rocket2Obj, saturnRingObj, uranusRingObj, astroid1Obj,
-		commandModuleObj, electronRocketObj, satelite1Obj, superHeavyRocketObj;
-	cout << "Loading Objects...\n";
-	try
-	{
-		sphereObj = ofr.read("assets/sphere/sphere.obj");
-		saturnRingObj = ofr.read("assets/saturn_ring/ring_huge.obj");
-		uranusRingObj = ofr.read("assets/uranus_ring/ring_small.obj");
-
-	}
-	catch (const std::exception& e)
-	{
-		cerr << "Fail to load object file\n";
-		cerr << e.what() << endl;
-		return -1;
-	}
+	// bodies and rings are procedural, every tessellation level of a shape goes into one buffer (finest first)
+	cout << "Generating Objects...\n";
 	vector<float> skyboxVert = getSkyboxCube();
-	vector<float>& sphereVert = sphereObj.subObjects[0].expandedVertices;
-	vector<float>& saturnRingVert = saturnRingObj.subObjects[0].expandedVertices;
-	vector<float>& uranusRingVert = uranusRingObj.subObjects[0].expandedVertices;
-	cout << "Objects Loaded\n\n";
+	vector<float> sphereVert, saturnRingVert, uranusRingVert;
+	vector<unsigned int> sphereIdx, saturnRingIdx, uranusRingIdx;
+	vector<LodRange> sphereLods = appendShapeLevels(sphereVert, sphereIdx, SPHERE_LEVEL_COUNT, [](int level) -> const ShapeMesh& {
+		return getSphereLevel(SphereType::UV, level, SPHERE_OBJECT_RADIUS);
+	});
+	vector<LodRange> saturnRingLods = appendShapeLevels(saturnRingVert, saturnRingIdx, RING_LEVEL_COUNT, [](int level) -> const ShapeMesh& {
+		return getRingLevel(level, SATURN_RING_RADII[0], SATURN_RING_RADII[1], RING_THICKNESS);
+	});
+	vector<LodRange> uranusRingLods = appendShapeLevels(uranusRingVert, uranusRingIdx, RING_LEVEL_COUNT, [](int level) -> const ShapeMesh& {
+		return getRingLevel(level, URANUS_RING_RADII[0], URANUS_RING_RADII[1], RING_THICKNESS);
+	});
+	cout << "Objects Generated\n\n";
+
+	// quantize vertices for the gpu (see VertexFormat.h)
+	PackedVertices spherePacked = packVertices(sphereVert);
+	PackedVertices saturnRingPacked = packVertices(saturnRingVert);
+	PackedVertices uranusRingPacked = packVertices(uranusRingVert);
+	printPackedVertexStats("sphere", sphereVert, sphereIdx, spherePacked);
+	printPackedVertexStats("saturn ring", saturnRingVert, saturnRingIdx, saturnRingPacked);
+	printPackedVertexStats("uranus ring", uranusRingVert, uranusRingIdx, uranusRingPacked);
+	cout << endl;
 
 
 	// ======== load shaders =========
 
 	cout << "Loading Shaders...\n";
-	unsigned int illumShaderProgram = LoadShader("src/shaders/illuminated.vert", "src/shaders/illuminated.frag");
-	unsigned int earthShaderProgram = LoadShader("src/shaders/earth.vert", "src/shaders/earth.frag");
+	unsigned int illumShaderProgram = LoadShader("src/shaders/illuminated.vert", "src/shaders/illuminated.frag", VIRTUAL_TEXTURE_SHADER);
+	unsigned int earthShaderProgram = LoadShader("src/shaders/earth.vert", "src/shaders/earth.frag", VIRTUAL_TEXTURE_SHADER);
 	unsigned int basicShaderProgram = LoadShader("src/shaders/basic.vert", "src/shaders/basic.frag");
 	unsigned int skyShaderProgram = LoadShader("src/shaders/sky.vert", "src/shaders/sky.frag");
+	unsigned int feedbackShaderProgram = LoadShader("src/shaders/illuminated.vert", "src/shaders/feedback.frag", VIRTUAL_TEXTURE_SHADER);
 	cout << "Shaders Loaded\n\n";
 
 	vector<unsigned int> shaders{
@@ -131,23 +412,39 @@ int main(int argc, char** argv)
 
 	// ======= load all textures =======
 
+	// planet textures are decoded in the background and uploaded between frames (see TextureStreamer.h),
+	// bodies are drawn with a placeholder until theirs is resident. requests decode in order, so the 8k
+	// night map comes last
+	TextureStreamer textureStreamer(&textureCache);
+	const unsigned char noOverlay[4] = { 0, 0, 0, 0 };	// no clouds, no city lights
+	MipOptions ringMips;
+	ringMips.alphaCoverage = 0.3f;	// the ring shader's alpha segmentation threshold
+	GLuint sunTexture = textureStreamer.request("assets/textures/2k_sun.jpg");
+	GLuint mercuryTexture = textureStreamer.request("assets/textures/2k_mercury.jpg");
+	GLuint venusTexture = textureStreamer.request("assets/textures/2k_venus_surface.jpg");
+	//GLuint venusAtmosphereTexture = textureStreamer.request("assets/textures/2k_venus_atmosphere.jpg");
+	GLuint earthTexture = textureStreamer.request("assets/textures/2k_earth_daymap.jpg");
+	GLuint earthCloudsTexture = textureStreamer.request("assets/textures/2k_earth_clouds.jpg", noOverlay);
+	GLuint moonTexture = textureStreamer.request("assets/textures/2k_moon.jpg");
+	GLuint marsTexture = textureStreamer.request("assets/textures/2k_mars.jpg");
+	GLuint jupiterTexture = textureStreamer.request("assets/textures/2k_jupiter.jpg");
+	GLuint saturnTexture = textureStreamer.request("assets/textures/2k_saturn.jpg");
+	GLuint saturnRingTexture = textureStreamer.request("assets/textures/saturn_ring_2.png", nullptr, ringMips);
+	GLuint uranusTexture = textureStreamer.request("assets/textures/2k_uranus.jpg");
+	GLuint uranusRingTexture = textureStreamer.request("assets/textures/uranus_ring_2.png", nullptr, ringMips);
+	GLuint neptuneTexture = textureStreamer.request("assets/textures/2k_neptune.jpg");
+	GLuint plutoTexture = textureStreamer.request("assets/textures/pluto.jpg");
+	GLuint earthNightTexture = textureStreamer.request("assets/textures/8k_earth_nightmap.jpg", noOverlay);
+
+	// surface maps too large for one texture (16k, 32k) are optional, dropped into assets/textures/virtual.
+	// their tile pyramids are built on first run, the 2k maps above are drawn until the coarsest tile is in
+	VirtualTextureSystem virtualTextures(WINDOW_WIDTH, WINDOW_HEIGHT);
+	int earthVirtual = virtualTextures.add("assets/textures/virtual/earth_daymap.jpg");
+	int marsVirtual = virtualTextures.add("assets/textures/virtual/mars.jpg");
+	int moonVirtual = virtualTextures.add("assets/textures/virtual/moon.jpg");
+	vector<VirtualDraw> virtualDraws;
+
 	cout << "Loading Textures...\n";
-	GLuint sunTexture = loadTexture("assets/textures/2k_sun.jpg");
-	GLuint mercuryTexture = loadTexture("assets/textures/2k_mercury.jpg");
-	GLuint venusTexture = loadTexture("assets/textures/2k_venus_surface.jpg");
-	//GLuint venusAtmosphereTexture = loadTexture("assets/textures/2k_venus_atmosphere.jpg");
-	GLuint earthTexture = loadTexture("assets/textures/2k_earth_daymap.jpg");
-	GLuint earthNightTexture = loadTexture("assets/textures/8k_earth_nightmap.jpg");
-	GLuint earthCloudsTexture = loadTexture("assets/textures/2k_earth_clouds.jpg");
-	GLuint moonTexture = loadTexture("assets/textures/2k_moon.jpg");
-	GLuint marsTexture = loadTexture("assets/textures/2k_mars.jpg");
-	GLuint jupiterTexture = loadTexture("assets/textures/2k_jupiter.jpg");
-	GLuint saturnTexture = loadTexture("assets/textures/2k_saturn.jpg");
-	GLuint saturnRingTexture = loadTexture("assets/textures/saturn_ring_2.png");
-	GLuint uranusTexture = loadTexture("assets/textures/2k_uranus.jpg");
-	GLuint uranusRingTexture = loadTexture("assets/textures/uranus_ring_2.png");
-	GLuint neptuneTexture = loadTexture("assets/textures/2k_neptune.jpg");
-	GLuint plutoTexture = loadTexture("assets/textures/pluto.jpg");
 
 	std::vector<std::string> skyboxNames = { "black", "blue", "colorful","grayscale" ,"milkyway","red" };
 	std::vector<std::vector<std::string>> fileSets;
@@ -169,6 +466,30 @@ int main(int argc, char** argv)
 
 	cout << "Textures Loaded\n\n";
 
+	// artists edit these while the scene runs, changed files are reloaded between frames
+	HotReloader hotReloader;
+	watchShader(hotReloader, illumShaderProgram, "src/shaders/illuminated.vert", "src/shaders/illuminated.frag", VIRTUAL_TEXTURE_SHADER);
+	watchShader(hotReloader, earthShaderProgram, "src/shaders/earth.vert", "src/shaders/earth.frag", VIRTUAL_TEXTURE_SHADER);
+	watchShader(hotReloader, basicShaderProgram, "src/shaders/basic.vert", "src/shaders/basic.frag");
+	watchShader(hotReloader, skyShaderProgram, "src/shaders/sky.vert", "src/shaders/sky.frag");
+	watchShader(hotReloader, feedbackShaderProgram, "src/shaders/illuminated.vert", "src/shaders/feedback.frag", VIRTUAL_TEXTURE_SHADER);
+	watchTexture(hotReloader, textureStreamer, sunTexture, "assets/textures/2k_sun.jpg");
+	watchTexture(hotReloader, textureStreamer, mercuryTexture, "assets/textures/2k_mercury.jpg");
+	watchTexture(hotReloader, textureStreamer, venusTexture, "assets/textures/2k_venus_surface.jpg");
+	watchTexture(hotReloader, textureStreamer, earthTexture, "assets/textures/2k_earth_daymap.jpg");
+	watchTexture(hotReloader, textureStreamer, earthNightTexture, "assets/textures/8k_earth_nightmap.jpg");
+	watchTexture(hotReloader, textureStreamer, earthCloudsTexture, "assets/textures/2k_earth_clouds.jpg");
+	watchTexture(hotReloader, textureStreamer, moonTexture, "assets/textures/2k_moon.jpg");
+	watchTexture(hotReloader, textureStreamer, marsTexture, "assets/textures/2k_mars.jpg");
+	watchTexture(hotReloader, textureStreamer, jupiterTexture, "assets/textures/2k_jupiter.jpg");
+	watchTexture(hotReloader, textureStreamer, saturnTexture, "assets/textures/2k_saturn.jpg");
+	watchTexture(hotReloader, textureStreamer, saturnRingTexture, "assets/textures/saturn_ring_2.png", ringMips);
+	watchTexture(hotReloader, textureStreamer, uranusTexture, "assets/textures/2k_uranus.jpg");
+	watchTexture(hotReloader, textureStreamer, uranusRingTexture, "assets/textures/uranus_ring_2.png", ringMips);
+	watchTexture(hotReloader, textureStreamer, neptuneTexture, "assets/textures/2k_neptune.jpg");
+	watchTexture(hotReloader, textureStreamer, plutoTexture, "assets/textures/pluto.jpg");
+	for (int i = 0; i < skyTextures.size(); i++) watchCubemap(hotReloader, skyTextures[i], fileSets[i]);
+
 
 	vector<vector<GLuint>> textures{
 		{ sunTexture },
@@ -186,17 +507,32 @@ int main(int argc, char** argv)
 		{ uranusRingTexture }
 	};
 
+	// virtual texture replacing the base map of each entry of textures, -1 if none
+	vector<int> virtualTextureIds{ -1, -1, -1, earthVirtual, marsVirtual, -1, -1, -1, -1, -1, moonVirtual, -1, -1 };
+
 
 	// ======= prepre scene rendering =======
 
 	cout << "Setting Up Scene...\n";
+	// all lods of a mesh share its vertex buffer and sit behind each other in its element buffer
+	vector<float> meshRadii{
+		meshRadius(sphereVert, 8),
+		meshRadius(saturnRingVert, 8),
+		meshRadius(uranusRingVert, 8),
+	};
+	vector<vector<LodRange>> lodRanges{
+		sphereLods,
+		saturnRingLods,
+		uranusRingLods,
+	};
+
 	// gen buffers
-	unsigned int sphereVAO, sphereVBO;
-	glSetupVertexObject(sphereVAO, sphereVBO, sphereVert, vector<int>{3, 2, 3});
-	unsigned int saturnRingVAO, saturnRingVBO;
-	glSetupVertexObject(saturnRingVAO, saturnRingVBO, saturnRingVert, vector<int>{3, 2, 3});
-	unsigned int uranusRingVAO, uranusRingVBO;
-	glSetupVertexObject(uranusRingVAO, uranusRingVBO, uranusRingVert, vector<int>{3, 2, 3});
+	unsigned int sphereVAO, sphereVBO, sphereEBO;
+	GLenum sphereIdxType = glSetupVertexObject(sphereVAO, sphereVBO, sphereEBO, spherePacked, sphereIdx);
+	unsigned int saturnRingVAO, saturnRingVBO, saturnRingEBO;
+	GLenum saturnRingIdxType = glSetupVertexObject(saturnRingVAO, saturnRingVBO, saturnRingEBO, saturnRingPacked, saturnRingIdx);
+	unsigned int uranusRingVAO, uranusRingVBO, uranusRingEBO;
+	GLenum uranusRingIdxType = glSetupVertexObject(uranusRingVAO, uranusRingVBO, uranusRingEBO, uranusRingPacked, uranusRingIdx);
 	unsigned int skyVAO, skyVBO;
 	glSetupVertexObject(skyVAO, skyVBO, skyboxVert, vector<int>{3});
 
@@ -206,12 +542,23 @@ int main(int argc, char** argv)
 		uranusRingVAO
 	};
 
-	vector<int> vertexSize{
-		(int)sphereVert.size() / 8,
-		(int)saturnRingVert.size() / 8,
-		(int)uranusRingVert.size() / 8,
+	vector<GLenum> indexTypes{
+		sphereIdxType,
+		saturnRingIdxType,
+		uranusRingIdxType,
 	};
 
+	// meshes live in gpu buffers now, cpu copies aren't needed anymore
+	sphereVert = vector<float>();
+	sphereIdx = vector<unsigned int>();
+	saturnRingVert = vector<float>();
+	saturnRingIdx = vector<unsigned int>();
+	uranusRingVert = vector<float>();
+	uranusRingIdx = vector<unsigned int>();
+	spherePacked = PackedVertices();
+	saturnRingPacked = PackedVertices();
+	uranusRingPacked = PackedVertices();
+
 	// remove binding
 	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
@@ -223,9 +570,6 @@ int main(int argc, char** argv)
 	// =========== MODEL & ANIMATION CONFIG ==============
 
 
-	// model constants
-	float SPHERE_OBJECT_RADIUS = 2;		// 3d vertex sphere radius (do not change)
-
 	// model hyper params				(tweak these to adjust scene)
 
 	float distanceModifier = 240;		// master distance margin scale
@@ -249,7 +593,7 @@ int main(int argc, char** argv)
 		// pr. parent index (-1: not orbiting, * > -1: orbiting pr when a == 1, 
 		//		following pr when a == 0) [refer to this array]
 		// bc. body constant index [refer to "bodyConstants" array]
-		// vao. VAO and vertex size index [refer to "vertexSize" & "VAOs" array]
+		// vao. VAO and index size index [refer to "indexSize", "indexTypes" & "VAOs" array]
 		// tx. texture index [refer to "textures" array]
 		// mv. model view boolean to disable model view option of certain objects
 		//
@@ -411,13 +755,25 @@ int main(int argc, char** argv)
 
 	// ==================== RENDER LOOP =========================
 
-	glUseProgram(skyShaderProgram);
-	glUniform1i(glGetUniformLocation(skyShaderProgram, "skybox"), 0); // set texture to 0
+	// sampler units, again whenever a shader is reloaded
+	auto setSamplerUnits = [&]() {
+		glUseProgram(skyShaderProgram);
+		glUniform1i(glGetUniformLocation(skyShaderProgram, "skybox"), 0); // set texture to 0
+
+		glUseProgram(earthShaderProgram);
+		glUniform1i(glGetUniformLocation(earthShaderProgram, "Texture1"), 0);
+		glUniform1i(glGetUniformLocation(earthShaderProgram, "Texture2"), 1);
+		glUniform1i(glGetUniformLocation(earthShaderProgram, "Texture3"), 2);
 
-	glUseProgram(earthShaderProgram);
-	glUniform1i(glGetUniformLocation(earthShaderProgram, "Texture1"), 0);
-	glUniform1i(glGetUniformLocation(earthShaderProgram, "Texture2"), 1);
-	glUniform1i(glGetUniformLocation(earthShaderProgram, "Texture3"), 2);
+		// a sampler type per unit, the virtual texture samplers stay off the units of the 2d maps
+		for (unsigned int program : { illumShaderProgram, earthShaderProgram })
+		{
+			glUseProgram(program);
+			glUniform1i(glGetUniformLocation(program, "virtualAtlas"), 3);
+			glUniform1i(glGetUniformLocation(program, "virtualPageTable"), 4);
+		}
+	};
+	setSamplerUnits();
 
 	sceneState.addSPlayTime(glfwGetTime());		// add asset loading time to paused time (rectify animation time)
 	//sceneState.pauseScene(glfwGetTime(), true);
@@ -429,6 +785,7 @@ int main(int argc, char** argv)
 	double previousTime = glfwGetTime();
 	double currentTime;
 	int fpsCount = 0;
+	int frameTriangles = 0;
 
 	// Vsync
 	//glfwSwapInterval(1);
@@ -436,6 +793,18 @@ int main(int argc, char** argv)
 	while (!glfwWindowShouldClose(window))
 	{
 
+		// swap in assets reloaded since the last frame
+		if (hotReloader.applyPending() > 0) setSamplerUnits();
+
+		// streamed textures that finished decoding
+		if (textureStreamer.update() > 0 && textureStreamer.idle())
+		{
+			cout << "\nTextures Resident: " << glfwGetTime() - startLoadingTime << "s\n\n";
+		}
+
+		// virtual texture tiles the feedback of earlier frames asked for
+		virtualTextures.update();
+
 		// input
 		camera.processInputs(window);
 
@@ -444,11 +813,16 @@ int main(int argc, char** argv)
 		if (currentTime - previousTime >= 1.0) {
 
 			std::stringstream ss;
-			ss << WINDOW_TITLE << " - " << fpsCount << " FPS";
+			ss << WINDOW_TITLE << " - " << fpsCount << " FPS, " << frameTriangles << " triangles";
+			if (earthVirtual >= 0 || marsVirtual >= 0 || moonVirtual >= 0)
+			{
+				ss << ", " << virtualTextures.residentTiles() << "/" << virtualTextures.slotCount() << " tiles";
+			}
 			glfwSetWindowTitle(window, ss.str().c_str());
 			fpsCount = 0;
 			previousTime = currentTime;
 		}
+		frameTriangles = 0;
 
 		// animate animated objects (some object might just require rendering but not animating)
 		if (sceneState.getCanUpdateAnimation())
@@ -529,7 +903,11 @@ int main(int argc, char** argv)
 				model = glm::rotate(model, glm::radians(bc.axialTilt), Zaxis);
 				model = glm::scale(model, glm::vec3(rb.scale));
 				glSetModelViewProjection(shaderProg, model, view, projection);
-				glDrawVertexTriangles(VAOs[rb.VAOIdx], textures[txIdx][0], vertexSize[rb.VAOIdx]);
+
+				const LodRange& lod = lodRanges[rb.VAOIdx][selectLod(lodRanges[rb.VAOIdx], meshRadii[rb.VAOIdx] * rb.scale,
+					glm::vec3(model * glm::vec4(0, 0, 0, 1)), view, camera.getFOV(), WINDOW_HEIGHT)];
+				glDrawIndexedTriangles(VAOs[rb.VAOIdx], textures[txIdx][0], lod.indexCount, indexTypes[rb.VAOIdx], lod.firstIndex);
+				frameTriangles += lod.indexCount / 3;
 
 			}
 			// if object is animated or following animated object
@@ -567,6 +945,21 @@ int main(int argc, char** argv)
 					)
 				);
 
+				// coarsest level that still looks exact at the body's size on screen
+				const LodRange& lod = lodRanges[rb.VAOIdx][selectLod(lodRanges[rb.VAOIdx], meshRadii[rb.VAOIdx] * rb.scale,
+					vecToVec3(rb.finalPosition), view, camera.getFOV(), WINDOW_HEIGHT)];
+				frameTriangles += lod.indexCount / 3;
+
+				// virtual textured base map once its coarsest tile is resident
+				unsigned int bodyProgram = i == earthIdx ? earthShaderProgram : illumShaderProgram;
+				int virtualId = virtualTextureIds[txIdx];
+				if (virtualTextures.ready(virtualId))
+				{
+					virtualTextures.bind(bodyProgram, virtualId, 3, 4);
+					virtualDraws.push_back(VirtualDraw{ model, VAOs[rb.VAOIdx], indexTypes[rb.VAOIdx], lod, virtualId });
+				}
+				else glUniform1i(glGetUniformLocation(bodyProgram, "virtualTextured"), 0);
+
 				// for earth use special shader
 				if (i == earthIdx)
 				{
@@ -580,17 +973,33 @@ int main(int argc, char** argv)
 					glBindTexture(GL_TEXTURE_2D, textures[txIdx][1]);
 					glActiveTexture(GL_TEXTURE2);
 					glBindTexture(GL_TEXTURE_2D, textures[txIdx][2]);
-					glDrawArrays(GL_TRIANGLES, 0, vertexSize[rb.VAOIdx]);
+					size_t indexBytes = indexTypes[rb.VAOIdx] == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+					glDrawElements(GL_TRIANGLES, lod.indexCount, indexTypes[rb.VAOIdx], (void*)(lod.firstIndex * indexBytes));
 				}
 				else
 				{
 					glSetLightingConfig(illumShaderProgram, lightPos, camera, camera.isTorchPressed(), gui);
 					glSetModelViewProjection(illumShaderProgram, model, view, projection);
-					glDrawVertexTriangles(VAOs[rb.VAOIdx], textures[txIdx][0], vertexSize[rb.VAOIdx]);
+					glDrawIndexedTriangles(VAOs[rb.VAOIdx], textures[txIdx][0], lod.indexCount, indexTypes[rb.VAOIdx], lod.firstIndex);
 				}
 			}
 		}
 
+		// feedback of the virtual textured bodies, read back a frame or two later
+		if (!virtualDraws.empty())
+		{
+			virtualTextures.beginFeedback();
+			glUseProgram(feedbackShaderProgram);
+			for (const VirtualDraw& draw : virtualDraws)
+			{
+				glSetModelViewProjection(feedbackShaderProgram, draw.model, view, projection);
+				virtualTextures.setFeedbackUniforms(feedbackShaderProgram, draw.id);
+				glDrawIndexedTriangles(draw.VAO, 0, draw.lod.indexCount, draw.indexType, draw.lod.firstIndex);
+			}
+			virtualTextures.endFeedback();
+			virtualDraws.clear();
+		}
+
 		// skybox (contains gl code)
 		displaySkyBox(skyVAO, gui.getTexture(), skyShaderProgram, view, projection);
 
@@ -616,27 +1025,41 @@ int main(int argc, char** argv)
 // ====================== general functions ========================
 
 
+// block compressed with a prebuilt mip chain when the driver takes it (see CompressedTexture.h)
 unsigned int loadTexture(const char* path)
 {
-	unsigned int textureID;
-	glGenTextures(1, &textureID);
+	CompressedTexture compressed;
+	if (blockCompressionSupported() && acquireCompressedTexture(path, compressed)) return uploadCompressedTexture(compressed, path);
+
+	// otherwise the decoded texels and their mip chain, mapped from the texture cache
+	DecodedTexture decoded;
+	textureCache.acquire(path, true, decoded);
+	return uploadTexture(decoded, path);
+}
 
+// encoded image already in memory (e.g. embedded in a glb file)
+unsigned int loadTextureFromMemory(const unsigned char* bytes, size_t size)
+{
 	int width, height, nrComponents;
-	stbi_set_flip_vertically_on_load(true);
-	unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-	if (data)
-	{
-		GLenum format;
-		if (nrComponents == 1)
-			format = GL_RED;
-		else if (nrComponents == 3)
-			format = GL_RGB;
-		else if (nrComponents == 4)
-			format = GL_RGBA;
+	stbi_set_flip_vertically_on_load_thread(true);
+	unsigned char* data = stbi_load_from_memory(bytes, (int)size, &width, &height, &nrComponents, 0);
 
+	DecodedTexture decoded;
+	if (data) decoded = buildDecodedTexture(data, width, height, nrComponents, true);
+	stbi_image_free(data);
+	return uploadTexture(decoded, "embedded image");
+}
+
+// a texture without levels (failed to decode) gives an empty texture
+// a textureID is respecified in place, 0 creates a new texture
+unsigned int uploadTexture(const DecodedTexture& texture, const char* path, unsigned int textureID)
+{
+	if (textureID == 0) glGenTextures(1, &textureID);
+
+	if (!texture.levels.empty())
+	{
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-		glGenerateMipmap(GL_TEXTURE_2D);
+		uploadDecodedLevels(GL_TEXTURE_2D, texture, texture.data());
 
 		// Tek seferde ayarlamalar
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -651,54 +1074,76 @@ unsigned int loadTexture(const char* path)
 		std::cout << "Texture failed to load at path: " << path << std::endl;
 	}
 
-	// Bellei serbest brak
-	stbi_image_free(data);
+	return textureID;
+}
 
+// block compressed mip chain, a textureID is respecified in place, 0 creates a new texture
+unsigned int uploadCompressedTexture(const CompressedTexture& texture, const char* path, unsigned int textureID)
+{
+	if (textureID == 0) glGenTextures(1, &textureID);
+
+	glBindTexture(GL_TEXTURE_2D, textureID);
+	uploadCompressedLevels(texture, texture.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	std::cout << "Texture Loaded: " << path << " (" << texture.byteSize() / 1024 << " KB instead of "
+		<< uncompressedTextureBytes(texture.width, texture.height) / 1024 << " KB)" << std::endl;
 	return textureID;
 }
 
+// BC1 and BC3 both supported, queried once on the render thread like TextureStreamer does
+bool blockCompressionSupported()
+{
+	static bool supported = compressedFormatSupported(BlockFormat::BC1) && compressedFormatSupported(BlockFormat::BC3);
+	return supported;
+}
+
 
+// faces are mapped from the texture cache (base level only, the sky isn't mipmapped)
 unsigned int loadCubemap(std::vector<std::string> faces)
 {
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-	stbi_set_flip_vertically_on_load(true);
 
-	int width, height, nrChannels;
-	std::vector<std::future<unsigned char*>> futures;
+	std::vector<std::future<DecodedTexture>> futures;
 
 	// Paralel olarak grntleri ykle
 	for (unsigned int i = 0; i < faces.size(); i++)
 	{
 		futures.push_back(std::async(std::launch::async, [&, i]() {
-			return stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
+			DecodedTexture face;
+			textureCache.acquire(faces[i].c_str(), false, face);
+			return face;
 			}));
 	}
 
+	std::vector<DecodedTexture> faceTextures;
+	for (auto& future : futures) faceTextures.push_back(future.get());
+	uploadCubemap(textureID, faceTextures, faces);
+
+	return textureID;
+}
+
+// releases the faces (+x, -x, +y, -y, +z, -z), a face without levels failed to decode
+void uploadCubemap(unsigned int textureID, vector<DecodedTexture>& faceTextures, const vector<string>& faces)
+{
+	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
+
 	// Yklenen grntleri ileme
-	for (unsigned int i = 0; i < faces.size(); i++)
+	for (unsigned int i = 0; i < faceTextures.size(); i++)
 	{
-		unsigned char* data = futures[i].get();
-		if (data)
+		if (!faceTextures[i].levels.empty())
 		{
-			GLenum format;
-			if (nrChannels == 1)
-				format = GL_RED;
-			else if (nrChannels == 3)
-				format = GL_RGB;
-			else if (nrChannels == 4)
-				format = GL_RGBA;
-
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
+			uploadDecodedLevels(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, faceTextures[i], faceTextures[i].data());
 			std::cout << "Texture Loaded: " << faces[i] << std::endl;
 		}
 		else
 		{
 			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
 		}
+		faceTextures[i] = DecodedTexture();
 	}
 
 	// OpenGL ayarlarn bir kez yap
@@ -707,8 +1152,205 @@ unsigned int loadCubemap(std::vector<std::string> faces)
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+}
 
-	return textureID;
+// decoded on the reloader thread in the format loadTexture picks, a file that doesn't decode (e.g. still
+// being written) keeps the old texture. changes before the streamer's upload are skipped, that upload
+// would overwrite them
+void watchTexture(HotReloader& reloader, const TextureStreamer& streamer, GLuint texture, const string& path, const MipOptions& mips)
+{
+	bool compressBlocks = blockCompressionSupported();
+	reloader.watch({ path }, [&streamer, texture, path, mips, compressBlocks]() -> function<void()> {
+		if (!streamer.resident(texture)) return nullptr;
+
+		auto compressed = make_shared<CompressedTexture>();
+		if (compressBlocks && acquireCompressedTexture(path.c_str(), *compressed, mips))
+		{
+			return [texture, path, compressed]() {
+				uploadCompressedTexture(*compressed, path.c_str(), texture);
+				*compressed = CompressedTexture();
+			};
+		}
+
+		auto decoded = make_shared<DecodedTexture>();
+		if (!textureCache.acquire(path.c_str(), true, *decoded, mips)) return nullptr;
+		return [texture, path, decoded]() {
+			uploadTexture(*decoded, path.c_str(), texture);
+			*decoded = DecodedTexture();
+		};
+	});
+}
+
+void watchCubemap(HotReloader& reloader, GLuint texture, const vector<string>& faces)
+{
+	reloader.watch(faces, [texture, faces]() -> function<void()> {
+		auto faceTextures = make_shared<vector<DecodedTexture>>(faces.size());
+		for (size_t i = 0; i < faces.size(); i++)
+		{
+			if (!textureCache.acquire(faces[i].c_str(), false, (*faceTextures)[i])) return nullptr;
+		}
+		return [texture, faces, faceTextures]() { uploadCubemap(texture, *faceTextures, faces); };
+	});
+}
+
+// compiled on the render thread (needs the context), a failed compile keeps the running program.
+// the fragment library (empty for none) is watched too, an edit recompiles every shader using it
+void watchShader(HotReloader& reloader, unsigned int& shaderProgram, const string& vertexShaderFile, const string& fragmentShaderFile, const string& fragmentLibraryFile)
+{
+	vector<string> paths = { vertexShaderFile, fragmentShaderFile };
+	if (!fragmentLibraryFile.empty()) paths.push_back(fragmentLibraryFile);
+
+	reloader.watch(paths, [&shaderProgram, vertexShaderFile, fragmentShaderFile, fragmentLibraryFile]() -> function<void()> {
+		return [&shaderProgram, vertexShaderFile, fragmentShaderFile, fragmentLibraryFile]() {
+			ReloadShader(vertexShaderFile.c_str(), fragmentShaderFile.c_str(), shaderProgram,
+				fragmentLibraryFile.empty() ? NULL : fragmentLibraryFile.c_str());
+		};
+	});
+}
+
+// parsed on the reloader thread, the swap re-uploads the buffers. a file that doesn't parse or has no
+// faces (e.g. still being exported) keeps the old mesh
+void watchMesh(HotReloader& reloader, ObjModel& model, MaterialLibrary& materialLibrary, const string& path)
+{
+	reloader.watch({ path }, [&model, &materialLibrary, path]() -> function<void()> {
+		auto data = make_shared<ObjectFileData>(ObjFileReader().read(path.c_str()));
+		bool hasFaces = any_of(data->subObjects.begin(), data->subObjects.end(), [](const SubObj& subObj) { return !subObj.indices.empty(); });
+		if (!hasFaces) return nullptr;
+		return [&model, &materialLibrary, data]() {
+			ObjModel reloaded;
+			glSetupObjModel(reloaded, *data, materialLibrary);
+			glDeleteVertexArrays(1, &model.VAO);
+			glDeleteBuffers(1, &model.VBO);
+			glDeleteBuffers(1, &model.EBO);
+			model = move(reloaded);
+		};
+	});
+}
+
+// same for a glb, the file is unmapped again once uploaded
+void watchMesh(HotReloader& reloader, GlbModel& model, GlbFileData& data, MaterialLibrary& materialLibrary, const string& path)
+{
+	reloader.watch({ path }, [&model, &data, &materialLibrary, path]() -> function<void()> {
+		auto reloadedData = make_shared<GlbFileData>(GlbFileReader().read(path.c_str()));
+		return [&model, &data, &materialLibrary, reloadedData]() {
+			GlbModel reloaded;
+			glSetupGlbModel(reloaded, *reloadedData, materialLibrary);
+			for (vector<unsigned int>& VAOs : model.primitiveVAOs) glDeleteVertexArrays((GLsizei)VAOs.size(), VAOs.data());
+			glDeleteBuffers(1, &model.buffer);
+			model = move(reloaded);
+
+			data = move(*reloadedData);
+			data.file.close();
+			data.binary = nullptr;
+			data.binarySize = 0;
+			data.materials.embeddedTextures.clear();
+		};
+	});
+}
+
+
+// ============ model viewer ===============
+
+int viewModel(const string& path)
+{
+	GLFWwindow* window = createWindow(WINDOW_WIDTH, WINDOW_HEIGHT, (string(WINDOW_TITLE) + " - " + path).c_str());
+	if (!window || !gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		cout << "can't create an opengl 3.3 context" << endl;
+		glfwTerminate();
+		return 1;
+	}
+
+	// textures and materials of the model, shared by its reloads
+	MaterialLibrary materialLibrary(loadTexture, loadTextureFromMemory);
+
+	// a glb that can't be read falls back to the obj export next to it
+	filesystem::path objPath = path;
+	GlbModel glbModel;
+	GlbFileData glbData;
+	bool glb = objPath.extension() == ".glb";
+	if (glb)
+	{
+		try
+		{
+			glbData = GlbFileReader().read(path.c_str());
+			glSetupGlbModel(glbModel, glbData, materialLibrary);
+			// drawing only needs the meshes and instances, the file stays free for the next export
+			glbData.file.close();
+			glbData.binary = nullptr;
+			glbData.binarySize = 0;
+			glbData.materials.embeddedTextures.clear();
+		}
+		catch (const exception& e)
+		{
+			objPath.replace_extension(".obj");
+			cout << "Fail loading " << path << ": " << e.what() << ", trying " << objPath.string() << endl;
+			glb = false;
+		}
+	}
+
+	ObjModel objModel;
+	if (!glb)
+	{
+		try
+		{
+			glSetupObjModel(objModel, ObjFileReader().read(objPath.string().c_str()), materialLibrary);
+		}
+		catch (const exception& e)
+		{
+			cout << "Fail loading " << objPath.string() << ": " << e.what() << endl;
+			glfwTerminate();
+			return 1;
+		}
+	}
+
+	// re-exports show up without restarting
+	HotReloader hotReloader;
+	if (glb) watchMesh(hotReloader, glbModel, glbData, materialLibrary, path);
+	else watchMesh(hotReloader, objModel, materialLibrary, objPath.string());
+
+	unsigned int shaderProgram = LoadShader("src/shaders/illuminated.vert", "src/shaders/illuminated.frag", VIRTUAL_TEXTURE_SHADER);
+	watchShader(hotReloader, shaderProgram, "src/shaders/illuminated.vert", "src/shaders/illuminated.frag", VIRTUAL_TEXTURE_SHADER);
+	glEnable(GL_DEPTH_TEST);
+	glEnable(GL_MULTISAMPLE);
+
+	Camera viewCamera(WINDOW_WIDTH, WINDOW_HEIGHT);
+	while (!glfwWindowShouldClose(window))
+	{
+		if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) glfwSetWindowShouldClose(window, true);
+
+		hotReloader.applyPending();
+
+		// the whole bounding sphere in view, the light above the camera's shoulder
+		glm::vec3 center = glb ? glbModel.center : objModel.center;
+		float radius = max(glb ? glbModel.radius : objModel.radius, 1e-3f);
+		float distance = radius / sinf(glm::radians(viewCamera.getFOV()) * 0.5f);
+		viewCamera.setPosition(glm::vec3(0.f, 0.f, distance));
+		glm::vec3 lightPosition = glm::vec3(distance, distance, distance);
+
+		glm::mat4 transform = glm::rotate(glm::mat4(1.f), (float)glfwGetTime() * glm::radians(20.f), glm::vec3(0.f, 1.f, 0.f));
+		transform = glm::translate(transform, -center);
+		glm::mat4 view = glm::lookAt(viewCamera.getPosition(), viewCamera.getPosition() + viewCamera.getOrientation(), viewCamera.getUp());
+		glm::mat4 projection = glm::perspective(glm::radians(viewCamera.getFOV()), (float)WINDOW_WIDTH / (float)WINDOW_HEIGHT,
+			distance * 0.01f, distance * 4.f);
+
+		glClearColor(0.1f, 0.1f, 0.1f, 1.f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glUseProgram(shaderProgram);
+		glSetLightingConfig(shaderProgram, lightPosition, viewCamera, false, glm::vec3(1.f), 0.2f);
+		glSetModelViewProjection(shaderProgram, transform, view, projection);
+		if (glb) glDrawGlbModel(glbModel, glbData, materialLibrary, transform, shaderProgram);
+		else glDrawModel(objModel, materialLibrary, shaderProgram);
+
+		GLenum err;
+		while ((err = glGetError()) != GL_NO_ERROR) { cout << "OpenGL Error Occured. Error Code: " << err << endl; }
+
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+
+	glfwTerminate();
+	return 0;
 }
 
 
@@ -752,28 +1394,58 @@ void displaySkyBox(unsigned int& VAO, GLuint texture, unsigned int shaderProgram
 
 
 void glSetupVertexObject(unsigned int& VAO, unsigned int& VBO, vector<float>& data, vector<int> attribLayout)
+{
+	vector<VertexAttrib> layout;
+	for (int i = 0; i < attribLayout.size(); i++)
+	{
+		if (attribLayout[i] < 1) throw invalid_argument("glSetupVertexObject : attribute layout must be larger than 0");
+		layout.push_back(VertexAttrib{ attribLayout[i], GL_FLOAT, false });
+	}
+	glSetupVertexObject(VAO, VBO, &data[0], data.size() * sizeof(float), layout);
+}
+
+// typed variant, attributes may be half floats or (normalized) integers
+void glSetupVertexObject(unsigned int& VAO, unsigned int& VBO, const void* data, size_t dataSize, const vector<VertexAttrib>& attribLayout)
 {
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, dataSize, data, GL_STATIC_DRAW);
 
-	int strideCount = 0;
+	int stride = vertexStride(attribLayout);
+
+	size_t offset = 0;
 	for (int i = 0; i < attribLayout.size(); i++)
 	{
-		if (attribLayout[i] < 1) throw invalid_argument("glSetupVertexObject : attribute layout must be larger than 0");
-		strideCount += attribLayout[i];
+		const VertexAttrib& attrib = attribLayout[i];
+		if (attrib.count < 1) throw invalid_argument("glSetupVertexObject : attribute layout must be larger than 0");
+
+		glEnableVertexAttribArray(i);
+		glVertexAttribPointer(i, attrib.count, attrib.type, attrib.normalized ? GL_TRUE : GL_FALSE, stride, (void*)offset);
+		offset += vertexAttribSize(attrib);
 	}
+}
 
-	int offset = 0;
-	for (int i = 0; i < attribLayout.size(); i++)
+// indexed variant, returns the index type used for glDrawElements
+// (16 bit indices whenever every vertex is addressable with them)
+GLenum glSetupVertexObject(unsigned int& VAO, unsigned int& VBO, unsigned int& EBO, PackedVertices& vertices, vector<unsigned int>& indices)
+{
+	glSetupVertexObject(VAO, VBO, vertices.data.data(), vertices.data.size(), vertices.layout);
+
+	glGenBuffers(1, &EBO);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO); // recorded in the bound VAO
+
+	if (vertices.vertexCount <= 65536)
 	{
-		glEnableVertexAttribArray(i);
-		glVertexAttribPointer(i, attribLayout[i], GL_FLOAT, GL_FALSE, strideCount * sizeof(float), (void*)(offset * sizeof(float)));
-		offset += attribLayout[i];
+		vector<unsigned short> shortIndices(indices.begin(), indices.end());
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(unsigned short), &shortIndices[0], GL_STATIC_DRAW);
+		return GL_UNSIGNED_SHORT;
 	}
+
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+	return GL_UNSIGNED_INT;
 }
 
 void glDrawVertexTriangles(unsigned int VAO, GLuint texture, int numberOfVertex)
@@ -784,6 +1456,186 @@ void glDrawVertexTriangles(unsigned int VAO, GLuint texture, int numberOfVertex)
 	glDrawArrays(GL_TRIANGLES, 0, numberOfVertex);
 }
 
+void glDrawIndexedTriangles(unsigned int VAO, GLuint texture, int numberOfIndices, GLenum indexType, size_t firstIndex)
+{
+	size_t indexBytes = indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+
+	glBindVertexArray(VAO);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glDrawElements(GL_TRIANGLES, numberOfIndices, indexType, (void*)(firstIndex * indexBytes));
+}
+
+// packs every sub object into one quantized vertex buffer (see VertexFormat.h) and registers the
+// model's materials, the cpu copies are dropped once uploaded
+void glSetupObjModel(ObjModel& model, const ObjectFileData& data, MaterialLibrary& materialLibrary)
+{
+	ModelBuffer buffer = packModel(data, 8);
+	if (buffer.indices.empty()) throw invalid_argument("glSetupObjModel : model without faces");
+
+	glm::vec3 minPosition(buffer.vertices[0], buffer.vertices[1], buffer.vertices[2]), maxPosition = minPosition;
+	for (size_t i = 0; i < buffer.vertices.size(); i += 8)
+	{
+		glm::vec3 position(buffer.vertices[i], buffer.vertices[i + 1], buffer.vertices[i + 2]);
+		minPosition = glm::min(minPosition, position);
+		maxPosition = glm::max(maxPosition, position);
+	}
+	model.center = (minPosition + maxPosition) * 0.5f;
+	model.radius = glm::length(maxPosition - minPosition) * 0.5f;
+
+	// any model, positions stay float (only uvs and normals are quantized)
+	PackedVertices packed = packVertices(buffer.vertices, true);
+	model.indexType = glSetupVertexObject(model.VAO, model.VBO, model.EBO, packed, buffer.indices);
+	glBindVertexArray(0);
+	model.materialRanges = buffer.materialRanges;
+	model.materialIds = materialLibrary.addMaterials(data, buffer.materialNames);
+}
+
+// packed obj model, one draw call per material and the vertex array bound once
+// opaque materials are drawn first in library id order, translucent ones blended after them
+void glDrawModel(const ObjModel& model, const MaterialLibrary& materialLibrary, unsigned int shaderProgram)
+{
+	size_t indexBytes = model.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+	const vector<int>& materialIds = model.materialIds;
+
+	auto translucent = [&](const DrawRange& range) { return materialLibrary.getMaterial(materialIds[range.materialId]).opacity < 1.f; };
+	vector<DrawRange> ranges;
+	for (const DrawRange& range : model.materialRanges)
+	{
+		if (range.indexCount > 0) ranges.push_back(range);
+	}
+	sort(ranges.begin(), ranges.end(), [&](const DrawRange& a, const DrawRange& b) {
+		bool aTranslucent = translucent(a), bTranslucent = translucent(b);
+		if (aTranslucent != bTranslucent) return bTranslucent;
+		return materialIds[a.materialId] < materialIds[b.materialId];
+	});
+
+	glBindVertexArray(model.VAO);
+	bool blending = false;
+	for (const DrawRange& range : ranges)
+	{
+		if (!blending && translucent(range))
+		{
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+			blending = true;
+		}
+		materialLibrary.bind(materialIds[range.materialId], shaderProgram);
+		glDrawElements(GL_TRIANGLES, (GLsizei)range.indexCount, model.indexType, (void*)(range.firstIndex * indexBytes));
+	}
+	if (blending)
+	{
+		glDepthMask(GL_TRUE);
+		glDisable(GL_BLEND);
+	}
+	materialLibrary.bindNeutral(shaderProgram);
+}
+
+// uploads the binary chunk as is and points one vertex array per primitive into it, no vertex is touched
+// on the cpu. the same buffer backs the indices, glb accessors are already validated by GlbFileReader
+void glSetupGlbModel(GlbModel& model, const GlbFileData& data, MaterialLibrary& materialLibrary)
+{
+	// bounding box of every placed primitive
+	glm::vec3 minPosition(FLT_MAX), maxPosition(-FLT_MAX);
+	for (const GlbInstance& instance : data.instances)
+	{
+		for (const GlbPrimitive& primitive : data.meshes[instance.mesh].primitives)
+		{
+			for (int corner = 0; corner < 8; corner++)
+			{
+				glm::vec3 local((corner & 1) ? primitive.maxPosition.x : primitive.minPosition.x,
+					(corner & 2) ? primitive.maxPosition.y : primitive.minPosition.y,
+					(corner & 4) ? primitive.maxPosition.z : primitive.minPosition.z);
+				glm::vec3 position = glm::vec3(instance.transform * glm::vec4(local, 1.f));
+				minPosition = glm::min(minPosition, position);
+				maxPosition = glm::max(maxPosition, position);
+			}
+		}
+	}
+	if (minPosition.x > maxPosition.x) throw invalid_argument("glSetupGlbModel : scene without triangles");
+	model.center = (minPosition + maxPosition) * 0.5f;
+	model.radius = glm::length(maxPosition - minPosition) * 0.5f;
+
+	glGenBuffers(1, &model.buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, model.buffer);
+	glBufferData(GL_ARRAY_BUFFER, data.binarySize, data.binary, GL_STATIC_DRAW);
+
+	auto attribPointer = [](unsigned int location, const GlbAttribute& attribute) {
+		if (attribute.format.count == 0) return; // generic attribute value instead
+		glEnableVertexAttribArray(location);
+		glVertexAttribPointer(location, attribute.format.count, attribute.format.type, attribute.format.normalized ? GL_TRUE : GL_FALSE,
+			attribute.byteStride, (void*)attribute.byteOffset);
+	};
+
+	model.primitiveVAOs.clear();
+	for (const GlbMesh& mesh : data.meshes)
+	{
+		vector<unsigned int> VAOs(mesh.primitives.size());
+		glGenVertexArrays((GLsizei)VAOs.size(), VAOs.data());
+		for (size_t i = 0; i < mesh.primitives.size(); i++)
+		{
+			const GlbPrimitive& primitive = mesh.primitives[i];
+			glBindVertexArray(VAOs[i]);
+			glBindBuffer(GL_ARRAY_BUFFER, model.buffer);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, model.buffer); // recorded in the bound VAO
+			attribPointer(0, primitive.position);
+			attribPointer(1, primitive.texCoord);
+			attribPointer(3, primitive.normal); // float normals, see gltfLayout in illuminated.vert
+		}
+		model.primitiveVAOs.push_back(VAOs);
+	}
+	glBindVertexArray(0);
+
+	// library ids in gltf material order
+	vector<string> materialNames(data.materials.materials.size());
+	for (const auto& entry : data.materials.materialNames) materialNames[entry.second] = entry.first;
+	model.materialIds = materialLibrary.addMaterials(data.materials, data.filename, materialNames);
+}
+
+// every mesh instance of the glb's default scene, transform places the whole scene
+// opaque primitives first, translucent ones blended after them like glDrawModel
+void glDrawGlbModel(const GlbModel& model, const GlbFileData& data, const MaterialLibrary& materialLibrary, glm::mat4 transform, unsigned int shaderProgram)
+{
+	auto materialId = [&](const GlbPrimitive& primitive) { return primitive.material < 0 ? 0 : model.materialIds[primitive.material]; };
+	auto translucent = [&](const GlbPrimitive& primitive) { return materialLibrary.getMaterial(materialId(primitive)).opacity < 1.f; };
+
+	glUniform1i(glGetUniformLocation(shaderProgram, "gltfLayout"), true);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		if (pass == 1)
+		{
+			glEnable(GL_BLEND);
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+			glDepthMask(GL_FALSE);
+		}
+
+		for (const GlbInstance& instance : data.instances)
+		{
+			glm::mat4 instanceModel = transform * instance.transform;
+			glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(instanceModel));
+
+			const GlbMesh& mesh = data.meshes[instance.mesh];
+			for (size_t i = 0; i < mesh.primitives.size(); i++)
+			{
+				const GlbPrimitive& primitive = mesh.primitives[i];
+				if (translucent(primitive) != (pass == 1)) continue;
+
+				if (primitive.normal.format.count == 0) glVertexAttrib3f(3, 0.f, 0.f, 1.f);
+				materialLibrary.bind(materialId(primitive), shaderProgram);
+				glBindVertexArray(model.primitiveVAOs[instance.mesh][i]);
+				if (primitive.indexType) glDrawElements(GL_TRIANGLES, (GLsizei)primitive.indexCount, primitive.indexType, (void*)primitive.indexOffset);
+				else glDrawArrays(GL_TRIANGLES, 0, (GLsizei)primitive.position.count);
+			}
+		}
+	}
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+
+	glUniform1i(glGetUniformLocation(shaderProgram, "gltfLayout"), false);
+	materialLibrary.bindNeutral(shaderProgram);
+}
+
 void glSetModelViewProjection(unsigned int shaderProgram, glm::mat4 model, glm::mat4 view, glm::mat4 projection)
 {
 	glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "model"), 1, GL_FALSE, glm::value_ptr(model));
@@ -792,11 +1644,18 @@ void glSetModelViewProjection(unsigned int shaderProgram, glm::mat4 model, glm::
 }
 
 void glSetLightingConfig(unsigned int shaderProgram, glm::vec3 lightPos, Camera cam, int torch, Gui& gui)
+{
+	glm::vec3 lightColor(gui.getColors()[0], gui.getColors()[1], gui.getColors()[2]);
+	glSetLightingConfig(shaderProgram, lightPos, cam, torch, lightColor, gui.getLightIntensityScale());
+}
+
+// light color and ambient strength given directly, without the scene's gui
+void glSetLightingConfig(unsigned int shaderProgram, glm::vec3 lightPos, Camera cam, int torch, glm::vec3 lightColor, float ambientStrength)
 {
 	glUniform3fv(glGetUniformLocation(shaderProgram, "light[0].position"), 1, &lightPos[0]);
-	glUniform3f(glGetUniformLocation(shaderProgram, "light[0].color"), gui.getColors()[0], gui.getColors()[1], gui.getColors()[2]);
+	glUniform3fv(glGetUniformLocation(shaderProgram, "light[0].color"), 1, &lightColor[0]);
 	glUniform3fv(glGetUniformLocation(shaderProgram, "light[0].camPos"), 1, &cam.getPosition()[0]);
-	glUniform1f(glGetUniformLocation(shaderProgram, "light[0].ambientStrength"), gui.getLightIntensityScale());
+	glUniform1f(glGetUniformLocation(shaderProgram, "light[0].ambientStrength"), ambientStrength);
 	glUniform1f(glGetUniformLocation(shaderProgram, "light[0].specularStrength"), 0.3f);
 	glUniform1f(glGetUniformLocation(shaderProgram, "light[0].shininess"), 16.f);
 	glUniform1f(glGetUniformLocation(shaderProgram, "light[0].constant"), 1.0f);
@@ -828,3 +1687,49 @@ vector<float> vec3ToVec(glm::vec3 vec3)
 	return vector<float>{vec3.x, vec3.y, vec3.z};
 }
 
+// vbo size and bytes fetched per triangle (ACMR * stride) of the float and the packed layout
+void printPackedVertexStats(const char* name, vector<float>& vertices, vector<unsigned int>& indices, PackedVertices& packed)
+{
+	size_t floatStride = 8 * sizeof(float);
+	size_t packedStride = vertexStride(packed.layout);
+	float acmr = analyzeVertexCache(indices, packed.vertexCount).acmr;
+
+	cout << "Packed " << name << ": " << packed.vertexCount << " vertices, "
+		<< floatStride << " -> " << packedStride << " bytes per vertex, VBO "
+		<< vertices.size() * sizeof(float) / 1024.f << " -> " << packed.data.size() / 1024.f << " KB, fetch "
+		<< acmr * floatStride << " -> " << acmr * packedStride << " bytes per triangle" << endl;
+}
+
+// append every tessellation level of a procedural shape, finest first, returns the range of every level
+vector<LodRange> appendShapeLevels(vector<float>& vertices, vector<unsigned int>& indices, int levelCount, function<const ShapeMesh& (int)> getLevel)
+{
+	vector<LodRange> ranges;
+	for (int level = levelCount - 1; level >= 0; level--)
+	{
+		const ShapeMesh& shape = getLevel(level);
+		unsigned int firstVertex = (unsigned int)(vertices.size() / 8);
+
+		ranges.push_back(LodRange{ (int)shape.indices.size(), indices.size(), shape.error });
+		vertices.insert(vertices.end(), shape.vertices.begin(), shape.vertices.end());
+		for (unsigned int idx : shape.indices) indices.push_back(firstVertex + idx);
+	}
+	return ranges;
+}
+
+// coarsest lod whose error stays below LOD_PIXEL_ERROR at the projected radius of the bounding sphere
+int selectLod(const vector<LodRange>& lods, float radius, glm::vec3 center, glm::mat4 view, float fov, int viewportHeight)
+{
+	float distance = glm::length(glm::vec3(view * glm::vec4(center, 1.f)));
+	if (distance <= radius) return 0;
+
+	float pixelsPerUnit = (float)viewportHeight * 0.5f / tanf(glm::radians(fov) * 0.5f);
+	float projectedRadius = radius / sqrtf(distance * distance - radius * radius) * pixelsPerUnit;
+
+	int level = 0;
+	for (int i = 1; i < lods.size(); i++)
+	{
+		if (lods[i].error * projectedRadius <= LOD_PIXEL_ERROR) level = i;
+	}
+	return level;
+}
+
@@ -1,8 +1,8 @@
 #version 330 core
 
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aTex;
-layout(location = 2) in vec3 aNor;
+layout(location = 1) in vec2 aTex;
+layout(location = 2) in vec2 aNor; // octahedral, unused
 
 uniform mat4 model;
 uniform mat4 view;
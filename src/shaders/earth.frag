@@ -9,6 +9,9 @@ uniform sampler2D Texture2; // cloud
 uniform sampler2D Texture3; // night light
 uniform bool torchLight;
 
+// virtual texture: virtualTextured and virtualTexture(uv) come from virtual_texture.frag, replace Texture1
+// once the body's tiles stream in
+
 struct Lighting {    
 
 	// light source
@@ -47,7 +50,7 @@ float spotDarkness(Lighting l, vec3 normals, vec3 fragPosition);
 
 void main()
 {
-	vec4 baseTexCol = texture(Texture1,tex);
+	vec4 baseTexCol = virtualTextured ? virtualTexture(tex) : texture(Texture1,tex);
 	vec4 secondaryTexCol = texture(Texture2, tex);
 	vec4 darkTexCol = texture(Texture3, tex);
 	
@@ -0,0 +1,24 @@
+#version 330 core
+
+// feedback pass of the virtual textures (see VirtualTexture.h), drawn with illuminated.vert into a
+// small framebuffer: every pixel writes which tile of which level of which texture it would sample
+
+in vec2 tex;
+
+// virtualLevels, virtualLayout and virtualLod come from virtual_texture.frag
+uniform int virtualTextureId;
+uniform float virtualLodBias;		// the feedback is smaller than the viewport, its footprints larger
+
+out vec4 feedback;
+
+void main()
+{
+	int level = int(floor(virtualLod(tex * virtualLevels[0].xy, virtualLodBias)));
+
+	vec2 levelSize = virtualLevels[level].xy;
+	vec2 tileCount = ceil(levelSize / virtualLayout.x);
+	vec2 tile = clamp(floor(tex * levelSize / virtualLayout.x), vec2(0.0), tileCount - 1.0);
+
+	// r: tile x, g: tile y, b: texture id << 4 | level, alpha marks a written pixel
+	feedback = vec4(tile, float(virtualTextureId * 16 + level), 255.0) / 255.0;
+}
\ No newline at end of file
@@ -7,6 +7,9 @@ in vec3 fragPos;
 uniform sampler2D Texture;
 uniform bool torchLight;
 
+// virtual texture: virtualTextured and virtualTexture(uv) come from virtual_texture.frag, replace Texture
+// once the body's tiles stream in
+
 struct Lighting {    
 
 	// light source
@@ -33,17 +36,26 @@ struct Lighting {
 };
 uniform Lighting light[2];
 
+// mtl material (see MaterialLibrary.h), the defaults leave the planets unchanged
+uniform vec3 materialAmbient = vec3(1.0);
+uniform vec3 materialDiffuse = vec3(1.0);
+uniform vec3 materialSpecular = vec3(1.0);
+uniform float materialShininess = 0.0;	// 0: light shininess
+uniform float materialOpacity = 1.0;
+uniform bool materialTextured = true;
+
 out vec4 fragCol;
 
 // prototype
-float directionalIllumination(Lighting l, vec3 normals, vec3 fragPosition);
-float positionalIllumination(Lighting l, vec3 normals, vec3 fragPosition);
-float spotIllumination(Lighting l, vec3 normals, vec3 fragPosition);
+vec3 directionalIllumination(Lighting l, vec3 normals, vec3 fragPosition);
+vec3 positionalIllumination(Lighting l, vec3 normals, vec3 fragPosition);
+vec3 spotIllumination(Lighting l, vec3 normals, vec3 fragPosition);
+vec3 materialPhong(Lighting l, float diffuse, float specularBase);
 float calculateAttenuation(Lighting l, vec3 fragPosition);
 
 void main()
 {
-	vec4 texCol = texture(Texture,tex);
+	vec4 texCol = !materialTextured ? vec4(1.0) : virtualTextured ? virtualTexture(tex) : texture(Texture,tex);
 	
 	// create alpha segmentation
 //	if (texCol.a < 0.3)
@@ -51,16 +63,16 @@ void main()
 
 	//float phong = directionalIllumination(lighting, nor, fragPos);
 	//float phong = spotIllumination(lighting, nor, fragPos);
-	float phong = positionalIllumination(light[0], nor, fragPos);
+	vec3 phong = positionalIllumination(light[0], nor, fragPos);
 	if (torchLight) 
 	{
 		phong += spotIllumination(light[1], nor, fragPos);
 	}
 
-	fragCol = phong * texCol * vec4(light[0].color, 1.f);
+	fragCol = vec4(phong * texCol.rgb * light[0].color, texCol.a * materialOpacity);
 }
 
-float directionalIllumination(Lighting l, vec3 normals, vec3 fragPosition)
+vec3 directionalIllumination(Lighting l, vec3 normals, vec3 fragPosition)
 {
 	// clean input
 	vec3 norm = normalize(normals);
@@ -72,12 +84,11 @@ float directionalIllumination(Lighting l, vec3 normals, vec3 fragPosition)
 	// calcualte specular
 	vec3 toCamDir = normalize(l.camPos - fragPosition);
 	vec3 refDir = reflect(-toLightDir, norm);
-	float specular = pow(max(dot(toCamDir, refDir), 0.0), l.shininess) * l.specularStrength;
 
-	return l.ambientStrength + diffuse + specular;
+	return materialPhong(l, diffuse, max(dot(toCamDir, refDir), 0.0));
 }
 
-float positionalIllumination(Lighting l, vec3 normals, vec3 fragPosition)
+vec3 positionalIllumination(Lighting l, vec3 normals, vec3 fragPosition)
 {	
 	// clean input
 	vec3 norm = normalize(normals);
@@ -89,16 +100,15 @@ float positionalIllumination(Lighting l, vec3 normals, vec3 fragPosition)
 	// calcualte specular
 	vec3 toCamDir = normalize(l.camPos - fragPosition);
 	vec3 refDir = reflect(-toLightDir, norm);
-	float specular = pow(max(dot(toCamDir, refDir), 0.0), l.shininess) * l.specularStrength;
 
-	float phong = l.ambientStrength + diffuse + specular;
+	vec3 phong = materialPhong(l, diffuse, max(dot(toCamDir, refDir), 0.0));
 	float attenuation = calculateAttenuation(l, fragPosition);
 	return phong * attenuation;
 }
 
 
 
-float spotIllumination(Lighting l, vec3 normals, vec3 fragPosition)
+vec3 spotIllumination(Lighting l, vec3 normals, vec3 fragPosition)
 {
 	vec3 fromLightDir = -normalize(l.position - fragPosition); // direction of fragment to light position
 	vec3 spotDir = normalize(l.direction); // direction of spot light center vector
@@ -122,6 +132,14 @@ float spotIllumination(Lighting l, vec3 normals, vec3 fragPosition)
 	return positionalIllumination(l, normals, fragPosition) * intensity;
 }
 
+// ambient, diffuse and specular terms weighted by the material colors
+vec3 materialPhong(Lighting l, float diffuse, float specularBase)
+{
+	float shininess = materialShininess > 0.0 ? materialShininess : l.shininess;
+	float specular = pow(specularBase, shininess) * l.specularStrength;
+	return l.ambientStrength * materialAmbient + diffuse * materialDiffuse + specular * materialSpecular;
+}
+
 float calculateAttenuation(Lighting l, vec3 fragPosition)
 {
 	float dist = length(l.position - fragPosition);
@@ -1,21 +1,34 @@
 #version 330 core
 
 layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aTex;
-layout(location = 2) in vec3 aNor;
+layout(location = 1) in vec2 aTex;
+layout(location = 2) in vec2 aNor;
+layout(location = 3) in vec3 aNormal;	// glb meshes only
 
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+uniform bool gltfLayout = false;	// float normals in aNormal, texture origin at the top left
 
 out vec2 tex;
 out vec3 nor;
 out vec3 fragPos;
 
+// normals arrive octahedral encoded in 2 snorm16 (see VertexFormat.h)
+vec3 octDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.f - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.f);
+	n.x += n.x >= 0.f ? -t : t;
+	n.y += n.y >= 0.f ? -t : t;
+	return normalize(n);
+}
+
 void main()
 {
 	gl_Position = projection * view * model * vec4(aPos, 1.f);
-	tex = aTex.xy;
+	tex = gltfLayout ? vec2(aTex.x, 1.f - aTex.y) : aTex.xy; // textures are loaded flipped
 	fragPos = vec3(model * vec4(aPos, 1.f)); // world space position
-	nor = mat3(transpose(inverse(model))) * aNor; // to fix non uniform scaling
+	vec3 normal = gltfLayout ? normalize(aNormal) : octDecode(aNor);
+	nor = mat3(transpose(inverse(model))) * normal; // to fix non uniform scaling
 }
@@ -0,0 +1,43 @@
+// virtual texture sampling (see VirtualTexture.h), shared by the fragment shaders of textured bodies
+// and the feedback pass.
+// no #version: LoadShader inserts this file after the #version line of the shader that uses it
+
+uniform bool virtualTextured = false;
+uniform sampler2D virtualAtlas;			// resident tiles, each with its border
+uniform usampler2D virtualPageTable;	// slot, level and tile of the nearest resident tile, levels stacked
+uniform vec4 virtualLevels[16];			// xy: level size in texels, z: first page table row
+uniform int virtualLevelCount;
+uniform vec4 virtualLayout;				// x: tile size, y: tile border, z: slots per atlas row
+
+// level from the texel footprint on screen, bias added before clamping to the levels
+float virtualLod(vec2 texel, float bias)
+{
+	vec2 dx = dFdx(texel), dy = dFdy(texel);
+	return clamp(0.5 * log2(max(dot(dx, dx), dot(dy, dy))) + bias, 0.0, float(virtualLevelCount - 1));
+}
+
+// one bilinear lookup in a level, through the page table to its tile or the nearest resident ancestor
+vec4 virtualLevelSample(vec2 uv, int level)
+{
+	vec4 desired = virtualLevels[level];
+	ivec2 tileCount = ivec2(ceil(desired.xy / virtualLayout.x));
+	ivec2 tile = clamp(ivec2(floor(uv * desired.xy / virtualLayout.x)), ivec2(0), tileCount - 1);
+	uvec4 page = texelFetch(virtualPageTable, tile + ivec2(0, int(desired.z)), 0);
+
+	// texel inside the resident tile, the border covers the rounding of odd level sizes
+	float border = virtualLayout.y;
+	vec2 texel = clamp(uv * virtualLevels[page.y].xy - vec2(page.zw) * virtualLayout.x, vec2(0.5 - border), vec2(virtualLayout.x + border - 0.5));
+	uint slotsPerRow = uint(virtualLayout.z);
+	vec2 slot = vec2(page.x % slotsPerRow, page.x / slotsPerRow);
+	vec2 atlasTexel = slot * (virtualLayout.x + 2.0 * border) + border + texel;
+	return textureLod(virtualAtlas, atlasTexel / vec2(textureSize(virtualAtlas, 0)), 0.0);
+}
+
+// the two levels nearest to the footprint blended
+vec4 virtualTexture(vec2 uv)
+{
+	float lod = virtualLod(uv * virtualLevels[0].xy, 0.0);
+	int level = int(floor(lod));
+	int coarser = min(level + 1, virtualLevelCount - 1);
+	return mix(virtualLevelSample(uv, level), virtualLevelSample(uv, coarser), lod - float(level));
+}
\ No newline at end of file
@@ -1,8 +1,19 @@
 
 #include "shapes.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <map>
+#include <tuple>
 
 using namespace std;
 
+static const int SHAPE_VERTEX_STRIDE = 8;
+
+struct Direction
+{
+	float x, y, z;
+};
+
 vector<float> getRectangle()
 {
 	return vector<float> {
@@ -103,3 +114,247 @@ std::vector<float> getCircle(int num_segments, float radius)
 
 	return circle;
 }
+
+
+// ================= sphere ====================
+
+// unit direction of texture coordinate (u, v), the inverse of sphereUV
+static Direction sphereDirection(float u, float v)
+{
+	float latitude = (float)M_PI * (v - 0.5f);
+	float longitude = 2.f * (float)M_PI * u;
+	return Direction{ -cosf(latitude) * sinf(longitude), sinf(latitude), -cosf(latitude) * cosf(longitude) };
+}
+
+static void sphereUV(const Direction& dir, float& u, float& v)
+{
+	u = atan2f(-dir.x, -dir.z) / (2.f * (float)M_PI);
+	if (u < 0.f) u += 1.f;
+	v = asinf(max(-1.f, min(1.f, dir.y))) / (float)M_PI + 0.5f;
+}
+
+static void pushSphereVertex(vector<float>& vertices, const Direction& dir, float u, float v, float radius)
+{
+	vertices.insert(vertices.end(), { dir.x * radius, dir.y * radius, dir.z * radius, u, v, dir.x, dir.y, dir.z });
+}
+
+// deepest point of any triangle below the sphere surface, relative to the radius
+static float sphereError(const ShapeMesh& mesh, float radius)
+{
+	float error = 0.f;
+	for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+	{
+		const float* a = &mesh.vertices[(size_t)mesh.indices[t] * SHAPE_VERTEX_STRIDE];
+		const float* b = &mesh.vertices[(size_t)mesh.indices[t + 1] * SHAPE_VERTEX_STRIDE];
+		const float* c = &mesh.vertices[(size_t)mesh.indices[t + 2] * SHAPE_VERTEX_STRIDE];
+
+		float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+		float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (length == 0.f) continue;
+
+		// distance of the triangle's plane from the center
+		float distance = (n[0] * a[0] + n[1] * a[1] + n[2] * a[2]) / length;
+		error = max(error, 1.f - distance / radius);
+	}
+	return error;
+}
+
+ShapeMesh getUVSphere(int segments, int rings, float radius)
+{
+	ShapeMesh mesh;
+	int row = segments + 1;
+
+	// rings + 1 rows of segments + 1 vertices, the first and the last column meet at the seam
+	for (int i = 0; i <= rings; i++)
+	{
+		float v = (float)i / (float)rings;
+		bool pole = i == 0 || i == rings;
+		for (int j = 0; j <= segments; j++)
+		{
+			// a pole vertex takes the u of the middle of its triangle
+			float u = ((float)j + (pole ? 0.5f : 0.f)) / (float)segments;
+			pushSphereVertex(mesh.vertices, sphereDirection(u, v), u, v, radius);
+		}
+	}
+
+	// counter clockwise from outside, pole rows only keep the triangle with one pole vertex
+	for (int i = 0; i < rings; i++)
+	{
+		for (int j = 0; j < segments; j++)
+		{
+			unsigned int a = i * row + j;
+			unsigned int b = a + 1;
+			unsigned int c = a + row + 1;
+			unsigned int d = a + row;
+
+			if (i == 0) mesh.indices.insert(mesh.indices.end(), { a, c, d });
+			else if (i == rings - 1) mesh.indices.insert(mesh.indices.end(), { a, b, d });
+			else mesh.indices.insert(mesh.indices.end(), { a, b, c, a, c, d });
+		}
+	}
+
+	mesh.error = sphereError(mesh, radius);
+	return mesh;
+}
+
+ShapeMesh getIcosphere(int subdivisions, float radius)
+{
+	const float t = (1.f + sqrtf(5.f)) * 0.5f;
+	vector<Direction> directions{
+		{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+		{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+		{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+	};
+	vector<unsigned int> faces{
+		0, 11, 5,	0, 5, 1,	0, 1, 7,	0, 7, 10,	0, 10, 11,
+		1, 5, 9,	5, 11, 4,	11, 10, 2,	10, 7, 6,	7, 1, 8,
+		3, 9, 4,	3, 4, 2,	3, 2, 6,	3, 6, 8,	3, 8, 9,
+		4, 9, 5,	2, 4, 11,	6, 2, 10,	8, 6, 7,	9, 8, 1,
+	};
+
+	auto normalize = [](Direction d) {
+		float length = sqrtf(d.x * d.x + d.y * d.y + d.z * d.z);
+		return Direction{ d.x / length, d.y / length, d.z / length };
+	};
+	for (Direction& d : directions) d = normalize(d);
+
+	// every subdivision splits each triangle in 4, edge midpoints are shared through their edge key
+	for (int s = 0; s < subdivisions; s++)
+	{
+		map<pair<unsigned int, unsigned int>, unsigned int> midpoints;
+		auto midpoint = [&](unsigned int a, unsigned int b) {
+			pair<unsigned int, unsigned int> edge(min(a, b), max(a, b));
+			auto found = midpoints.find(edge);
+			if (found != midpoints.end()) return found->second;
+
+			const Direction& da = directions[a];
+			const Direction& db = directions[b];
+			directions.push_back(normalize(Direction{ da.x + db.x, da.y + db.y, da.z + db.z }));
+			unsigned int idx = (unsigned int)directions.size() - 1;
+			midpoints.emplace(edge, idx);
+			return idx;
+		};
+
+		vector<unsigned int> subdivided;
+		subdivided.reserve(faces.size() * 4);
+		for (size_t f = 0; f < faces.size(); f += 3)
+		{
+			unsigned int a = faces[f], b = faces[f + 1], c = faces[f + 2];
+			unsigned int ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+			subdivided.insert(subdivided.end(), { a, ab, ca, b, bc, ab, c, ca, bc, ab, bc, ca });
+		}
+		faces.swap(subdivided);
+	}
+
+	// uvs are assigned per triangle so seam and pole corners can be split off
+	ShapeMesh mesh;
+	map<tuple<unsigned int, float, float>, unsigned int> uniqueVertices;
+	for (size_t f = 0; f < faces.size(); f += 3)
+	{
+		float u[3], v[3];
+		for (int k = 0; k < 3; k++) sphereUV(directions[faces[f + k]], u[k], v[k]);
+
+		// a triangle crossing the seam continues past u = 1 instead of wrapping back over the texture
+		if (max({ u[0], u[1], u[2] }) - min({ u[0], u[1], u[2] }) > 0.5f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				if (u[k] < 0.5f) u[k] += 1.f;
+			}
+		}
+
+		// longitude is undefined at the poles, take the middle of the opposite edge
+		for (int k = 0; k < 3; k++)
+		{
+			if (fabsf(directions[faces[f + k]].y) > 0.9999f) u[k] = (u[(k + 1) % 3] + u[(k + 2) % 3]) * 0.5f;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			auto key = make_tuple(faces[f + k], u[k], v[k]);
+			auto found = uniqueVertices.find(key);
+			if (found == uniqueVertices.end())
+			{
+				found = uniqueVertices.emplace(key, (unsigned int)(mesh.vertices.size() / SHAPE_VERTEX_STRIDE)).first;
+				pushSphereVertex(mesh.vertices, directions[faces[f + k]], u[k], v[k], radius);
+			}
+			mesh.indices.push_back(found->second);
+		}
+	}
+
+	mesh.error = sphereError(mesh, radius);
+	return mesh;
+}
+
+const ShapeMesh& getSphereLevel(SphereType type, int level, float radius)
+{
+	static map<tuple<SphereType, int, float>, ShapeMesh> levels;
+
+	level = max(0, min(level, SPHERE_LEVEL_COUNT - 1));
+	auto key = make_tuple(type, level, radius);
+	auto found = levels.find(key);
+	if (found != levels.end()) return found->second;
+
+	ShapeMesh mesh = type == SphereType::UV ? getUVSphere(4 << level, 2 << level, radius) : getIcosphere(level, radius);
+	optimizeVertexCache(mesh.indices, mesh.vertices.size() / SHAPE_VERTEX_STRIDE);
+	optimizeVertexFetch(mesh.vertices, mesh.indices, SHAPE_VERTEX_STRIDE);
+	return levels.emplace(key, move(mesh)).first->second;
+}
+
+
+// ================= ring ====================
+
+ShapeMesh getRing(int segments, float innerRadius, float outerRadius, float thickness)
+{
+	ShapeMesh mesh;
+
+	// bottom face then top face, each an inner/outer vertex pair per segment edge
+	for (int side = 0; side < 2; side++)
+	{
+		float y = side == 0 ? -thickness * 0.5f : thickness * 0.5f;
+		float normalY = side == 0 ? -1.f : 1.f;
+		float innerV = side == 0 ? 0.f : 1.f;
+
+		for (int j = 0; j <= segments; j++)
+		{
+			float u = (float)j / (float)segments;
+			float angle = 2.f * (float)M_PI * (0.5f - u);
+			float c = cosf(angle), s = sinf(angle);
+
+			mesh.vertices.insert(mesh.vertices.end(), { c * innerRadius, y, s * innerRadius, u, innerV, 0.f, normalY, 0.f });
+			mesh.vertices.insert(mesh.vertices.end(), { c * outerRadius, y, s * outerRadius, u, 0.5f, 0.f, normalY, 0.f });
+		}
+	}
+
+	// counter clockwise seen from the side each face points to
+	unsigned int topBase = (unsigned int)(segments + 1) * 2;
+	for (int j = 0; j < segments; j++)
+	{
+		unsigned int inner = j * 2, outer = inner + 1, nextInner = inner + 2, nextOuter = inner + 3;
+		mesh.indices.insert(mesh.indices.end(), { inner, nextOuter, outer, inner, nextInner, nextOuter });
+		mesh.indices.insert(mesh.indices.end(), {
+			topBase + inner, topBase + outer, topBase + nextOuter,
+			topBase + inner, topBase + nextOuter, topBase + nextInner });
+	}
+
+	// the outer edge is a polygon inscribed in the circle
+	mesh.error = 1.f - cosf((float)M_PI / (float)segments);
+	return mesh;
+}
+
+const ShapeMesh& getRingLevel(int level, float innerRadius, float outerRadius, float thickness)
+{
+	static map<tuple<int, float, float, float>, ShapeMesh> levels;
+
+	level = max(0, min(level, RING_LEVEL_COUNT - 1));
+	auto key = make_tuple(level, innerRadius, outerRadius, thickness);
+	auto found = levels.find(key);
+	if (found != levels.end()) return found->second;
+
+	ShapeMesh mesh = getRing(8 << level, innerRadius, outerRadius, thickness);
+	optimizeVertexCache(mesh.indices, mesh.vertices.size() / SHAPE_VERTEX_STRIDE);
+	optimizeVertexFetch(mesh.vertices, mesh.indices, SHAPE_VERTEX_STRIDE);
+	return levels.emplace(key, move(mesh)).first->second;
+}